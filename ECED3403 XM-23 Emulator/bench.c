@@ -0,0 +1,336 @@
+#include "bench.h"
+#include "cpu.h"
+#include "decode.h"
+#include "execute_al.h"
+#include "interrupts.h"
+#include "memory.h"
+#include "registers.h"
+#include "scheduler.h"
+#include "xm23.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_START_ADDRESS 0x1000
+#define BENCH_CYCLES 300000000ULL // cycles run per benchmark case
+#define BENCH_BCD_ADDS 100000000u // decimal adds timed per adder and width
+#define BENCH_BCD_OPERANDS 4096 // random decimal operands cycled through, a power of 2
+#define BENCH_AL_CALLS 20000000u // executeAL calls timed per opcode and specialization
+#define BENCH_AL_CYCLES 30000000ULL // cycles of the guest loop run per opcode
+#define BENCH_API_CYCLES 100000000ULL // cycles run per library interface case
+
+// tight guest loop: 8 x ADD R1,R0 then BRA back to the first ADD
+static const uint16_t benchLoopProgram[] = {
+	0x4008, 0x4008, 0x4008, 0x4008, 0x4008, 0x4008, 0x4008, 0x4008,
+	0x3FF7, // BRA -9 words
+};
+
+// a periodic benchmark device, does a trivial amount of work and reschedules itself
+typedef struct {
+	uint64_t period;
+	uint64_t fired;
+} PeriodicDevice;
+
+static void periodicDeviceEvent(void* context, uint64_t cycle) {
+	PeriodicDevice* device = (PeriodicDevice*)context;
+	device->fired++;
+	scheduleEvent(cycle + device->period, periodicDeviceEvent, device);
+}
+
+// resets the machine and loads a benchmark program at the benchmark start address
+static void loadBenchProgram(const uint16_t* program, int wordCount) {
+	initializeRegisterFile();
+	initializeScheduler();
+	initializeInterrupts();
+	PSW = 0;
+	cpuClock = 0;
+	instructionCount = 0;
+
+	memset(memory, 0, MEMORY_SIZE);
+	for (int i = 0; i < wordCount; i++) {
+		memory[BENCH_START_ADDRESS + 2 * i] = program[i] & 0xFF;
+		memory[BENCH_START_ADDRESS + 2 * i + 1] = program[i] >> 8;
+	}
+	registerFile[R_PC] = BENCH_START_ADDRESS;
+}
+
+// runs the loop program with deviceCount periodic devices, period is the base period of the first device
+static void benchSchedulerCase(int deviceCount, uint64_t basePeriod) {
+	static PeriodicDevice devices[MAX_SCHEDULED_EVENTS];
+	uint64_t eventsFired = 0;
+
+	loadBenchProgram(benchLoopProgram, sizeof(benchLoopProgram) / sizeof(benchLoopProgram[0]));
+
+	// stagger the periods so events don't all land on the same cycle
+	for (int i = 0; i < deviceCount; i++) {
+		devices[i].period = basePeriod + 7 * i;
+		devices[i].fired = 0;
+		scheduleEvent(devices[i].period, periodicDeviceEvent, &devices[i]);
+	}
+
+	clock_t start = clock();
+	cpuRun(BENCH_CYCLES);
+	double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	for (int i = 0; i < deviceCount; i++) {
+		eventsFired += devices[i].fired;
+	}
+
+	printf("%8d %12llu %14llu %12llu %10.2f %12.2f\n",
+		deviceCount,
+		(unsigned long long)(deviceCount ? basePeriod : 0),
+		(unsigned long long)instructionCount,
+		(unsigned long long)eventsFired,
+		seconds > 0 ? (seconds * 1e9) / instructionCount : 0.0,
+		seconds > 0 ? instructionCount / seconds / 1e6 : 0.0);
+}
+
+// measures per-instruction overhead as periodic devices are added to the scheduler
+static void benchScheduler() {
+	printf("Scheduler benchmark: %llu cycles per case\n\n", (unsigned long long)BENCH_CYCLES);
+	printf(" Devices  Base period   Instructions       Events   ns/instr   M instr/s\n");
+	printf("--------------------------------------------------------------------------\n");
+
+	benchSchedulerCase(0, 0);
+	benchSchedulerCase(1, 1000);
+	benchSchedulerCase(4, 1000);
+	benchSchedulerCase(12, 1000);
+	benchSchedulerCase(12, 10000);
+	benchSchedulerCase(12, 100);
+
+	printf("\n");
+}
+
+// adds one BCD digit at a time, the baseline the byte table is measured against
+static uint16_t digitLoopBcdAdd(uint16_t dst, uint16_t src, int carryIn, int isByteMode, int* carryOut) {
+	int digits = isByteMode ? 2 : 4;
+	uint16_t result = 0;
+	int carry = carryIn;
+
+	for (int i = 0; i < digits; i++) {
+		int digit = ((dst >> (4 * i)) & 0xF) + ((src >> (4 * i)) & 0xF) + carry;
+		carry = digit > 9;
+		if (carry) digit -= 10;
+		result |= (digit & 0xF) << (4 * i);
+	}
+
+	*carryOut = carry;
+	return result;
+}
+
+typedef uint16_t (*DecimalAdder)(uint16_t dst, uint16_t src, int carryIn, int isByteMode, int* carryOut);
+
+// random decimal operands, so the adders see the digit patterns a real program mixes rather than one repeating case
+static uint16_t bcdOperands[BENCH_BCD_OPERANDS];
+
+static void makeBcdOperands() {
+	uint32_t random = 0x9E3779B9;
+
+	for (int i = 0; i < BENCH_BCD_OPERANDS; i++) {
+		uint16_t value = 0;
+		for (int digit = 0; digit < 4; digit++) {
+			random = random * 1103515245 + 12345;
+			value |= ((random >> 16) % 10) << (4 * digit);
+		}
+		bcdOperands[i] = value;
+	}
+}
+
+// adds are independent of each other, results are folded into a checksum so none can be dropped
+static void benchBcdCase(const char* name, DecimalAdder adder, int isByteMode) {
+	uint32_t checksum = 0;
+
+	clock_t start = clock();
+	for (uint32_t i = 0; i < BENCH_BCD_ADDS; i++) {
+		int carry;
+		uint16_t dst = bcdOperands[i & (BENCH_BCD_OPERANDS - 1)];
+		uint16_t src = bcdOperands[(i + 7) & (BENCH_BCD_OPERANDS - 1)];
+
+		checksum += adder(dst, src, i & 1, isByteMode, &carry) + carry;
+	}
+	double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	printf("%-12s %-5s %10.2f %12.1f     (%08X)\n", name, isByteMode ? "byte" : "word",
+		seconds > 0 ? seconds * 1e9 / BENCH_BCD_ADDS : 0.0,
+		seconds > 0 ? BENCH_BCD_ADDS / seconds / 1e6 : 0.0, checksum);
+}
+
+// compares the table-driven decimal adder against the digit loop
+static void benchBcd() {
+	makeBcdOperands();
+
+	printf("Decimal add benchmark: %u adds per case\n\n", BENCH_BCD_ADDS);
+	printf("Adder        Width    ns/add     M adds/s\n");
+	printf("------------------------------------------\n");
+
+	benchBcdCase("digit loop", digitLoopBcdAdd, 1);
+	benchBcdCase("byte table", bcdAdd, 1);
+	benchBcdCase("digit loop", digitLoopBcdAdd, 0);
+	benchBcdCase("byte table", bcdAdd, 0);
+
+	printf("\n");
+}
+
+static const char* alMnemonics[] = { "ADD", "ADDC", "SUB", "SUBC", "DADD", "CMP", "XOR", "AND", "OR", "BIT", "BIC", "BIS" };
+
+// AL instruction word for opcode 0-11 with R1 as the destination and R2 (or constant index 2) as the source
+static uint16_t alWord(int opcode, int isByteMode, int useConstant) {
+	return 0x4000 | (opcode << 8) | (useConstant << 7) | (isByteMode << 6) | (2 << 3) | 1;
+}
+
+// ns per executeAL call on an instruction decoded once, the way execute() hands it over
+static double benchALHandler(uint16_t word) {
+	Instruction instruction;
+
+	decode(word, &instruction);
+	instruction.opcode = instruction.opcode >> 8 & 0xFF;
+	registerFile[1] = 0x1234;
+	registerFile[2] = 0x0567;
+
+	clock_t start = clock();
+	for (uint32_t i = 0; i < BENCH_AL_CALLS; i++) {
+		executeAL(&instruction);
+	}
+	double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	return seconds * 1e9 / BENCH_AL_CALLS;
+}
+
+// M instructions/s for a guest loop of 8 copies of the word and a branch back, fetch and decode included
+static double benchALGuestLoop(uint16_t word) {
+	uint16_t program[9];
+
+	for (int i = 0; i < 8; i++) {
+		program[i] = word;
+	}
+	program[8] = 0x3FF7; // BRA -9 words
+
+	loadBenchProgram(program, 9);
+	registerFile[2] = 0x0567;
+
+	clock_t start = clock();
+	cpuRun(BENCH_AL_CYCLES);
+	double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	return seconds > 0 ? instructionCount / seconds / 1e6 : 0.0;
+}
+
+// times every AL opcode in each of its four width/source specializations, then as a word register guest loop
+static void benchAL() {
+	printf("AL benchmark: %u calls per specialization, %llu cycle guest loop per opcode\n\n",
+		BENCH_AL_CALLS, (unsigned long long)BENCH_AL_CYCLES);
+	printf("          ------------- ns/call -------------     guest\n");
+	printf("Opcode    word reg  word con  byte reg  byte con   M instr/s\n");
+	printf("------------------------------------------------------------\n");
+
+	for (int opcode = 0; opcode < 12; opcode++) {
+		printf("%-8s", alMnemonics[opcode]);
+		for (int isByteMode = 0; isByteMode < 2; isByteMode++) {
+			for (int useConstant = 0; useConstant < 2; useConstant++) {
+				printf("%10.2f", benchALHandler(alWord(opcode, isByteMode, useConstant)));
+			}
+		}
+		printf("%12.2f\n", benchALGuestLoop(alWord(opcode, 0, 0)));
+	}
+
+	printf("\n");
+}
+
+// step callback that never stops the run, measures the cost of asking for one
+static int countingCallback(XM23Machine* machine, void* context) {
+	(void)machine;
+	(*(uint64_t*)context)++;
+	return 0;
+}
+
+// runs the loop program through the library interface in batches of batchCycles, prints ns/instr
+static void benchApiCase(const char* label, uint64_t batchCycles, int useCallback) {
+	XM23Machine* machine = xm23Create();
+	uint16_t registers[REGISTER_COUNT] = { 0 };
+	uint64_t callbacks = 0;
+	uint64_t batches = 0;
+
+	if (machine == NULL) {
+		printf("Benchmark error: Unable to create machine\n");
+		return;
+	}
+
+	for (int i = 0; i < (int)(sizeof(benchLoopProgram) / sizeof(benchLoopProgram[0])); i++) {
+		uint8_t bytes[2] = { benchLoopProgram[i] & 0xFF, benchLoopProgram[i] >> 8 };
+		xm23WriteMemory(machine, (uint16_t)(BENCH_START_ADDRESS + 2 * i), bytes, 2);
+	}
+	registers[R_PC] = BENCH_START_ADDRESS;
+	xm23SetRegisters(machine, registers);
+	if (useCallback) {
+		xm23SetStepCallback(machine, countingCallback, &callbacks);
+	}
+
+	clock_t start = clock();
+	while (xm23Cycles(machine) < BENCH_API_CYCLES) {
+		if (xm23Run(machine, batchCycles) != XM23_STOP_CYCLE_LIMIT) {
+			break;
+		}
+		batches++;
+	}
+	double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	uint64_t instructions = xm23Instructions(machine);
+
+	printf("%-22s %12llu %14llu %10.2f %12.2f\n", label,
+		(unsigned long long)batches,
+		(unsigned long long)instructions,
+		seconds > 0 ? (seconds * 1e9) / instructions : 0.0,
+		seconds > 0 ? instructions / seconds / 1e6 : 0.0);
+
+	xm23Destroy(machine);
+}
+
+// compares the headless loop with the same program run through the library interface
+static void benchApi() {
+	printf("Library interface benchmark: %llu cycles per case\n\n", (unsigned long long)BENCH_API_CYCLES);
+	printf("Case                        Batches   Instructions   ns/instr   M instr/s\n");
+	printf("--------------------------------------------------------------------------\n");
+
+	loadBenchProgram(benchLoopProgram, sizeof(benchLoopProgram) / sizeof(benchLoopProgram[0]));
+	clock_t start = clock();
+	cpuRun(BENCH_API_CYCLES);
+	double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	printf("%-22s %12s %14llu %10.2f %12.2f\n", "headless cpuRun", "-",
+		(unsigned long long)instructionCount,
+		seconds > 0 ? (seconds * 1e9) / instructionCount : 0.0,
+		seconds > 0 ? instructionCount / seconds / 1e6 : 0.0);
+
+	benchApiCase("xm23Run, one batch", BENCH_API_CYCLES, 0);
+	benchApiCase("xm23Run, 100000 cycles", 100000, 0);
+	benchApiCase("xm23Run, 1000 cycles", 1000, 0);
+	benchApiCase("xm23Run, step callback", BENCH_API_CYCLES, 1);
+
+	printf("\n");
+}
+
+int runBenchmark(const char* name) {
+	// benchmarks run headless, per-instruction printing would dominate the timings
+	int savedTrace = traceEnabled;
+	traceEnabled = 0;
+
+	int result = 0;
+	if (strcmp(name, "scheduler") == 0) {
+		benchScheduler();
+	}
+	else if (strcmp(name, "bcd") == 0) {
+		benchBcd();
+	}
+	else if (strcmp(name, "al") == 0) {
+		benchAL();
+	}
+	else if (strcmp(name, "api") == 0) {
+		benchApi();
+	}
+	else {
+		printf("Unknown benchmark %s. Available: scheduler, bcd, al, api\n", name);
+		result = 1;
+	}
+
+	traceEnabled = savedTrace;
+	return result;
+}
@@ -0,0 +1,7 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// runs the named benchmark headless and prints its results, returns 0 for success, 1 if the name is unknown
+int runBenchmark(const char* name);
+
+#endif // !BENCH_H
@@ -0,0 +1,139 @@
+#include "branch_predictor.h"
+#include "cpu.h"
+#include "decode.h"
+#include "hotspots.h"
+#include "timing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+THREAD_LOCAL BranchPredictors* branchPredictors = NULL;
+
+static const char* predictorNames[PREDICTOR_COUNT] = { "taken", "btfn", "bimodal", "gshare" };
+
+int predictorByName(const char* name) {
+	for (int i = 0; i < PREDICTOR_COUNT; i++) {
+		if (strcmp(predictorNames[i], name) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+int startBranchPredictors() {
+	BranchPredictors* predictors = (BranchPredictors*)calloc(1, sizeof(BranchPredictors));
+
+	if (predictors == NULL) {
+		printf("Predictor error: Unable to allocate branch predictors\n");
+		return 0;
+	}
+
+	memset(predictors->bimodal, 2, sizeof(predictors->bimodal));
+	memset(predictors->gshare, 2, sizeof(predictors->gshare));
+	branchPredictors = predictors;
+	return 1;
+}
+
+// moves a 2-bit counter one step toward the outcome
+static void trainCounter(uint8_t* counter, int taken) {
+	if (taken && *counter < 3) {
+		(*counter)++;
+	}
+	else if (!taken && *counter > 0) {
+		(*counter)--;
+	}
+}
+
+void predictBranch(uint16_t pc, uint16_t target, int taken) {
+	BranchPredictors* predictors = branchPredictors;
+	uint32_t word = pc >> 1;
+	uint8_t* bimodal = &predictors->bimodal[word & ((1 << BIMODAL_INDEX_BITS) - 1)];
+	uint8_t* gshare = &predictors->gshare[(word ^ predictors->history) & ((1 << GSHARE_INDEX_BITS) - 1)];
+	int predictions[PREDICTOR_COUNT];
+
+	predictions[PREDICT_TAKEN] = 1;
+	predictions[PREDICT_BTFN] = target <= pc;
+	predictions[PREDICT_BIMODAL] = *bimodal >= 2;
+	predictions[PREDICT_GSHARE] = *gshare >= 2;
+
+	predictors->branches++;
+	predictors->addressBranches[word]++;
+	if (taken) {
+		predictors->taken++;
+		predictors->addressTaken[word]++;
+	}
+
+	for (int i = 0; i < PREDICTOR_COUNT; i++) {
+		if (predictions[i] != taken) {
+			predictors->mispredicts[i]++;
+			predictors->addressMispredicts[word][i]++;
+		}
+	}
+
+	// the hardware would refetch down the other path
+	if (timingModel != NULL && predictions[timingModel->chargedPredictor] != taken) {
+		cpuClock += timingModel->mispredictPenalty;
+	}
+
+	trainCounter(bimodal, taken);
+	trainCounter(gshare, taken);
+	predictors->history = ((predictors->history << 1) | (taken ? 1 : 0)) & ((1 << GSHARE_INDEX_BITS) - 1);
+}
+
+static double accuracy(uint64_t branches, uint64_t mispredicts) {
+	return branches ? 100.0 * (branches - mispredicts) / branches : 0.0;
+}
+
+// lists the most executed branches with each predictor's accuracy on them
+static void printBranchTable(const BranchPredictors* predictors) {
+	uint16_t addresses[PREDICTOR_REPORT_BRANCHES];
+	int count = findHotspots(predictors->addressBranches, PREDICTOR_REPORT_BRANCHES, addresses);
+
+	printf("\nAddress  Mnemonic     Executed   Taken %%");
+	for (int i = 0; i < PREDICTOR_COUNT; i++) {
+		printf(" %9s", predictorNames[i]);
+	}
+	printf("\n");
+	printf("--------------------------------------------------------------------------------\n");
+
+	for (int line = 0; line < count; line++) {
+		uint16_t address = addresses[line];
+		uint16_t word;
+		int index = address >> 1;
+		uint32_t executed = predictors->addressBranches[index];
+
+		printf("0x%04X   %-8s %12u %9.2f", address, hotspotMnemonic(address, &word),
+			executed, 100.0 * predictors->addressTaken[index] / executed);
+		for (int i = 0; i < PREDICTOR_COUNT; i++) {
+			printf(" %8.2f%%", accuracy(executed, predictors->addressMispredicts[index][i]));
+		}
+		printf("\n");
+	}
+}
+
+void finishBranchPredictors(int report) {
+	BranchPredictors* predictors = branchPredictors;
+
+	if (predictors == NULL) {
+		return;
+	}
+	branchPredictors = NULL;
+
+	if (report) {
+		printf("\nBranch prediction: %llu conditional branches, %.2f%% taken\n", (unsigned long long)predictors->branches,
+			predictors->branches ? 100.0 * predictors->taken / predictors->branches : 0.0);
+		printf("Predictor      Mispredicts   Accuracy\n");
+		printf("-------------------------------------\n");
+		for (int i = 0; i < PREDICTOR_COUNT; i++) {
+			printf("%-10s %15llu %9.2f%%\n", predictorNames[i], (unsigned long long)predictors->mispredicts[i],
+				accuracy(predictors->branches, predictors->mispredicts[i]));
+		}
+
+		if (predictors->branches > 0) {
+			printBranchTable(predictors);
+		}
+	}
+
+	free(predictors);
+}
@@ -0,0 +1,52 @@
+#ifndef BRANCH_PREDICTOR_H
+#define BRANCH_PREDICTOR_H
+
+#include <stdint.h>
+#include "memory.h"
+#include "tls.h"
+
+#define BIMODAL_INDEX_BITS 10	// 1K 2-bit counters indexed by PC
+#define GSHARE_INDEX_BITS 12	// 4K 2-bit counters indexed by PC xor 12 bits of global history
+#define PREDICTOR_REPORT_BRANCHES 20 // branches listed in the report, most executed first
+
+// candidate predictors, all run side by side on every conditional branch
+typedef enum {
+	PREDICT_TAKEN,		// static, always taken
+	PREDICT_BTFN,		// static, backward taken, forward not taken
+	PREDICT_BIMODAL,	// per-branch 2-bit saturating counter
+	PREDICT_GSHARE,		// 2-bit counters indexed by global history xor PC
+	PREDICTOR_COUNT
+} PredictorKind;
+
+typedef struct {
+	uint8_t bimodal[1 << BIMODAL_INDEX_BITS];
+	uint8_t gshare[1 << GSHARE_INDEX_BITS];
+	uint32_t history;	// outcomes of the latest conditional branches, newest in bit 0
+
+	uint64_t branches;
+	uint64_t taken;
+	uint64_t mispredicts[PREDICTOR_COUNT];
+
+	// by word address of the branch
+	uint32_t addressBranches[MEMORY_SIZE / 2];
+	uint32_t addressTaken[MEMORY_SIZE / 2];
+	uint32_t addressMispredicts[MEMORY_SIZE / 2][PREDICTOR_COUNT];
+} BranchPredictors;
+
+// predictors run on this thread, NULL when branches aren't being predicted
+extern THREAD_LOCAL BranchPredictors* branchPredictors;
+
+// returns the predictor for a name (taken, btfn, bimodal, gshare), -1 if there isn't one
+int predictorByName(const char* name);
+
+// starts predicting on this thread with every counter at weakly taken, returns 0 if it couldn't be allocated
+int startBranchPredictors();
+
+// runs every predictor on a conditional branch at pc, then trains them on the outcome
+// a loaded timing model charges its misprediction penalty when its chosen predictor got it wrong
+void predictBranch(uint16_t pc, uint16_t target, int taken);
+
+// prints accuracy overall and for the most executed branches when report is set, then stops predicting
+void finishBranchPredictors(int report);
+
+#endif // !BRANCH_PREDICTOR_H
@@ -1,12 +1,33 @@
 #include "bus.h"
 #include "memory.h"
+#include "tls.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// handlers for the memory-mapped device ports, NULL if no device is attached to the port
+static THREAD_LOCAL DevicePortHandler devicePorts[DEVICE_PORT_COUNT];
+
+void attachDevicePort(uint16_t address, DevicePortHandler handler) {
+	if (address >= DEVICE_PORT_COUNT) {
+		printf("Bus error: Address 0x%04X is not a device port.\n", address);
+		return;
+	}
+	devicePorts[address] = handler;
+}
+
+void saveDevicePorts(DevicePortHandler handlers[DEVICE_PORT_COUNT]) {
+	memcpy(handlers, devicePorts, sizeof(devicePorts));
+}
+
+void restoreDevicePorts(const DevicePortHandler handlers[DEVICE_PORT_COUNT]) {
+	memcpy(devicePorts, handlers, sizeof(devicePorts));
+}
 
 int bus(uint16_t address, uint8_t* value, int mode) {
-	
-	// validate the address range
-	if (address > MEMORY_SIZE) {
-		printf("Bus error: Address 0x%04X is out of range.\n", address);
-		return -1;
+	// a 16-bit address is always within the 64 KB of memory, only device port accesses need routing elsewhere
+	if (address < DEVICE_PORT_COUNT && devicePorts[address] != NULL) {
+		return devicePorts[address](address, value, mode);
 	}
 
 	if (mode == BUS_READ) {
@@ -21,4 +42,4 @@ int bus(uint16_t address, uint8_t* value, int mode) {
 	}
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -6,8 +6,20 @@
 #define BUS_READ 0
 #define BUS_WRITE 1
 
+// device ports occupy the bottom of memory (0x0000-0x000F), one control/status and one data byte per device
+#define DEVICE_PORT_COUNT 16
+
+// handler for a memory-mapped device port, follows the same contract as bus()
+typedef int (*DevicePortHandler)(uint16_t address, uint8_t* value, int mode);
+
 // verifies valid memory access and reads into or writes provided value based on mode
 int bus(uint16_t address, uint8_t* value, int mode);
 
-#endif // !BUS_H
+// attaches a device handler to a port address, accesses to that address are routed to the device instead of memory
+void attachDevicePort(uint16_t address, DevicePortHandler handler);
 
+// copies this thread's device port handlers out, or back in, when the thread switches machines
+void saveDevicePorts(DevicePortHandler handlers[DEVICE_PORT_COUNT]);
+void restoreDevicePorts(const DevicePortHandler handlers[DEVICE_PORT_COUNT]);
+
+#endif // !BUS_H
@@ -0,0 +1,183 @@
+#define _CRT_SECURE_NO_WARNINGS // to avoid errors on functions like sscanf
+
+#include "cache.h"
+#include "bus.h"
+#include "cpu.h"
+#include "hotspots.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+THREAD_LOCAL Cache* instructionCache = NULL;
+THREAD_LOCAL Cache* dataCache = NULL;
+
+static int isPowerOfTwo(int value) {
+	return value > 0 && (value & (value - 1)) == 0;
+}
+
+int parseCacheConfig(const char* text, CacheConfig* config) {
+	char policy[8] = "lru";
+	int fields;
+
+	config->replacement = CACHE_LRU;
+	config->missPenalty = 0;
+
+	fields = sscanf(text, "%d,%d,%d,%7[a-z],%d", &config->size, &config->lineSize, &config->ways, policy, &config->missPenalty);
+	if (fields == 4 || fields == 3) {
+		// the penalty may follow the ways directly
+		sscanf(text, "%*d,%*d,%*d,%d", &config->missPenalty);
+	}
+	if (fields < 3) {
+		printf("Cache error: %s is not size,line,ways[,lru|random][,penalty]\n", text);
+		return 0;
+	}
+
+	if (strcmp(policy, "random") == 0) {
+		config->replacement = CACHE_RANDOM;
+	}
+	else if (strcmp(policy, "lru") != 0) {
+		printf("Cache error: Unknown replacement policy %s, use lru or random\n", policy);
+		return 0;
+	}
+	return 1;
+}
+
+Cache* createCache(const char* name, const CacheConfig* config) {
+	Cache* cache;
+
+	if (!isPowerOfTwo(config->lineSize) || config->lineSize < 2 || config->ways < 1 || config->missPenalty < 0 ||
+		config->size % (config->lineSize * config->ways) != 0 || !isPowerOfTwo(config->size / (config->lineSize * config->ways))) {
+		printf("Cache error: %s needs a power of 2 line size of at least 2, and a power of 2 number of sets\n", name);
+		return NULL;
+	}
+
+	cache = (Cache*)calloc(1, sizeof(Cache));
+	if (cache == NULL) {
+		printf("Cache error: Unable to allocate %s\n", name);
+		return NULL;
+	}
+
+	cache->name = name;
+	cache->config = *config;
+	cache->sets = config->size / (config->lineSize * config->ways);
+	cache->random = 0x2545F491;
+	while ((1 << cache->lineShift) < config->lineSize) {
+		cache->lineShift++;
+	}
+
+	cache->tags = (uint32_t*)calloc((size_t)cache->sets * config->ways, sizeof(uint32_t));
+	cache->lastUse = (uint64_t*)calloc((size_t)cache->sets * config->ways, sizeof(uint64_t));
+	if (cache->tags == NULL || cache->lastUse == NULL) {
+		printf("Cache error: Unable to allocate %s\n", name);
+		free(cache->tags);
+		free(cache->lastUse);
+		free(cache);
+		return NULL;
+	}
+	return cache;
+}
+
+// picks the way to refill in a full set
+static int victimWay(Cache* cache, int set) {
+	int ways = cache->config.ways;
+	int victim = 0;
+
+	if (cache->config.replacement == CACHE_RANDOM) {
+		// xorshift, the run is repeatable
+		cache->random ^= cache->random << 13;
+		cache->random ^= cache->random >> 17;
+		cache->random ^= cache->random << 5;
+		return cache->random % ways;
+	}
+
+	for (int way = 1; way < ways; way++) {
+		if (cache->lastUse[set * ways + way] < cache->lastUse[set * ways + victim]) {
+			victim = way;
+		}
+	}
+	return victim;
+}
+
+// looks up one line, returns 1 for a hit
+static int accessLine(Cache* cache, uint32_t line) {
+	int ways = cache->config.ways;
+	int set = line & (cache->sets - 1);
+	uint32_t* tags = &cache->tags[set * ways];
+	uint64_t* lastUse = &cache->lastUse[set * ways];
+
+	cache->accesses++;
+
+	for (int way = 0; way < ways; way++) {
+		if (tags[way] == line + 1) {
+			lastUse[way] = cache->accesses;
+			return 1;
+		}
+	}
+
+	// fill an empty way first, then replace
+	int fill = -1;
+	for (int way = 0; way < ways && fill < 0; way++) {
+		if (tags[way] == 0) {
+			fill = way;
+		}
+	}
+	if (fill < 0) {
+		fill = victimWay(cache, set);
+	}
+	tags[fill] = line + 1;
+	lastUse[fill] = cache->accesses;
+	return 0;
+}
+
+void cacheAccess(Cache* cache, uint16_t address, int size, uint16_t pc) {
+	// device ports are registers on the device, not memory
+	if (address < DEVICE_PORT_COUNT) {
+		return;
+	}
+
+	uint32_t first = address >> cache->lineShift;
+	uint32_t last = (uint16_t)(address + size - 1) >> cache->lineShift;
+
+	for (uint32_t line = first; ; line = (line + 1) & (MEMORY_SIZE - 1) >> cache->lineShift) {
+		cache->addressAccesses[pc >> 1]++;
+		if (!accessLine(cache, line)) {
+			cache->misses++;
+			cache->addressMisses[pc >> 1]++;
+			cpuClock += cache->config.missPenalty;
+		}
+		if (line == last) {
+			break;
+		}
+	}
+}
+
+void finishCache(Cache* cache) {
+	const CacheConfig* config = &cache->config;
+	uint64_t hits = cache->accesses - cache->misses;
+
+	printf("\n%s: %d bytes, %d byte lines, %d-way, %s, %d cycle miss penalty\n", cache->name, config->size, config->lineSize,
+		config->ways, config->replacement == CACHE_RANDOM ? "random" : "LRU", config->missPenalty);
+	printf("  Accesses : %llu, %llu hits (%.2f%%), %llu misses\n", (unsigned long long)cache->accesses, (unsigned long long)hits,
+		cache->accesses ? 100.0 * hits / cache->accesses : 0.0, (unsigned long long)cache->misses);
+	printf("  Penalty  : %llu cycles\n", (unsigned long long)cache->misses * config->missPenalty);
+
+	if (cache->misses > 0) {
+		printf("  Address  Mnemonic     Accesses      Misses  Miss rate\n");
+		uint16_t addresses[CACHE_REPORT_ADDRESSES];
+		int count = findHotspots(cache->addressMisses, CACHE_REPORT_ADDRESSES, addresses);
+
+		for (int line = 0; line < count; line++) {
+			uint16_t address = addresses[line];
+			uint16_t word;
+			int index = address >> 1;
+
+			printf("  0x%04X   %-8s %12u %11u %9.2f%%\n", address, hotspotMnemonic(address, &word),
+				cache->addressAccesses[index], cache->addressMisses[index], 100.0 * cache->addressMisses[index] / cache->addressAccesses[index]);
+		}
+	}
+
+	free(cache->tags);
+	free(cache->lastUse);
+	free(cache);
+}
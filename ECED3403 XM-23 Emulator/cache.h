@@ -0,0 +1,55 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+#include "memory.h"
+#include "tls.h"
+
+#define CACHE_LRU 0
+#define CACHE_RANDOM 1
+
+#define CACHE_REPORT_ADDRESSES 10 // instructions listed with the most misses
+
+// geometry, replacement and cost of one cache
+typedef struct {
+	int size;			// bytes of data held
+	int lineSize;		// bytes per line, a power of 2
+	int ways;			// lines per set, size / lineSize for fully associative
+	int replacement;	// CACHE_LRU or CACHE_RANDOM
+	int missPenalty;	// cycles added to cpuClock for each miss
+} CacheConfig;
+
+// a set-associative cache model, it keeps tags only, the data always comes from memory
+// writes allocate like reads, device ports bypass the cache
+typedef struct {
+	const char* name;
+	CacheConfig config;
+	int sets;
+	int lineShift;
+	uint32_t* tags;			// sets x ways, line address + 1, 0 for an empty way
+	uint64_t* lastUse;		// sets x ways, access count at the last hit or fill, for LRU
+	uint64_t accesses;
+	uint64_t misses;
+	uint32_t random;
+	uint32_t addressAccesses[MEMORY_SIZE / 2];	// by the word address of the instruction making the access
+	uint32_t addressMisses[MEMORY_SIZE / 2];
+} Cache;
+
+// caches being modelled on this thread, NULL when that cache is off
+extern THREAD_LOCAL Cache* instructionCache;
+extern THREAD_LOCAL Cache* dataCache;
+
+// parses "size,line,ways[,lru|random][,penalty]", e.g. "1024,16,2,lru,10", returns 1/0 for success/failure
+int parseCacheConfig(const char* text, CacheConfig* config);
+
+// creates an empty cache, returns NULL if the config isn't valid or it couldn't be allocated
+Cache* createCache(const char* name, const CacheConfig* config);
+
+// looks up every line the size bytes from address touch, filling any that miss
+// pc is the instruction making the access, misses add the penalty to cpuClock
+void cacheAccess(Cache* cache, uint16_t address, int size, uint16_t pc);
+
+// prints hit/miss totals and the instructions with the most misses, then frees the cache
+void finishCache(Cache* cache);
+
+#endif // !CACHE_H
@@ -0,0 +1,689 @@
+#include "conformance.h"
+#include "cpu.h"
+#include "decode.h"
+#include "execute.h"
+#include "execute_al.h"
+#include "interrupts.h"
+#include "memory.h"
+#include "platform.h"
+#include "registers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WORD_BLOCK_SIZE 256 // instruction words handed to a worker at a time
+#define MAX_EXAMPLES 3		// mismatches kept per opcode for the report
+#define BCD_WORD_SAMPLES (1u << 22) // random word inputs checked against the decimal adder
+
+// reference model operations, decoded from the instruction word independently of opcodeTable
+typedef enum {
+	OP_ILLEGAL,
+	OP_BL, OP_BEQ, OP_BNE, OP_BC, OP_BNC, OP_BN, OP_BGE, OP_BLT, OP_BRA,
+	OP_ADD, OP_ADDC, OP_SUB, OP_SUBC, OP_DADD, OP_CMP, OP_XOR, OP_AND, OP_OR, OP_BIT, OP_BIC, OP_BIS,
+	OP_MOV, OP_SWAP,
+	OP_SRA, OP_RRC, OP_COMP, OP_SWPB, OP_SXT,
+	OP_SETPRI, OP_SVC, OP_SETCC, OP_CLRCC, OP_CEX,
+	OP_LD, OP_ST,
+	OP_MOVL, OP_MOVLZ, OP_MOVLS, OP_MOVH,
+	OP_LDR, OP_STR,
+	OP_COUNT
+} RefOp;
+
+static const char* refOpNames[OP_COUNT] = {
+	"(illegal)",
+	"BL", "BEQ", "BNE", "BC", "BNC", "BN", "BGE", "BLT", "BRA",
+	"ADD", "ADDC", "SUB", "SUBC", "DADD", "CMP", "XOR", "AND", "OR", "BIT", "BIC", "BIS",
+	"MOV", "SWAP",
+	"SRA", "RRC", "COMP", "SWPB", "SXT",
+	"SETPRI", "SVC", "SETCC", "CLRCC", "CEX",
+	"LD", "ST",
+	"MOVL", "MOVLZ", "MOVLS", "MOVH",
+	"LDR", "STR",
+};
+
+// instruction word patterns for the reference decoder, first match wins
+typedef struct {
+	uint16_t mask;
+	uint16_t match;
+	RefOp op;
+} RefPattern;
+
+static const RefPattern refPatterns[] = {
+	{ 0xE000, 0x0000, OP_BL },
+	{ 0xFC00, 0x2000, OP_BEQ }, { 0xFC00, 0x2400, OP_BNE }, { 0xFC00, 0x2800, OP_BC }, { 0xFC00, 0x2C00, OP_BNC },
+	{ 0xFC00, 0x3000, OP_BN }, { 0xFC00, 0x3400, OP_BGE }, { 0xFC00, 0x3800, OP_BLT }, { 0xFC00, 0x3C00, OP_BRA },
+	{ 0xFF00, 0x4000, OP_ADD }, { 0xFF00, 0x4100, OP_ADDC }, { 0xFF00, 0x4200, OP_SUB }, { 0xFF00, 0x4300, OP_SUBC },
+	{ 0xFF00, 0x4400, OP_DADD }, { 0xFF00, 0x4500, OP_CMP }, { 0xFF00, 0x4600, OP_XOR }, { 0xFF00, 0x4700, OP_AND },
+	{ 0xFF00, 0x4800, OP_OR }, { 0xFF00, 0x4900, OP_BIT }, { 0xFF00, 0x4A00, OP_BIC }, { 0xFF00, 0x4B00, OP_BIS },
+	{ 0xFF80, 0x4C00, OP_MOV }, { 0xFF80, 0x4C80, OP_SWAP },
+	{ 0xFFB8, 0x4D00, OP_SRA }, { 0xFFB8, 0x4D08, OP_RRC }, { 0xFFB8, 0x4D10, OP_COMP },
+	{ 0xFFB8, 0x4D18, OP_SWPB }, { 0xFFB8, 0x4D20, OP_SXT },
+	{ 0xFFF8, 0x4D80, OP_SETPRI }, { 0xFFF0, 0x4D90, OP_SVC }, { 0xFFE0, 0x4DA0, OP_SETCC }, { 0xFFE0, 0x4DC0, OP_CLRCC },
+	{ 0xFC00, 0x5000, OP_CEX },
+	{ 0xFC00, 0x5800, OP_LD }, { 0xFC00, 0x5C00, OP_ST },
+	{ 0xF800, 0x6000, OP_MOVL }, { 0xF800, 0x6800, OP_MOVLZ }, { 0xF800, 0x7000, OP_MOVLS }, { 0xF800, 0x7800, OP_MOVH },
+	{ 0xC000, 0x8000, OP_LDR }, { 0xC000, 0xC000, OP_STR },
+};
+
+// reference decode of every instruction word, built once before the sweep
+static uint8_t refOpTable[65536];
+
+// CEX conditions written out flag by flag, deliberately not sharing the emulator's truth tables
+static int refCondition(int condition, uint16_t psw) {
+	int c = (psw & PSW_C) != 0, z = (psw & PSW_Z) != 0, n = (psw & PSW_N) != 0, v = (psw & PSW_V) != 0;
+	switch (condition) {
+		case 0: return z;
+		case 1: return !z;
+		case 2: return c;
+		case 3: return !c;
+		case 4: return n;
+		case 5: return !n;
+		case 6: return v;
+		case 7: return !v;
+		case 8: return c && !z;
+		case 9: return !c || z;
+		case 10: return n == v;
+		case 11: return n != v;
+		case 12: return !z && n == v;
+		case 13: return z || n != v;
+		case 14: return 1;
+		default: return 0;
+	}
+}
+
+// machine state compared between the emulator and the reference model
+typedef struct {
+	uint16_t registers[REGISTER_COUNT];
+	uint16_t psw;
+	int cexExecute;
+	int cexSkip;
+} MachineState;
+
+static uint16_t refReadWord(const uint8_t* mem, uint16_t address) {
+	return mem[address] | (mem[(uint16_t)(address + 1)] << 8);
+}
+
+static void refWriteWord(uint8_t* mem, uint16_t address, uint16_t value) {
+	mem[address] = value & 0xFF;
+	mem[(uint16_t)(address + 1)] = value >> 8;
+}
+
+// writes an ALU result in word or byte mode, byte mode leaves the high byte alone
+static void refWriteResult(MachineState* state, int reg, uint16_t value, int byteMode) {
+	if (byteMode) {
+		state->registers[reg] = (state->registers[reg] & 0xFF00) | (value & 0xFF);
+	}
+	else {
+		state->registers[reg] = value;
+	}
+}
+
+// sets N and Z from a result of the given width and clears C and V
+static void refSetNZ(MachineState* state, uint16_t result, int byteMode) {
+	uint16_t mask = byteMode ? 0xFF : 0xFFFF;
+	uint16_t sign = byteMode ? 0x80 : 0x8000;
+
+	state->psw &= ~(PSW_N | PSW_Z | PSW_C | PSW_V);
+	if ((result & mask) == 0) state->psw |= PSW_Z;
+	if (result & sign) state->psw |= PSW_N;
+}
+
+// dst + src + carryIn at the given width, sets all four arithmetic flags
+static uint16_t refAdd(MachineState* state, uint16_t dst, uint16_t src, int carryIn, int byteMode) {
+	uint32_t mask = byteMode ? 0xFF : 0xFFFF;
+	uint32_t sign = byteMode ? 0x80 : 0x8000;
+	uint32_t sum = (dst & mask) + (src & mask) + carryIn;
+	uint16_t result = sum & mask;
+
+	refSetNZ(state, result, byteMode);
+	state->psw &= ~(PSW_C | PSW_V);
+	if (sum > mask) state->psw |= PSW_C;
+	if (((dst ^ result) & (src ^ result)) & sign) state->psw |= PSW_V;
+
+	return result;
+}
+
+// decimal dst + src + carryIn, one BCD digit at a time
+static uint16_t refDecimalAdd(MachineState* state, uint16_t dst, uint16_t src, int carryIn, int byteMode) {
+	int digits = byteMode ? 2 : 4;
+	uint16_t result = 0;
+	int carry = carryIn;
+
+	for (int i = 0; i < digits; i++) {
+		int digit = ((dst >> (4 * i)) & 0xF) + ((src >> (4 * i)) & 0xF) + carry;
+		carry = digit > 9;
+		if (carry) digit -= 10;
+		result |= (digit & 0xF) << (4 * i);
+	}
+
+	refSetNZ(state, result, byteMode);
+	if (carry) state->psw |= PSW_C;
+
+	return result;
+}
+
+// pushes a word onto the reference stack
+static void refPush(MachineState* state, uint8_t* mem, uint16_t value) {
+	state->registers[R_SP] -= 2;
+	refWriteWord(mem, state->registers[R_SP], value);
+}
+
+// executes one instruction word on the reference machine, the PC has already been advanced past it
+static void refExecute(uint16_t word, MachineState* state, uint8_t* mem) {
+	RefOp op = (RefOp)refOpTable[word];
+	uint16_t* r = state->registers;
+	int dst = word & 0x07;
+	int srcIndex = (word >> 3) & 0x07;
+	int byteMode = (word >> 6) & 0x01;
+	uint16_t mask = byteMode ? 0xFF : 0xFFFF;
+
+	switch (op) {
+	case OP_BL:
+	{
+		int16_t offset = (int16_t)(word << 3) >> 3; // sign-extend 13 bits
+		r[R_LR] = r[R_PC];
+		r[R_PC] += offset * 2;
+		return;
+	}
+	case OP_BEQ: case OP_BNE: case OP_BC: case OP_BNC: case OP_BN: case OP_BGE: case OP_BLT: case OP_BRA:
+	{
+		int16_t offset = (int16_t)(word << 6) >> 6; // sign-extend 10 bits
+		int c = (state->psw & PSW_C) != 0, z = (state->psw & PSW_Z) != 0;
+		int n = (state->psw & PSW_N) != 0, v = (state->psw & PSW_V) != 0;
+		int taken =
+			op == OP_BEQ ? z : op == OP_BNE ? !z : op == OP_BC ? c : op == OP_BNC ? !c :
+			op == OP_BN ? n : op == OP_BGE ? n == v : op == OP_BLT ? n != v : 1;
+		if (taken) {
+			r[R_PC] += offset * 2;
+		}
+		return;
+	}
+	case OP_ADD: case OP_ADDC: case OP_SUB: case OP_SUBC: case OP_DADD: case OP_CMP:
+	case OP_XOR: case OP_AND: case OP_OR: case OP_BIT: case OP_BIC: case OP_BIS:
+	{
+		int useConstant = (word >> 7) & 0x01;
+		uint16_t src = (useConstant ? (uint16_t)constants[srcIndex] : r[srcIndex]) & mask;
+		uint16_t d = r[dst] & mask;
+		int carry = (state->psw & PSW_C) != 0;
+		uint16_t bit = 1 << (src & (byteMode ? 0x07 : 0x0F));
+		uint16_t result;
+
+		switch (op) {
+			case OP_ADD:  result = refAdd(state, d, src, 0, byteMode); break;
+			case OP_ADDC: result = refAdd(state, d, src, carry, byteMode); break;
+			case OP_SUB:  result = refAdd(state, d, ~src & mask, 1, byteMode); break;
+			case OP_SUBC: result = refAdd(state, d, ~src & mask, carry, byteMode); break;
+			case OP_CMP:  refAdd(state, d, ~src & mask, 1, byteMode); return;
+			case OP_DADD: result = refDecimalAdd(state, d, src, carry, byteMode); break;
+			case OP_XOR:  result = d ^ src; refSetNZ(state, result, byteMode); break;
+			case OP_AND:  result = d & src; refSetNZ(state, result, byteMode); break;
+			case OP_OR:   result = d | src; refSetNZ(state, result, byteMode); break;
+			case OP_BIT:  refSetNZ(state, d & bit, byteMode); return;
+			case OP_BIC:  result = d & ~bit; refSetNZ(state, result, byteMode); break;
+			default:      result = d | bit; refSetNZ(state, result, byteMode); break;
+		}
+		refWriteResult(state, dst, result, byteMode);
+		return;
+	}
+	case OP_MOV:
+		refWriteResult(state, dst, r[srcIndex], byteMode);
+		return;
+	case OP_SWAP:
+	{
+		uint16_t d = r[dst], s = r[srcIndex];
+		refWriteResult(state, dst, s, byteMode);
+		refWriteResult(state, srcIndex, d, byteMode);
+		return;
+	}
+	case OP_SRA: case OP_RRC: case OP_COMP:
+	{
+		uint16_t d = r[dst] & mask;
+		uint16_t sign = byteMode ? 0x80 : 0x8000;
+		uint16_t result;
+
+		if (op == OP_COMP) {
+			result = ~d & mask;
+		}
+		else {
+			uint16_t top = op == OP_SRA ? (d & sign) : ((state->psw & PSW_C) ? sign : 0);
+			result = (d >> 1) | top;
+		}
+		refSetNZ(state, result, byteMode);
+		if (op != OP_COMP && (d & 0x01)) state->psw |= PSW_C;
+		refWriteResult(state, dst, result, byteMode);
+		return;
+	}
+	case OP_SWPB:
+		r[dst] = (r[dst] << 8) | (r[dst] >> 8);
+		refSetNZ(state, r[dst], 0);
+		return;
+	case OP_SXT:
+		r[dst] = (uint16_t)(int16_t)(int8_t)(r[dst] & 0xFF);
+		refSetNZ(state, r[dst], 0);
+		return;
+	case OP_SETPRI:
+		state->psw = (state->psw & ~PSW_CP_MASK) | ((word & 0x07) << 5);
+		return;
+	case OP_SVC:
+	{
+		uint16_t vector = VECTOR_ADDRESS(word & 0x0F);
+		uint16_t oldPSW = state->psw;
+
+		refPush(state, mem, r[R_PC]);
+		refPush(state, mem, r[R_LR]);
+		refPush(state, mem, oldPSW & ~PSW_SLP_MASK);
+		state->psw = (refReadWord(mem, vector) & ~PSW_PP_MASK) | ((oldPSW & PSW_CP_MASK) << 8);
+		r[R_PC] = refReadWord(mem, vector + 2);
+		r[R_LR] = INTERRUPT_RETURN_ADDRESS;
+		return;
+	}
+	case OP_SETCC:
+		state->psw |= word & 0x1F;
+		return;
+	case OP_CLRCC:
+		state->psw &= ~(word & 0x1F);
+		return;
+	case OP_CEX:
+	{
+		int trueCount = (word >> 3) & 0x07;
+		int falseCount = word & 0x07;
+
+		if (refCondition((word >> 6) & 0x0F, state->psw)) {
+			state->cexExecute = trueCount;
+			state->cexSkip = falseCount;
+			if (trueCount == 0) r[R_PC] += 2 * falseCount;
+		}
+		else {
+			r[R_PC] += 2 * trueCount;
+		}
+		return;
+	}
+	case OP_LD: case OP_ST:
+	{
+		int addressReg = op == OP_LD ? srcIndex : dst;
+		int pre = (word >> 9) & 0x01;
+		int step = (word & 0x0100) ? -(byteMode ? 1 : 2) : (word & 0x0080) ? (byteMode ? 1 : 2) : 0;
+		uint16_t value = r[srcIndex]; // ST reads its value before any address update
+		uint16_t address = r[addressReg];
+
+		if (pre && step) {
+			address += step;
+			r[addressReg] = address;
+		}
+
+		if (op == OP_LD) {
+			refWriteResult(state, dst, byteMode ? mem[address] : refReadWord(mem, address), byteMode);
+		}
+		else if (byteMode) {
+			mem[address] = value & 0xFF;
+		}
+		else {
+			refWriteWord(mem, address, value);
+		}
+
+		if (!pre && step) {
+			address += step;
+			r[addressReg] = address;
+		}
+		return;
+	}
+	case OP_MOVL:
+		r[dst] = (r[dst] & 0xFF00) | ((word >> 3) & 0xFF);
+		return;
+	case OP_MOVLZ:
+		r[dst] = (word >> 3) & 0xFF;
+		return;
+	case OP_MOVLS:
+		r[dst] = 0xFF00 | ((word >> 3) & 0xFF);
+		return;
+	case OP_MOVH:
+		r[dst] = (r[dst] & 0x00FF) | (((word >> 3) & 0xFF) << 8);
+		return;
+	case OP_LDR: case OP_STR:
+	{
+		int16_t offset = (int16_t)(word << 2) >> 9; // sign-extend bits 13-7
+		if (op == OP_LDR) {
+			uint16_t address = r[srcIndex] + offset;
+			refWriteResult(state, dst, byteMode ? mem[address] : refReadWord(mem, address), byteMode);
+		}
+		else {
+			uint16_t address = r[dst] + offset;
+			if (byteMode) {
+				mem[address] = r[srcIndex] & 0xFF;
+			}
+			else {
+				refWriteWord(mem, address, r[srcIndex]);
+			}
+		}
+		return;
+	}
+	default:
+		return;
+	}
+}
+
+static void buildReferenceDecoder() {
+	size_t patternCount = sizeof(refPatterns) / sizeof(refPatterns[0]);
+
+	for (uint32_t word = 0; word < 65536; word++) {
+		refOpTable[word] = OP_ILLEGAL;
+		for (size_t i = 0; i < patternCount; i++) {
+			if ((word & refPatterns[i].mask) == refPatterns[i].match) {
+				refOpTable[word] = refPatterns[i].op;
+				break;
+			}
+		}
+	}
+}
+
+// one mismatch, kept for the report
+typedef struct {
+	uint16_t word;
+	int seed;
+	MachineState before;
+	MachineState expected;
+	MachineState actual;
+	int memoryDiffers;
+	int decodeDiffers;
+} Mismatch;
+
+typedef struct {
+	uint64_t count;
+	int exampleCount;
+	Mismatch examples[MAX_EXAMPLES];
+} OpcodeMismatches;
+
+// shared by the workers
+typedef struct {
+	int seedCount;
+	volatile uint32_t nextBlock;
+	HostMutex resultsMutex;
+	OpcodeMismatches results[OP_COUNT];
+	uint64_t executions;
+} SweepContext;
+
+// xorshift generator, seeded per seed number so every worker sees the same machine states
+static uint32_t nextRandom(uint32_t* state) {
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+static void makeSeedState(int seed, MachineState* state, uint8_t* mem) {
+	uint32_t random = 0x9E3779B9u ^ (uint32_t)(seed * 2654435761u);
+	if (random == 0) random = 1;
+
+	for (int i = 0; i < REGISTER_COUNT; i++) {
+		state->registers[i] = (uint16_t)nextRandom(&random);
+	}
+
+	// small seed numbers get edge values so carries, zeros and sign changes are always covered
+	if (seed < 16) {
+		static const uint16_t edges[16] = {
+			0x0000, 0x0001, 0x7FFF, 0x8000, 0xFFFF, 0x00FF, 0x0080, 0x007F,
+			0xFF00, 0x0099, 0x9999, 0x0009, 0x0090, 0x1234, 0x8080, 0x7F7F
+		};
+		for (int i = 0; i < REGISTER_COUNT; i++) {
+			state->registers[i] = edges[(seed + i) % 16];
+		}
+	}
+
+	// flags and priorities only, the PC comes from the register seeds
+	state->psw = (uint16_t)nextRandom(&random) & (PSW_PP_MASK | PSW_CP_MASK | PSW_V | PSW_N | PSW_Z | PSW_C);
+	state->cexExecute = 0;
+	state->cexSkip = 0;
+
+	for (int i = 0; i < MEMORY_SIZE; i += 4) {
+		uint32_t bytes = nextRandom(&random);
+		memcpy(mem + i, &bytes, 4);
+	}
+}
+
+// loads a machine state into the emulator's globals
+static void loadEmulatorState(const MachineState* state) {
+	memcpy(registerFile, state->registers, sizeof(registerFile));
+	PSW = state->psw;
+	cexExecuteCount = 0;
+	cexSkipCount = 0;
+	interruptPending = 0;
+}
+
+static void saveEmulatorState(MachineState* state) {
+	memcpy(state->registers, registerFile, sizeof(registerFile));
+	state->psw = PSW;
+	state->cexExecute = cexExecuteCount;
+	state->cexSkip = cexSkipCount;
+}
+
+// compares field by field, the struct has padding
+static int statesMatch(const MachineState* a, const MachineState* b) {
+	return memcmp(a->registers, b->registers, sizeof(a->registers)) == 0 && a->psw == b->psw &&
+		a->cexExecute == b->cexExecute && a->cexSkip == b->cexSkip;
+}
+
+static void recordMismatch(OpcodeMismatches* results, const Mismatch* mismatch) {
+	OpcodeMismatches* entry = &results[refOpTable[mismatch->word]];
+	entry->count++;
+	if (entry->exampleCount < MAX_EXAMPLES) {
+		entry->examples[entry->exampleCount++] = *mismatch;
+	}
+}
+
+// worker thread, takes blocks of instruction words until the whole space has been swept
+static void sweepWorker(void* argument) {
+	SweepContext* context = (SweepContext*)argument;
+	OpcodeMismatches* results = (OpcodeMismatches*)calloc(OP_COUNT, sizeof(OpcodeMismatches));
+	uint8_t* seedMemory = (uint8_t*)malloc(MEMORY_SIZE);
+	uint8_t* refMemory = (uint8_t*)malloc(MEMORY_SIZE);
+	uint64_t executions = 0;
+
+	// each worker runs its own machine, the emulator state is thread-local
+	initializeMemory();
+	initializeRegisterFile();
+	initializeInterrupts();
+	traceEnabled = 0;
+
+	if (results == NULL || seedMemory == NULL || refMemory == NULL) {
+		printf("Conformance error: Out of memory in worker\n");
+		return;
+	}
+
+	while (1) {
+		uint32_t block = atomicAdd32(&context->nextBlock, 1);
+		if (block * WORD_BLOCK_SIZE >= 65536) {
+			break;
+		}
+
+		for (int seed = 0; seed < context->seedCount; seed++) {
+			MachineState seedState;
+			makeSeedState(seed, &seedState, seedMemory);
+			memcpy(memory, seedMemory, MEMORY_SIZE);
+			memcpy(refMemory, seedMemory, MEMORY_SIZE);
+
+			for (uint32_t word = block * WORD_BLOCK_SIZE; word < (block + 1) * WORD_BLOCK_SIZE; word++) {
+				MachineState expected = seedState;
+				MachineState actual;
+				Instruction instruction;
+				int touchesMemory = refOpTable[word] == OP_ST || refOpTable[word] == OP_STR || refOpTable[word] == OP_SVC;
+
+				// both machines see the instruction as just fetched, with the PC already past it
+				expected.registers[R_PC] += 2;
+				loadEmulatorState(&expected);
+
+				int decoded = decode((uint16_t)word, &instruction);
+				if (decoded) {
+					execute(&instruction);
+				}
+				saveEmulatorState(&actual);
+
+				refExecute((uint16_t)word, &expected, refMemory);
+				executions++;
+
+				int decodeDiffers = decoded != (refOpTable[word] != OP_ILLEGAL);
+				int memoryDiffers = touchesMemory && memcmp(memory, refMemory, MEMORY_SIZE) != 0;
+
+				if (decodeDiffers || memoryDiffers || !statesMatch(&expected, &actual)) {
+					Mismatch mismatch;
+					mismatch.word = (uint16_t)word;
+					mismatch.seed = seed;
+					mismatch.before = seedState;
+					mismatch.expected = expected;
+					mismatch.actual = actual;
+					mismatch.memoryDiffers = memoryDiffers;
+					mismatch.decodeDiffers = decodeDiffers;
+					recordMismatch(results, &mismatch);
+				}
+
+				// keep the two memories identical so one bad store doesn't fail everything after it
+				if (memoryDiffers) {
+					memcpy(memory, refMemory, MEMORY_SIZE);
+				}
+			}
+		}
+	}
+
+	// merge into the shared results
+	hostMutexLock(&context->resultsMutex);
+	for (int op = 0; op < OP_COUNT; op++) {
+		OpcodeMismatches* shared = &context->results[op];
+		shared->count += results[op].count;
+		for (int i = 0; i < results[op].exampleCount && shared->exampleCount < MAX_EXAMPLES; i++) {
+			shared->examples[shared->exampleCount++] = results[op].examples[i];
+		}
+	}
+	context->executions += executions;
+	hostMutexUnlock(&context->resultsMutex);
+
+	free(results);
+	free(seedMemory);
+	free(refMemory);
+	cleanupMemory();
+}
+
+// compares bcdAdd against the reference digit adder, every byte pair both ways of carry plus random words
+// returns the number of inputs that differ in result or carry
+static uint64_t checkDecimalAdder() {
+	uint64_t failures = 0;
+	uint32_t random = 0x2545F491;
+
+	for (uint32_t i = 0; i < (1u << 17) + BCD_WORD_SAMPLES; i++) {
+		int byteMode = i < (1u << 17);
+		uint16_t dst = byteMode ? (i & 0xFF) : (uint16_t)nextRandom(&random);
+		uint16_t src = byteMode ? ((i >> 8) & 0xFF) : (uint16_t)nextRandom(&random);
+		int carryIn = byteMode ? (i >> 16) & 1 : nextRandom(&random) & 1;
+		MachineState expected = { 0 };
+		int carryOut;
+
+		uint16_t result = bcdAdd(dst, src, carryIn, byteMode, &carryOut);
+		uint16_t reference = refDecimalAdd(&expected, dst, src, carryIn, byteMode);
+
+		if (result != reference || carryOut != ((expected.psw & PSW_C) != 0)) {
+			if (failures++ < MAX_EXAMPLES) {
+				printf("    DADD%s 0x%04X + 0x%04X + %d = 0x%04X carry %d, expected 0x%04X carry %d\n", byteMode ? ".B" : "",
+					dst, src, carryIn, result, carryOut, reference, (expected.psw & PSW_C) != 0);
+			}
+		}
+	}
+
+	printf("Decimal adder: %u byte and %u word inputs, %llu mismatches\n\n",
+		1u << 17, BCD_WORD_SAMPLES, (unsigned long long)failures);
+	return failures;
+}
+
+// prints the fields that differ between the expected and actual state
+static void printMismatch(const Mismatch* mismatch) {
+	printf("    0x%04X seed %d:", mismatch->word, mismatch->seed);
+
+	if (mismatch->decodeDiffers) {
+		printf(" decode %s", refOpTable[mismatch->word] == OP_ILLEGAL ? "accepted an illegal word" : "rejected a legal word");
+	}
+	for (int i = 0; i < REGISTER_COUNT; i++) {
+		if (mismatch->expected.registers[i] != mismatch->actual.registers[i]) {
+			printf(" R%d=0x%04X expected 0x%04X (was 0x%04X)", i,
+				mismatch->actual.registers[i], mismatch->expected.registers[i], mismatch->before.registers[i]);
+		}
+	}
+	if (mismatch->expected.psw != mismatch->actual.psw) {
+		printf(" PSW=0x%04X expected 0x%04X (was 0x%04X)", mismatch->actual.psw, mismatch->expected.psw, mismatch->before.psw);
+	}
+	if (mismatch->expected.cexExecute != mismatch->actual.cexExecute || mismatch->expected.cexSkip != mismatch->actual.cexSkip) {
+		printf(" CEX=%d/%d expected %d/%d", mismatch->actual.cexExecute, mismatch->actual.cexSkip,
+			mismatch->expected.cexExecute, mismatch->expected.cexSkip);
+	}
+	if (mismatch->memoryDiffers) {
+		printf(" memory differs");
+	}
+	printf("\n");
+}
+
+int runConformanceSweep(int seedCount, int threadCount) {
+	SweepContext* context = (SweepContext*)calloc(1, sizeof(SweepContext));
+	HostThread* threads;
+	uint64_t totalMismatches = 0;
+
+	if (seedCount <= 0) seedCount = CONFORMANCE_DEFAULT_SEEDS;
+	if (threadCount <= 0) threadCount = hostProcessorCount();
+
+	threads = (HostThread*)malloc(threadCount * sizeof(HostThread));
+	if (context == NULL || threads == NULL) {
+		printf("Conformance error: Out of memory\n");
+		return -1;
+	}
+
+	context->seedCount = seedCount;
+	hostMutexInit(&context->resultsMutex);
+	buildReferenceDecoder();
+
+	printf("Conformance sweep: 65536 instruction words x %d seeds on %d threads\n\n", seedCount, threadCount);
+
+	totalMismatches += checkDecimalAdder();
+
+	clock_t start = clock();
+	time_t wallStart = time(NULL);
+
+	int started = 0;
+	for (int i = 0; i < threadCount; i++) {
+		if (hostThreadCreate(&threads[i], sweepWorker, context)) {
+			started++;
+		}
+		else {
+			printf("Conformance error: Unable to start worker %d\n", i);
+			break;
+		}
+	}
+	for (int i = 0; i < started; i++) {
+		hostThreadJoin(threads[i]);
+	}
+
+	double cpuSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	double wallSeconds = difftime(time(NULL), wallStart);
+
+	printf("%-10s %12s\n", "Opcode", "Mismatches");
+	printf("-----------------------\n");
+	for (int op = 0; op < OP_COUNT; op++) {
+		OpcodeMismatches* entry = &context->results[op];
+		if (entry->count == 0) {
+			continue;
+		}
+
+		totalMismatches += entry->count;
+		printf("%-10s %12llu\n", refOpNames[op], (unsigned long long)entry->count);
+		for (int i = 0; i < entry->exampleCount; i++) {
+			printMismatch(&entry->examples[i]);
+		}
+	}
+
+	printf("\n%llu executions, %llu mismatches (%.0f s wall, %.1f s cpu)\n",
+		(unsigned long long)context->executions, (unsigned long long)totalMismatches, wallSeconds, cpuSeconds);
+
+	hostMutexDestroy(&context->resultsMutex);
+	free(threads);
+	free(context);
+
+	return totalMismatches > 0x7FFFFFFF ? 0x7FFFFFFF : (int)totalMismatches;
+}
@@ -0,0 +1,11 @@
+#ifndef CONFORMANCE_H
+#define CONFORMANCE_H
+
+#define CONFORMANCE_DEFAULT_SEEDS 1024 // register/PSW/memory seeds run against every instruction word
+
+// runs every one of the 65536 instruction words through decode() and execute() for seedCount machine states,
+// compares each result against an independent reference model and prints the mismatches grouped by opcode
+// threadCount of 0 uses every host processor, returns the number of mismatches found
+int runConformanceSweep(int seedCount, int threadCount);
+
+#endif // !CONFORMANCE_H
@@ -0,0 +1,508 @@
+#define _CRT_SECURE_NO_WARNINGS // to avoid errors on functions like sscanf
+
+#include "console.h"
+#include "cpu.h"
+#include "decode.h"
+#include "memory.h"
+#include "platform.h"
+#include "registers.h"
+#include "spsc.h"
+#include "state_export.h"
+#include "state_hash.h"
+#include "uart.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STATUS_DATA_BYTES 32 // memory bytes carried per dump record
+
+// commands from the input thread to the cpu
+typedef enum {
+	COMMAND_GO,			// run
+	COMMAND_HOLD,		// pause
+	COMMAND_NEXT,		// run one instruction, while held
+	COMMAND_REGISTERS,	// send the registers and PSW
+	COMMAND_DUMP,		// send memory, address and length
+	COMMAND_SET_PC,		// move the PC
+	COMMAND_BREAK,		// set the breakpoint, or clear it when value is 0
+	COMMAND_TRACE,		// toggle per-instruction trace records
+	COMMAND_HASH,		// send the machine state hash
+	COMMAND_USAGE,		// echo a UsageMessage (address) back to the renderer
+	COMMAND_QUIT,		// stop now
+	COMMAND_DETACH		// input has ended, stop once the cpu does
+} CommandType;
+
+// help the input thread asks for, printed by the renderer so the terminal has a single writer
+typedef enum {
+	USAGE_COMMANDS,		// the command list
+	USAGE_DUMP,			// D was given a bad address or length
+	USAGE_PC			// P was given a bad address
+} UsageMessage;
+
+typedef struct {
+	CommandType type;
+	uint32_t address;
+	uint32_t length;
+} ConsoleCommand;
+
+// records from the cpu to the renderer
+typedef enum {
+	STATUS_REGISTERS,	// snapshot taken between instructions
+	STATUS_MEMORY,		// one piece of a dump, the last has final set
+	STATUS_TRACE,		// an instruction about to run
+	STATUS_STOPPED,		// the cpu stopped on its own, reason says why
+	STATUS_NOTE,		// acknowledges a command, text says what
+	STATUS_USAGE,		// reason is the UsageMessage to print
+	STATUS_OUTPUT,		// guest console output, length bytes of data
+	STATUS_EXIT			// the cpu loop has finished, the renderer should too
+} StatusType;
+
+typedef struct {
+	StatusType type;
+	int reason;			// CPU_* status for STATUS_STOPPED, -1 for a breakpoint
+	int final;
+	uint16_t address;	// PC for registers, trace and stops, start address for memory
+	uint16_t word;		// instruction word for trace
+	uint16_t length;	// bytes used in data, for memory and output
+	uint16_t psw;
+	uint16_t registers[REGISTER_COUNT];
+	uint64_t cycles;
+	uint64_t instructions;
+	uint32_t dropped;	// trace records lost to a full queue since the last one that got through
+	char text[STATUS_DATA_BYTES];
+	uint8_t data[STATUS_DATA_BYTES];
+} ConsoleStatus;
+
+static SpscQueue commandQueue;	// input thread to cpu
+static SpscQueue statusQueue;	// cpu to renderer
+
+// cpu side state, only touched on the cpu thread
+static int running = 1;
+static int tracing = 0;
+static int finished = 0;
+static uint32_t breakPointAddress = 0x10000; // out of range when no breakpoint is set
+static uint32_t droppedTrace = 0;
+
+static void fillSnapshot(ConsoleStatus* status) {
+	memcpy(status->registers, registerFile, sizeof(status->registers));
+	status->psw = PSW;
+	status->address = registerFile[R_PC];
+	status->cycles = cpuClock;
+	status->instructions = instructionCount;
+}
+
+// records the user asked for are worth waiting a moment for, the queue only fills when tracing floods it
+static void pushStatus(const ConsoleStatus* status) {
+	while (!spscPush(&statusQueue, status)) {
+		hostSleep(1);
+	}
+}
+
+static void pushNote(const char* text) {
+	ConsoleStatus status;
+
+	memset(&status, 0, sizeof(status));
+	status.type = STATUS_NOTE;
+	strncpy(status.text, text, sizeof(status.text) - 1);
+	pushStatus(&status);
+}
+
+static void pushStopped(int reason) {
+	ConsoleStatus status;
+
+	// whatever the guest wrote before stopping is shown ahead of the stop, a monitor sees the stopped state
+	uartFlush();
+	publishExport();
+	memset(&status, 0, sizeof(status));
+	status.type = STATUS_STOPPED;
+	status.reason = reason;
+	fillSnapshot(&status);
+	pushStatus(&status);
+}
+
+// copies the range in pieces, all taken between the same two instructions
+static void pushMemory(uint32_t address, uint32_t length) {
+	ConsoleStatus status;
+
+	if (length > CONSOLE_DUMP_MAX) {
+		length = CONSOLE_DUMP_MAX;
+	}
+	memset(&status, 0, sizeof(status));
+	status.type = STATUS_MEMORY;
+	do {
+		uint32_t piece = length < STATUS_DATA_BYTES ? length : STATUS_DATA_BYTES;
+
+		status.address = (uint16_t)address;
+		status.length = (uint16_t)piece;
+		for (uint32_t i = 0; i < piece; i++) {
+			status.data[i] = memory[(uint16_t)(address + i)];
+		}
+		address += piece;
+		length -= piece;
+		status.final = length == 0;
+		pushStatus(&status);
+	} while (length > 0);
+}
+
+// guest output shares the queue so it stays in order with stops and notes, it only waits if the renderer is far behind
+static void pushOutput(const char* data, int length) {
+	ConsoleStatus status;
+
+	memset(&status, 0, sizeof(status));
+	status.type = STATUS_OUTPUT;
+	while (length > 0) {
+		int piece = length < STATUS_DATA_BYTES ? length : STATUS_DATA_BYTES;
+
+		memcpy(status.data, data, piece);
+		status.length = (uint16_t)piece;
+		pushStatus(&status);
+		data += piece;
+		length -= piece;
+	}
+}
+
+// trace never holds the cpu up, records that don't fit are counted and reported with the next one
+static void pushTrace() {
+	ConsoleStatus status;
+	uint16_t pc = registerFile[R_PC];
+
+	status.type = STATUS_TRACE;
+	status.address = pc;
+	status.word = memory[pc] | (memory[(uint16_t)(pc + 1)] << 8);
+	status.cycles = cpuClock;
+	status.dropped = droppedTrace;
+	if (spscPush(&statusQueue, &status)) {
+		droppedTrace = 0;
+	}
+	else {
+		droppedTrace++;
+	}
+}
+
+static void runCommand(const ConsoleCommand* command) {
+	ConsoleStatus status;
+	char note[STATUS_DATA_BYTES];
+
+	switch (command->type) {
+	case COMMAND_GO:
+		running = !finished;
+		pushNote(finished ? "Program has finished" : "Running");
+		break;
+	case COMMAND_HOLD:
+		running = 0;
+		pushStopped(CPU_RUNNING);
+		break;
+	case COMMAND_NEXT:
+		if (!running && !finished) {
+			if (tracing) {
+				pushTrace();
+			}
+			int result = cpuStep();
+			if (result != CPU_RUNNING) {
+				finished = 1;
+			}
+			pushStopped(result);
+		}
+		else {
+			pushNote(finished ? "Program has finished" : "Hold before stepping");
+		}
+		break;
+	case COMMAND_REGISTERS:
+		memset(&status, 0, sizeof(status));
+		status.type = STATUS_REGISTERS;
+		fillSnapshot(&status);
+		pushStatus(&status);
+		break;
+	case COMMAND_DUMP:
+		pushMemory(command->address, command->length);
+		break;
+	case COMMAND_SET_PC:
+		registerFile[R_PC] = (uint16_t)command->address;
+		snprintf(note, sizeof(note), "PC set to 0x%04X", registerFile[R_PC]);
+		pushNote(note);
+		break;
+	case COMMAND_BREAK:
+		breakPointAddress = command->address ? command->address : 0x10000;
+		if (command->address) {
+			snprintf(note, sizeof(note), "Breakpoint at 0x%04X", command->address);
+		}
+		else {
+			snprintf(note, sizeof(note), "Breakpoint cleared");
+		}
+		pushNote(note);
+		break;
+	case COMMAND_TRACE:
+		tracing = !tracing;
+		pushNote(tracing ? "Trace on" : "Trace off");
+		break;
+	case COMMAND_HASH:
+		snprintf(note, sizeof(note), "State hash %016llX", (unsigned long long)hashMachineState());
+		pushNote(note);
+		break;
+	case COMMAND_USAGE:
+		memset(&status, 0, sizeof(status));
+		status.type = STATUS_USAGE;
+		status.reason = (int)command->address;
+		pushStatus(&status);
+		break;
+	case COMMAND_QUIT:
+	case COMMAND_DETACH:
+		break;
+	}
+}
+
+// runs up to a batch of cycles, the plain headless loop unless a breakpoint or trace needs looking at each step
+static void runBatch() {
+	uint64_t limit = cpuClock + CONSOLE_BATCH_CYCLES;
+	int status = CPU_RUNNING;
+
+	if (breakPointAddress > 0xFFFF && !tracing) {
+		status = cpuRun(limit);
+	}
+	else {
+		while (status == CPU_RUNNING && cpuClock < limit) {
+			if (tracing) {
+				pushTrace();
+			}
+			status = cpuStep();
+			if (status == CPU_RUNNING && registerFile[R_PC] == breakPointAddress) {
+				running = 0;
+				pushStopped(-1);
+				return;
+			}
+		}
+	}
+
+	if (status != CPU_RUNNING) {
+		running = 0;
+		finished = 1;
+		pushStopped(status);
+	}
+}
+
+static void printRegisters(const ConsoleStatus* status) {
+	printf("Register         Value\n");
+	printf("---------------------------\n\n");
+	for (int i = 0; i < REGISTER_COUNT; i++) {
+		printf("R%d               0x%04x\n", i, status->registers[i]);
+	}
+	printf("\nPSW 0x%04x  PP %d  FLT %d  CP %d  V %d  SLP %d  N %d  Z %d  C %d\n", status->psw,
+		(status->psw & PSW_PP_MASK) >> 13, (status->psw & PSW_FLT_MASK) >> 8, (status->psw & PSW_CP_MASK) >> 5,
+		(status->psw & PSW_V_MASK) >> 4, (status->psw & PSW_SLP_MASK) >> 3, (status->psw & PSW_N_MASK) >> 2,
+		(status->psw & PSW_Z_MASK) >> 1, status->psw & PSW_C_MASK);
+	printf("CPU Clock: %llu, %llu instructions\n\n", (unsigned long long)status->cycles, (unsigned long long)status->instructions);
+}
+
+static void printHelp() {
+	printf("\nCommands, the cpu keeps running while you type:\n");
+	printf("  [G] go | [H] hold | [N] next instruction (held) | [R] registers and PSW | [D <addr> <len>] dump memory\n");
+	printf("  [P <addr>] change PC | [B <addr>] set breakpoint, [B] clears it | [T] toggle trace | [#] state hash | [S] stop\n\n");
+}
+
+static void printStatus(const ConsoleStatus* status) {
+	Instruction instruction;
+
+	switch (status->type) {
+	case STATUS_REGISTERS:
+		printRegisters(status);
+		break;
+	case STATUS_MEMORY:
+		for (int i = 0; i < status->length; i += 16) {
+			printf("0x%04X  ", (uint16_t)(status->address + i));
+			for (int j = i; j < i + 16 && j < status->length; j++) {
+				printf(" %02X", status->data[j]);
+			}
+			printf("\n");
+		}
+		if (status->final) {
+			printf("\n");
+		}
+		break;
+	case STATUS_TRACE:
+		if (status->dropped) {
+			printf("  ... %u trace records dropped\n", status->dropped);
+		}
+		printf("%10llu  0x%04X  %04X  %s\n", (unsigned long long)status->cycles, status->address, status->word,
+			decode(status->word, &instruction) ? instruction.mnemonic : "?");
+		break;
+	case STATUS_STOPPED:
+		printf("\n%s at PC 0x%04X, CPU Clock: %llu\n",
+			status->reason == -1 ? "Breakpoint encountered" :
+			status->reason == CPU_HALTED ? "End of program reached (0x0000 encountered)" :
+			status->reason == CPU_ASLEEP ? "CPU is asleep with nothing that could wake it" :
+			status->reason == CPU_FAULTED ? "Fault" : "Held",
+			status->address, (unsigned long long)status->cycles);
+		break;
+	case STATUS_NOTE:
+		printf("%s\n", status->text);
+		break;
+	case STATUS_USAGE:
+		if (status->reason == USAGE_DUMP) {
+			printf("Invalid input. Usage: D <start_address (hex)> <length (decimal)>\n");
+		}
+		else if (status->reason == USAGE_PC) {
+			printf("Invalid PC value. Please enter in hex format\n");
+		}
+		else {
+			printHelp();
+		}
+		break;
+	case STATUS_OUTPUT:
+		fwrite(status->data, 1, status->length, stdout);
+		break;
+	case STATUS_EXIT:
+		break;
+	}
+}
+
+// renders status records until the cpu loop says it has finished
+static void renderer(void* argument) {
+	ConsoleStatus status;
+
+	(void)argument;
+	while (1) {
+		if (!spscPop(&statusQueue, &status)) {
+			fflush(stdout);
+			hostSleep(CONSOLE_IDLE_MS);
+			continue;
+		}
+		if (status.type == STATUS_EXIT) {
+			break;
+		}
+		printStatus(&status);
+	}
+	fflush(stdout);
+}
+
+// queues a command, the cpu drains the queue between batches so this only fails if it is far behind
+static void sendCommand(CommandType type, uint32_t address, uint32_t length) {
+	ConsoleCommand command = { type, address, length };
+
+	while (!spscPush(&commandQueue, &command)) {
+		hostSleep(CONSOLE_IDLE_MS);
+	}
+}
+
+// reads command lines, the only thread that waits on the terminal, anything it has to say goes through the cpu
+// to the renderer like every other message
+static void inputReader(void* argument) {
+	char input[64];
+
+	(void)argument;
+	while (fgets(input, sizeof(input), stdin) != NULL) {
+		unsigned int address, length;
+		char letter = input[0];
+
+		switch (letter) {
+		case 'G': case 'g': sendCommand(COMMAND_GO, 0, 0); break;
+		case 'H': case 'h': sendCommand(COMMAND_HOLD, 0, 0); break;
+		case 'N': case 'n': sendCommand(COMMAND_NEXT, 0, 0); break;
+		case 'R': case 'r': case 'W': case 'w': sendCommand(COMMAND_REGISTERS, 0, 0); break;
+		case 'T': case 't': sendCommand(COMMAND_TRACE, 0, 0); break;
+		case '#': sendCommand(COMMAND_HASH, 0, 0); break;
+		case 'S': case 's': case 'Q': case 'q': sendCommand(COMMAND_QUIT, 0, 0); return;
+		case 'D': case 'd':
+			if (sscanf(input + 1, "%x %u", &address, &length) == 2 && address < MEMORY_SIZE) {
+				sendCommand(COMMAND_DUMP, address, length);
+			}
+			else {
+				sendCommand(COMMAND_USAGE, USAGE_DUMP, 0);
+			}
+			break;
+		case 'P': case 'p':
+			if (sscanf(input + 1, "%x", &address) == 1 && address < MEMORY_SIZE) {
+				sendCommand(COMMAND_SET_PC, address, 0);
+			}
+			else {
+				sendCommand(COMMAND_USAGE, USAGE_PC, 0);
+			}
+			break;
+		case 'B': case 'b':
+			if (sscanf(input + 1, "%x", &address) == 1 && address < MEMORY_SIZE) {
+				sendCommand(COMMAND_BREAK, address, 0);
+			}
+			else {
+				sendCommand(COMMAND_BREAK, 0, 0);
+			}
+			break;
+		case '\n':
+			break;
+		default:
+			sendCommand(COMMAND_USAGE, USAGE_COMMANDS, 0);
+			break;
+		}
+	}
+
+	// with no more commands coming the program is left to run to its end
+	sendCommand(COMMAND_DETACH, 0, 0);
+}
+
+void runConsole() {
+	HostThread renderThread, inputThread;
+	ConsoleCommand command;
+	ConsoleStatus exitStatus;
+	int quit = 0;
+	int detached = 0;
+
+	if (!spscInit(&commandQueue, sizeof(ConsoleCommand), CONSOLE_QUEUE_SIZE) ||
+		!spscInit(&statusQueue, sizeof(ConsoleStatus), CONSOLE_QUEUE_SIZE)) {
+		printf("Console error: Unable to allocate queues\n");
+		return;
+	}
+
+	// the cpu stays on this thread, which holds the loaded machine, per-instruction printing is replaced by trace records
+	traceEnabled = 0;
+	uartSetOutputHandler(pushOutput);
+	printHelp();
+	if (!hostThreadCreate(&renderThread, renderer, NULL)) {
+		printf("Console error: Unable to start the render thread\n");
+		uartSetOutputHandler(NULL);
+		return;
+	}
+	if (!hostThreadCreate(&inputThread, inputReader, NULL)) {
+		printf("Console error: Unable to start the input thread\n");
+		quit = 1;
+	}
+
+	uint64_t lastFlush = hostTimeNanoseconds();
+	while (!quit) {
+		while (spscPop(&commandQueue, &command)) {
+			if (command.type == COMMAND_QUIT) {
+				quit = 1;
+				break;
+			}
+			detached |= command.type == COMMAND_DETACH;
+			runCommand(&command);
+		}
+		if (quit || (detached && !running)) {
+			break;
+		}
+
+		if (running) {
+			runBatch();
+		}
+		else {
+			hostSleep(CONSOLE_IDLE_MS);
+		}
+
+		// guest output goes to the renderer in batches, often enough to look live
+		uint64_t now = hostTimeNanoseconds();
+		if (!running || now - lastFlush >= CONSOLE_FLUSH_NS) {
+			uartFlush();
+			lastFlush = now;
+		}
+	}
+
+	uartFlush();
+	memset(&exitStatus, 0, sizeof(exitStatus));
+	exitStatus.type = STATUS_EXIT;
+	pushStatus(&exitStatus);
+	hostThreadJoin(renderThread);
+	uartSetOutputHandler(NULL);
+
+	// the input thread has returned or is blocked reading a line nobody needs, it ends with the process
+	printf("Stopped after %llu cycles, %llu instructions\n", (unsigned long long)cpuClock, (unsigned long long)instructionCount);
+	spscDestroy(&commandQueue);
+	spscDestroy(&statusQueue);
+}
@@ -0,0 +1,18 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stdint.h>
+
+#define CONSOLE_BATCH_CYCLES 20000		// cycles run between checks for commands
+#define CONSOLE_IDLE_MS 2				// sleep between command checks while held, and between renders when idle
+#define CONSOLE_FLUSH_NS 50000000ULL	// guest console output is written out at least this often
+#define CONSOLE_QUEUE_SIZE 4096			// entries in each of the command and status queues
+#define CONSOLE_DUMP_MAX 1024			// largest memory dump one command returns
+
+// runs the loaded program on this thread with the console on threads of its own, the run loop never
+// waits on the terminal: commands come in and registers, memory, stops, trace and guest output go out through lock-free
+// single-producer single-consumer queues, registers and memory can be inspected while the cpu runs
+// trace records that don't fit in the status queue are dropped and counted rather than slowing the cpu
+void runConsole();
+
+#endif // !CONSOLE_H
@@ -0,0 +1,215 @@
+#define _CRT_SECURE_NO_WARNINGS // to avoid errors on functions like fopen
+
+#include "coverage.h"
+#include "decode.h"
+#include "file_decoder.h"
+#include "state_hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COVERAGE_MAGIC "XM23COV2"
+
+THREAD_LOCAL CoverageMap* coverageMap = NULL;
+static THREAD_LOCAL uint64_t imageHash;	// the program coverage is being collected for, taken before it runs
+
+// coverage file layout: magic, number of runs merged, hash of the image they ran, then the bitmaps as in memory
+typedef struct {
+	char magic[8];
+	uint32_t runs;
+	uint32_t reserved;
+	uint64_t imageHash;
+} CoverageHeader;
+
+// hashes which addresses were loaded and the bytes loaded there
+static uint64_t hashLoadedImage() {
+	uint64_t hash = hashBytes(loadedImageMap, sizeof(loadedImageMap), 0);
+
+	for (uint32_t address = 0; address < MEMORY_SIZE; address += 2) {
+		if (isLoadedAddress((uint16_t)address)) {
+			hash = hashBytes(&memory[address], 2, hash ^ address);
+		}
+	}
+	return hash;
+}
+
+int startCoverage() {
+	coverageMap = (CoverageMap*)calloc(1, sizeof(CoverageMap));
+	if (coverageMap == NULL) {
+		printf("Coverage error: Unable to allocate coverage map\n");
+		return 0;
+	}
+	imageHash = hashLoadedImage();
+	return 1;
+}
+
+// ORs a previously saved coverage file into the map, returns the number of runs it held (0 if there is no file)
+static uint32_t mergeCoverageFile(const char* path, CoverageMap* map) {
+	FILE* file = fopen(path, "rb");
+	CoverageHeader header;
+	CoverageMap* saved;
+	uint32_t runs = 0;
+
+	if (file == NULL) {
+		return 0;
+	}
+
+	saved = (CoverageMap*)malloc(sizeof(CoverageMap));
+	if (saved == NULL ||
+		fread(&header, sizeof(header), 1, file) != 1 ||
+		memcmp(header.magic, COVERAGE_MAGIC, sizeof(header.magic)) != 0 ||
+		fread(saved, sizeof(CoverageMap), 1, file) != 1) {
+		printf("Coverage warning: %s is not a coverage file, it will be overwritten\n", path);
+	}
+	else if (header.imageHash != imageHash) {
+		printf("Coverage warning: %s was collected for a different image, it will be started again\n", path);
+	}
+	else {
+		uint8_t* destination = (uint8_t*)map;
+		uint8_t* source = (uint8_t*)saved;
+
+		for (size_t i = 0; i < sizeof(CoverageMap); i++) {
+			destination[i] |= source[i];
+		}
+		runs = header.runs;
+	}
+
+	free(saved);
+	fclose(file);
+	return runs;
+}
+
+static int saveCoverageFile(const char* path, const CoverageMap* map, uint32_t runs) {
+	FILE* file = fopen(path, "wb");
+	CoverageHeader header;
+
+	if (file == NULL) {
+		printf("Coverage error: Unable to write %s\n", path);
+		return 0;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, COVERAGE_MAGIC, sizeof(header.magic));
+	header.runs = runs;
+	header.imageHash = imageHash;
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(map, sizeof(CoverageMap), 1, file);
+	fclose(file);
+	return 1;
+}
+
+// decodes the loaded word at address, returns 1 if it is a conditional branch
+static int isConditionalBranch(uint16_t address, Instruction* instruction) {
+	uint16_t word = memory[address] | (memory[(uint16_t)(address + 1)] << 8);
+
+	if (!decode(word, instruction)) {
+		return 0;
+	}
+	return instruction->type == TOC && strcmp(instruction->mnemonic, "BL") != 0 && strcmp(instruction->mnemonic, "BRA") != 0;
+}
+
+// writes every loaded word with its mnemonic, marking the ones never executed and the branch outcomes seen
+static int writeListing(const char* path, const CoverageMap* map) {
+	FILE* file = fopen(path, "w");
+	uint32_t lastAddress = 0x10000;
+
+	if (file == NULL) {
+		printf("Coverage error: Unable to write %s\n", path);
+		return 0;
+	}
+
+	fprintf(file, "XM-23 coverage listing, '>>>' marks words never executed\n");
+
+	for (uint32_t address = 0; address < MEMORY_SIZE; address += 2) {
+		if (!isLoadedAddress((uint16_t)address)) {
+			continue;
+		}
+
+		// blank line between separate loaded ranges
+		if (address != lastAddress + 2) {
+			fprintf(file, "\n");
+		}
+		lastAddress = address;
+
+		Instruction instruction;
+		uint16_t word = memory[address] | (memory[address + 1] << 8);
+		int executed = COVERAGE_TEST(map->executed, address);
+		const char* mnemonic = decode(word, &instruction) ? instruction.mnemonic : "";
+
+		fprintf(file, "%s %04X  %04X  %-7s", executed ? "   " : ">>>", address, word, mnemonic);
+
+		if (executed && isConditionalBranch((uint16_t)address, &instruction)) {
+			int taken = COVERAGE_TEST(map->taken, address);
+			int notTaken = COVERAGE_TEST(map->notTaken, address);
+			fprintf(file, "  %s", taken && notTaken ? "both ways" : taken ? "always taken" : "never taken");
+		}
+		fprintf(file, "\n");
+	}
+
+	fclose(file);
+	return 1;
+}
+
+// counts loaded words executed and conditional branches seen going each way
+static void printSummary(const CoverageMap* map, uint32_t runs) {
+	int loadedWords = 0, executedWords = 0;
+	int branches = 0, bothWays = 0, oneWay = 0;
+
+	for (uint32_t address = 0; address < MEMORY_SIZE; address += 2) {
+		Instruction instruction;
+
+		if (!isLoadedAddress((uint16_t)address)) {
+			continue;
+		}
+		loadedWords++;
+
+		if (!COVERAGE_TEST(map->executed, address)) {
+			continue;
+		}
+		executedWords++;
+
+		if (isConditionalBranch((uint16_t)address, &instruction)) {
+			branches++;
+			if (COVERAGE_TEST(map->taken, address) && COVERAGE_TEST(map->notTaken, address)) {
+				bothWays++;
+			}
+			else {
+				oneWay++;
+			}
+		}
+	}
+
+	printf("\nCoverage over %u run%s:\n", runs, runs == 1 ? "" : "s");
+	printf("  Loaded words executed : %d of %d (%.1f%%)\n", executedWords, loadedWords,
+		loadedWords ? 100.0 * executedWords / loadedWords : 0.0);
+	printf("  Conditional branches  : %d executed, %d both ways, %d one way only\n", branches, bothWays, oneWay);
+}
+
+int finishCoverage(const char* coveragePath, const char* listingPath) {
+	CoverageMap* map = coverageMap;
+	int result = 1;
+
+	if (map == NULL) {
+		return 1;
+	}
+	coverageMap = NULL;
+
+	uint32_t runs = mergeCoverageFile(coveragePath, map) + 1;
+	if (!saveCoverageFile(coveragePath, map, runs)) {
+		result = 0;
+	}
+
+	printSummary(map, runs);
+	if (listingPath != NULL) {
+		if (writeListing(listingPath, map)) {
+			printf("  Listing written to %s\n", listingPath);
+		}
+		else {
+			result = 0;
+		}
+	}
+
+	free(map);
+	return result ? 0 : 1;
+}
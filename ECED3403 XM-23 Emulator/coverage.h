@@ -0,0 +1,32 @@
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include <stdint.h>
+#include "memory.h"
+#include "tls.h"
+
+#define COVERAGE_MAP_BYTES (MEMORY_SIZE / 8) // one bit per address, 8 KB
+
+// sets the bit for an address in one of the coverage bitmaps
+#define COVERAGE_SET(bitmap, address) ((bitmap)[(uint16_t)(address) >> 3] |= (uint8_t)(1 << ((address) & 7)))
+#define COVERAGE_TEST(bitmap, address) (((bitmap)[(uint16_t)(address) >> 3] >> ((address) & 7)) & 1)
+
+// bitmaps indexed by instruction address
+typedef struct {
+	uint8_t executed[COVERAGE_MAP_BYTES];	// an instruction was fetched from the address
+	uint8_t taken[COVERAGE_MAP_BYTES];		// the branch at the address was taken
+	uint8_t notTaken[COVERAGE_MAP_BYTES];	// the conditional branch at the address fell through
+} CoverageMap;
+
+// coverage being collected on this thread, NULL when coverage is off
+extern THREAD_LOCAL CoverageMap* coverageMap;
+
+// starts collecting coverage on this thread, returns 0 if the map couldn't be allocated
+int startCoverage();
+
+// stops collecting, merges this run into the coverage file (created if missing, started again if it was collected
+// for a different image) and prints a summary
+// writes an annotated listing of the loaded image when listingPath isn't NULL, returns 0/1 for success/failure
+int finishCoverage(const char* coveragePath, const char* listingPath);
+
+#endif // !COVERAGE_H
@@ -5,7 +5,17 @@
 #include "decode.h"
 #include "execute.h"
 #include "memory.h"
+#include "memory_dump.h"
+#include "state_hash.h"
 #include "registers.h"
+#include "interrupts.h"
+#include "scheduler.h"
+#include "uart.h"
+#include "coverage.h"
+#include "timing.h"
+#include "pipeline.h"
+#include "platform.h"
+#include "state_export.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,19 +23,28 @@
 #include <time.h>
 #include <signal.h>
 
-uint32_t cpuClock = 0;
+THREAD_LOCAL uint64_t cpuClock = 0;
+THREAD_LOCAL uint64_t instructionCount = 0;
+THREAD_LOCAL int traceEnabled = 1; // print per-instruction details, turned off for headless runs
 uint16_t breakPoint = 0;
 int executionSpeedMode = 1; // 0 - slow, 1 - normal, 2 - fast
 
-int braCount = 0; // counter to detect possible end of program on an infinite loop
+THREAD_LOCAL int cexExecuteCount = 0;
+THREAD_LOCAL int cexSkipCount = 0;
+
+THREAD_LOCAL int stopOnFault = 0;
+
+THREAD_LOCAL int braCount = 0; // counter to detect possible end of program on an infinite loop
 int braStopIgnored = 0;
 
 volatile sig_atomic_t ctrl_c_fnd; // control c flag
 
-// time delay settings
+// time delay settings, in milliseconds
 #define SLOW_DELAY		500		// slow mode (0.5 seconds delay per cycle)
 #define NORMAL_DELAY	100		// normal (0.1s)
-#define FAST_DELAY		10		// fast (0.01s)	
+#define FAST_DELAY		10		// fast (0.01s)
+
+#define COMMAND_LENGTH	128		// longest debugger command line, room for a file name
 
 // function to hamdle SIGINT (^C)
 void sigint_hdlr(int signum) {
@@ -43,21 +62,19 @@ void initializePC(uint16_t address) {
 	printf("Program Counter initialized to 0x%04X\n", registerFile[R_PC]);
 }
 
-// function to delay between program step executions
+// function to delay between program step executions, sleeping rather than spinning on clock()
 static void delayExecution() {
-	clock_t start_time = clock();
-	clock_t delay_time;
+	int delay;
 
 	// get delay for selected speed mode
 	switch (executionSpeedMode) {
-		case 0: delay_time = SLOW_DELAY; break;
-		case 1: delay_time = NORMAL_DELAY; break;
-		case 2: delay_time = FAST_DELAY; break;
-		default: delay_time = NORMAL_DELAY; break;
+		case 0: delay = SLOW_DELAY; break;
+		case 1: delay = NORMAL_DELAY; break;
+		case 2: delay = FAST_DELAY; break;
+		default: delay = NORMAL_DELAY; break;
 	}
 
-	// loop until delay is up
-	while ((clock() - start_time) < delay_time);
+	hostSleep(delay);
 }
 
 // function to ask and recieve potential break point from user
@@ -121,12 +138,61 @@ static void getExecutionSpeed() {
 	}
 }
 
+// memory as it was at the last K command, what C compares against without a file
+static uint8_t* memorySnapshot = NULL;
+
+// F <file> [<addr> <len>]: writes memory, all of it by default, to a raw or hex file
+static void dumpCommand(const char* arguments) {
+	char path[COMMAND_LENGTH];
+	unsigned int address = 0, length = MEMORY_SIZE;
+
+	if (sscanf(arguments, "%s %x %u", path, &address, &length) < 1 || address >= MEMORY_SIZE) {
+		printf("Invalid input. Usage: F <file> [<start_address (hex)> <length (decimal)>]\n");
+		return;
+	}
+	if (dumpMemory(memory, path, (uint16_t)address, length)) {
+		printf("Wrote %u bytes from 0x%04X to %s\n", length > MEMORY_SIZE ? MEMORY_SIZE : length, address, path);
+	}
+	else {
+		printf("Dump error: Unable to write %s\n", path);
+	}
+}
+
+// C [<file> [<addr>]]: lists what changed since the K snapshot, or how memory differs from a raw dump loaded at addr
+static void compareCommand(const char* arguments) {
+	char path[COMMAND_LENGTH];
+	unsigned int address = 0;
+
+	if (sscanf(arguments, "%s %x", path, &address) < 1) {
+		if (memorySnapshot == NULL) {
+			printf("No snapshot to compare with, take one with K or give a dump file\n");
+			return;
+		}
+		printMemoryDiff(memorySnapshot, memory, 0, MEMORY_SIZE);
+		return;
+	}
+
+	uint8_t* reference = (uint8_t*)calloc(MEMORY_SIZE, sizeof(uint8_t));
+	int32_t length = reference != NULL && address < MEMORY_SIZE ? loadMemoryDump(reference, path, (uint16_t)address) : -1;
+	if (length < 0) {
+		printf("Dump error: Unable to read %s\n", path);
+	}
+	else {
+		printMemoryDiff(reference, memory, (uint16_t)address, (uint32_t)length);
+	}
+	free(reference);
+}
+
 // function to handle user input for stepping through the program
 static int handleUserCommand() {
-	char input[10];
+	char input[COMMAND_LENGTH];
+
+	// show any guest console output before prompting, and let a monitor see where the cpu stopped
+	uartFlush();
+	publishExport();
 
 	// print instructions message for user
-	printf("\n[ENTER} to continue | [S] to stop | [P <new PC>] to change PC | [R] to display registers | [W] to display PSW | [D <addr> <len>] to dump memory | [B] to add breakpoint and continue | [V] to change speed and continue <\n");
+	printf("\n[ENTER} to continue | [S] to stop | [P <new PC>] to change PC | [R] to display registers | [W] to display PSW | [D <addr> <len>] to dump memory | [F <file> [<addr> <len>]] to write memory to a file | [K] to snapshot memory | [C [<file> [<addr>]]] to compare memory with the snapshot or a file | [H] to hash the machine state | [B] to add breakpoint and continue | [V] to change speed and continue <\n");
 	printf(">");
 
 	// get user input
@@ -203,6 +269,36 @@ static int handleUserCommand() {
 		}
 	}
 
+	// check if user entered F or f
+	if (input[0] == 'F' || input[0] == 'f') {
+		dumpCommand(input + 1);
+		return handleUserCommand();
+	}
+
+	// check if user entered K or k
+	if (input[0] == 'K' || input[0] == 'k') {
+		if (memorySnapshot == NULL) {
+			memorySnapshot = (uint8_t*)malloc(MEMORY_SIZE);
+		}
+		if (memorySnapshot != NULL) {
+			memcpy(memorySnapshot, memory, MEMORY_SIZE);
+			printf("Memory snapshot taken at cycle %llu\n", (unsigned long long)cpuClock);
+		}
+		return handleUserCommand();
+	}
+
+	// check if user entered C or c
+	if (input[0] == 'C' || input[0] == 'c') {
+		compareCommand(input + 1);
+		return handleUserCommand();
+	}
+
+	// check if user entered H or h
+	if (input[0] == 'H' || input[0] == 'h') {
+		printf("State hash %016llX at cycle %llu\n", (unsigned long long)hashMachineState(), (unsigned long long)cpuClock);
+		return handleUserCommand();
+	}
+
 	// check if user entered B or b
 	if (input[0] == 'B' || input[0] == 'b') {
 		getBreakPoint();
@@ -243,6 +339,151 @@ static void getRunModeAndBreak(int *runMode) {
 	}
 }
 
+// called while PSW SLP is set and no interrupt was taken, instead of executing an instruction
+static int sleepUntilWoken() {
+	// nothing can change before the next device event, so skip straight to it
+	if (nextEventCycle != NO_EVENT_CYCLE && hasWakingEvents()) {
+		cpuClock = nextEventCycle;
+		runDueEvents();
+		return CPU_RUNNING;
+	}
+
+	// no events left, park the host thread until a device fed by a host thread has input
+	if (hasExternalSources()) {
+		waitForExternalInterrupt();
+		return CPU_RUNNING;
+	}
+
+	return CPU_ASLEEP;
+}
+
+int cpuStep() {
+	// single test per instruction, interrupt entry/return and sleep only cost time when one is pending
+	// interrupts are held off inside a CEX block so a handler can't run down its count
+	if (interruptPending && !cexExecuteCount) {
+		serviceInterrupts();
+
+		// still asleep, no interrupt was taken to wake the cpu
+		if (PSW & PSW_SLP_MASK) {
+			return sleepUntilWoken();
+		}
+	}
+
+	// increment clock for fetch
+	cpuClock += 1;
+
+	// fetch next instruction from memory
+	uint16_t nextInstructionWord = fetch();
+
+	// check if we have reached the end of our program instructions
+	if (nextInstructionWord == 0x0000) {
+		return CPU_HALTED;
+	}
+
+	instructionCount++;
+
+	// coverage costs a single bit-set per instruction when it is on, the PC is already past this instruction
+	if (coverageMap != NULL) {
+		COVERAGE_SET(coverageMap->executed, registerFile[R_PC] - 2);
+	}
+
+	// remember if this instruction is part of a CEX true block, a CEX or a transfer of control below ends that
+	int inCexBlock = cexExecuteCount;
+
+	// increment clock for decode
+	cpuClock += 1;
+
+	// decode instruction
+	Instruction nextInstruction;
+	int status = CPU_RUNNING;
+	 
+	// attempt to decode and execute instruction (if two-register arithmetic or branching)
+	if (decode(nextInstructionWord, &nextInstruction)) {
+		int executionCycles = 1;
+		uint16_t nextPC = registerFile[R_PC];
+
+		// if memory access is involved, bump up execution cycles taken
+		if (nextInstruction.type == MEM) {
+			executionCycles += 3;
+		}
+
+		// check if BRA
+		if (nextInstruction.mnemonic == "BRA") {
+			braCount++;
+		}
+		else {
+			// reset count if not BRA
+			braCount = 0;
+		}
+
+		int code = execute(&nextInstruction);
+
+		// a nested CEX (0x5000) has loaded a block of its own, and a taken branch, call or trap has left this one
+		if (inCexBlock && nextInstruction.opcode == 0x5000) {
+			inCexBlock = 0;
+		}
+		else if (inCexBlock && registerFile[R_PC] != nextPC) {
+			cexExecuteCount = 0;
+			cexSkipCount = 0;
+			inCexBlock = 0;
+		}
+
+		if (code) {
+			if (traceEnabled) {
+				char* errMsg = getErrMsg(code);
+				printf("Error executing instruction: %s\n", errMsg);
+			}
+			if (stopOnFault) {
+				status = CPU_FAULTED;
+			}
+		}
+
+		// the pipeline model replays each executed instruction, only while that mode is running
+		if (pipelineModel != NULL) {
+			pipelineRecord(nextPC - 2, &nextInstruction);
+		}
+
+		// increment clock for execution, a loaded timing model replaces the fixed costs
+		if (timingModel == NULL) {
+			cpuClock += executionCycles;
+		}
+		else {
+			cpuClock += timedCycles(&nextInstruction, registerFile[R_PC] != nextPC);
+		}
+	}
+	else {
+		// print hex word instruction for all other opcodes
+		if (traceEnabled) {
+			printf("Instruction: 0x%04x\n", nextInstructionWord);
+		}
+		if (stopOnFault) {
+			status = CPU_FAULTED;
+		}
+	}
+
+	// finish a CEX true block by jumping over its false block, nothing in it is fetched or decoded
+	if (inCexBlock && --cexExecuteCount == 0) {
+		registerFile[R_PC] += 2 * cexSkipCount;
+	}
+
+	// single compare per instruction, devices only cost time when one of their events is due
+	if (cpuClock >= nextEventCycle) {
+		runDueEvents();
+	}
+
+	return status;
+}
+
+int cpuRun(uint64_t cycleLimit) {
+	int status = CPU_RUNNING;
+
+	while (status == CPU_RUNNING && cpuClock < cycleLimit) {
+		status = cpuStep();
+	}
+
+	return status;
+}
+
 void cpuCycle() {
 
 	printf("Starting cpu cycle...\n\n");
@@ -266,58 +507,19 @@ void cpuCycle() {
 			braStopIgnored = 1;
 		}
 
-		// increment clock for fetch
-		cpuClock += 1;
-
-		// fetch next instruction from memory
-		uint16_t nextInstructionWord = fetch();
-
-		// check if we have reached the end of our program instructions
-		if (nextInstructionWord == 0x0000) {
+		// fetch, decode and execute the next instruction
+		int status = cpuStep();
+		if (status == CPU_HALTED) {
 			printf("End of program reached (0x0000 encountered).\n");
 			break;
 		}
-
-		// increment clock for decode
-		cpuClock += 1;
-
-		// decode instruction
-		Instruction nextInstruction;
-		 
-		// attempt to decode and execute instruction (if two-register arithmetic or branching)
-		if (decode(nextInstructionWord, &nextInstruction)) {
-			int executionCycles = 1;
-
-			// if memory access is involved, bump up execution cycles taken
-			if (nextInstruction.type == MEM) {
-				executionCycles += 3;
-			}
-
-			// check if BRA
-			if (nextInstruction.mnemonic == "BRA") {
-				braCount++;
-			}
-			else {
-				// reset count if not BRA
-				braCount = 0;
-			}
-
-			int code = execute(&nextInstruction);
-			if (code) {
-				char* errMsg = getErrMsg(code);
-				printf("Error executing instruction: %s\n", errMsg);
-			}
-
-			// increment clock for execution
-			cpuClock += executionCycles;
-		}
-		else {
-			// print hex word instruction for all other opcodes
-			printf("Instruction: 0x%04x\n", nextInstructionWord);
+		if (status == CPU_ASLEEP) {
+			printf("CPU is asleep with no device events or input that could wake it.\n");
+			break;
 		}
 
 		// print CPU clock
-		printf("\nCPU Clock: %d\n", cpuClock);
+		printf("\nCPU Clock: %llu\n", (unsigned long long)cpuClock);
 
 		// delay next execution
 		delayExecution();
@@ -343,4 +545,7 @@ void cpuCycle() {
 			}
 		}
 	}
-}
\ No newline at end of file
+
+	free(memorySnapshot);
+	memorySnapshot = NULL;
+}
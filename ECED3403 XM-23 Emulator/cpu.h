@@ -2,13 +2,46 @@
 #define CPU_H
 
 #include <stdint.h>
+#include "tls.h"
+
+// status codes returned by cpuStep and cpuRun
+#define CPU_RUNNING 0		// instruction executed, keep going
+#define CPU_HALTED  1		// end of program reached (0x0000 fetched)
+#define CPU_ASLEEP  2		// PSW SLP is set and nothing is left that could wake the cpu
+#define CPU_FAULTED 3		// an undecodable word or an execution error, only returned while stopOnFault is set
+#define CPU_LOOPING 4		// the machine repeated an earlier state exactly, only returned by cpuRunDetectingLoops
 
 // define cpu clock
-extern uint32_t cpuClock;
+extern THREAD_LOCAL uint64_t cpuClock;
+
+// number of instructions fetched past the end-of-program check
+extern THREAD_LOCAL uint64_t instructionCount;
+
+// instructions left in the current CEX true block, and the size of the false block skipped after it
+extern THREAD_LOCAL int cexExecuteCount;
+extern THREAD_LOCAL int cexSkipCount;
+
+// when set, fetch/decode/execute print their details for every instruction
+extern THREAD_LOCAL int traceEnabled;
+
+// consecutive BRA-to-self words seen, five in a row ends a run unless braStopIgnored is set
+extern THREAD_LOCAL int braCount;
+
+// when set, cpuStep returns CPU_FAULTED after an instruction it couldn't decode or execute instead of carrying on
+extern THREAD_LOCAL int stopOnFault;
 
 // function to start and control the fetch/decode/execute loop
 void cpuCycle();
 
+// fetches, decodes and executes a single instruction, then runs any device events that have come due
+// while PSW SLP is set it instead skips ahead to the next device event, or blocks the host thread until
+// external input arrives, returns CPU_RUNNING, CPU_HALTED, CPU_ASLEEP or CPU_FAULTED
+int cpuStep();
+
+// steps without any user interaction until the program halts or cpuClock reaches cycleLimit
+// returns the status of the last step
+int cpuRun(uint64_t cycleLimit);
+
 // initializes the global program counter to the provided address
 void initializePC(uint16_t address);
 
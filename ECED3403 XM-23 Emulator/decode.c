@@ -2,6 +2,7 @@
 #include "fetch.h"
 #include "cpu.h"
 #include "registers.h"
+#include "execute_al.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -85,6 +86,20 @@ static void extractOperandsAndFlags(uint16_t instructionWord, Instruction* instr
 		instruction->operands[0] = registerFile[R_PC] + ((int16_t)instruction->operands[2] * 2); // multiplying offset by 2 because it is a word offset, not byte offset
 	}
 
+	// if PSW/system instruction, extract its encoded value (priority, SVC vector or flag bits)
+	if (instruction->type == SYS) {
+		if (instruction->mnemonic == "CEX") {
+			// shift and mask to get condition code (bits 9-6), true count (bits 5-3) and false count (bits 2-0)
+			instruction->operands[0] = (instructionWord >> 6) & 0x0F;
+			instruction->operands[1] = (instructionWord >> 3) & 0x07;
+			instruction->operands[2] = instructionWord & 0x07;
+		}
+		else {
+			// mask to get the low 5 bits, execution masks further for the narrower fields
+			instruction->operands[0] = instructionWord & 0x1F;
+		}
+	}
+
 	// if LD or ST, extract pre or post increment or decrement
 	if (instruction->mnemonic == "LD" || instruction->mnemonic == "ST") {
 		instruction->inc = (instructionWord >> 7) & 0x01;
@@ -95,7 +110,7 @@ static void extractOperandsAndFlags(uint16_t instructionWord, Instruction* instr
 	// if LDR or STR, extract encoded offset for source address
 	if (instruction->mnemonic == "LDR" || instruction->mnemonic == "STR") {
 		// mask to get offset in bits 13-7, store in operands
-		instruction->operands[2] = (instructionWord >> 8) & 0x007F;
+		instruction->operands[2] = (instructionWord >> 7) & 0x007F;
 	}
 }
 
@@ -112,6 +127,7 @@ static int loadOpcodeInfo(Instruction* instruction) {
 			instruction->mnemonic = opcodeTable[i].mnemonic;
 			instruction->operandCount = opcodeTable[i].operandCount;
 			instruction->type = opcodeTable[i].type;
+			instruction->tableIndex = (uint8_t)i;
 			instruction->rc = -1;
 			instruction->wb = -1;
 
@@ -139,5 +155,10 @@ int decode(uint16_t instructionWord, Instruction* instruction) {
 	// valid opcode, now extract the operands and any applicable bit flags
 	extractOperandsAndFlags(instructionWord, instruction);
 
+	// pick the arithmetic/logic handler once here, so executing doesn't test W/B and R/C again
+	if (instruction->type == AL) {
+		instruction->handler = AL_HANDLER_INDEX(instructionWord);
+	}
+
 	return 1;
 }
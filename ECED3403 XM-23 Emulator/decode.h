@@ -27,6 +27,8 @@ typedef struct {
 	int8_t prpo;		   // pre or post increment/decrement
 	uint8_t source;		   // the source register number or constant index (3 bits)
 	uint8_t destination;   // the desination register number (3 bits)
+	uint8_t handler;	   // AL only, specialized handler index picked at decode (see AL_HANDLER_INDEX)
+	uint8_t tableIndex;	   // entry in opcodeTable the instruction matched
 } Instruction;
 
 // function for decoding an instruction word into its opcode, operands, and flags
@@ -71,6 +73,11 @@ static const OpcodeInfo opcodeTable[] = {
 	{ 0x4D10, 0xFFB8, "COMP", 1, SO },
 	{ 0x4D18, 0xFFB8, "SWPB", 1, SO },
 	{ 0x4D20, 0xFFB8, "SXT", 1, SO },
+	{ 0x4D80, 0xFFF8, "SETPRI", 1, SYS },
+	{ 0x4D90, 0xFFF0, "SVC", 1, SYS },
+	{ 0x4DA0, 0xFFE0, "SETCC", 1, SYS },
+	{ 0x4DC0, 0xFFE0, "CLRCC", 1, SYS },
+	{ 0x5000, 0xFC00, "CEX", 3, SYS },		// condition, true count, false count
 	{ 0x5800, 0xFC00, "LD", 2, MEM },
 	{ 0x5C00, 0xFC00, "ST", 2, MEM },
 	{ 0x6000, 0xF800, "MOVL", 2, RIN },
@@ -5,7 +5,9 @@
 #include "execute_al.h"
 #include "execute_rex.h"
 #include "execute_so.h"
+#include "execute_sys.h"
 #include "registers.h"
+#include "cpu.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -43,6 +45,16 @@ static const PrintInfo* getPrintInfo(Instruction* instruction) {
 		{ "R%d" }
 	};
 
+	static const PrintInfo printInfo5 = {
+		{ "Value" },
+		{ "0x%02x" }
+	};
+
+	static const PrintInfo printInfo6 = {
+		{ "Condition", "True Count", "False Count" },
+		{ "%d", "%d", "%d" }
+	};
+
 	static PrintInfo printInfoModified;
 
 	switch (instruction->type) {
@@ -91,6 +103,8 @@ static const PrintInfo* getPrintInfo(Instruction* instruction) {
 				return &printInfoModified;
 			}
 			return &printInfo4;
+		case SYS:
+			return instruction->operandCount == 3 ? &printInfo6 : &printInfo5;
 		default:
 			return NULL;
 	}
@@ -122,10 +136,12 @@ int execute(Instruction* instruction) {
 	int code = 0;
 
 	// print instruction details before executing
-	printInstructionDetails(instruction);
+	if (traceEnabled) {
+		printInstructionDetails(instruction);
+	}
 
-	// if not in the single operand or register exchange instruction classes, shift the opcode to just get a byte
-	if (instruction->type != SO && instruction->type != REX) {
+	// if not in the single operand, register exchange or system instruction classes, shift the opcode to just get a byte
+	if (instruction->type != SO && instruction->type != REX && instruction->type != SYS) {
 		instruction->opcode = instruction->opcode >> 8 & 0xFF;
 	}
 
@@ -149,6 +165,9 @@ int execute(Instruction* instruction) {
 		case SO:
 			code = executeSO(instruction);
 			break;
+		case SYS:
+			code = executeSYS(instruction);
+			break;
 		default:
 			code = 1;
 			break;
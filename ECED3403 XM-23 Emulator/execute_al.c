@@ -1,146 +1,193 @@
 #include "execute_al.h"
 #include "registers.h"
 #include "bus.h"
+#include "cpu.h"
 
-// helper function to handle BCD correction for result from DADD
-static uint16_t applyBCDAdjustment(uint16_t result, int isByteMode) {
-	// example, DST = 0x19 (19 in BCD) + SRC = 0x07 (7 in BCD) -> RESULT = 0x20 | wrong! this is why we use this function to correct to get 0x26 (26 in BCD)
-	
-	uint16_t adjusted = result;
-	uint8_t carry = 0;
+// decimal sum of every pair of bytes for each carry in, low byte is the two result digits, bit 8 the carry out
+static uint16_t decimalByteTable[2][256][256];
 
-	// check if byte or word
-	if (isByteMode) {
-		// BCD correct lower nibble
-		if ((result & 0x0F) > 9) {
-			adjusted += 0x06;
-		}
-		// correct upper nibble
-		if ((result & 0xF0) > 9) {
-			adjusted += 0x60;
-			carry = 1;
-		}
+// adds two BCD digits at a time, the slow way, used only to fill the table
+static uint16_t decimalAddBytes(int dst, int src, int carry) {
+	uint16_t result = 0;
+
+	for (int i = 0; i < 2; i++) {
+		int digit = ((dst >> (4 * i)) & 0xF) + ((src >> (4 * i)) & 0xF) + carry;
+		carry = digit > 9;
+		if (carry) digit -= 10;
+		result |= (digit & 0xF) << (4 * i);
 	}
-	else {
-		// correct lower byte
-		if ((result & 0x000F) > 9) {
-			adjusted += 0x0006;
-		}
-		if ((adjusted & 0x00F0) > 0x0090) {
-			adjusted += 0x0060;
-			carry = 1;
-		}
+	return result | (carry << 8);
+}
 
-		// correct upper byte
-		if ((adjusted & 0x0F00) > 0x0900) {
-			adjusted += 0x0600;
-		}
-		if ((adjusted & 0xF000) > 0x9000) {
-			adjusted += 0x6000;
-			carry = 1;
+void initializeDecimalAdder() {
+	for (int carry = 0; carry < 2; carry++) {
+		for (int dst = 0; dst < 256; dst++) {
+			for (int src = 0; src < 256; src++) {
+				decimalByteTable[carry][dst][src] = decimalAddBytes(dst, src, carry);
+			}
 		}
 	}
+}
+
+uint16_t bcdAdd(uint16_t dst, uint16_t src, int carryIn, int isByteMode, int* carryOut) {
+	// example, DST = 0x19 + SRC = 0x07 gives 0x26, one lookup per byte, the low byte's carry picks the high byte's table
+	uint16_t low = decimalByteTable[carryIn ? 1 : 0][dst & 0xFF][src & 0xFF];
 
-	// if we needed a carry for correction, set flag
-	if (carry) SET_FLAG(PSW_C);
+	if (isByteMode) {
+		*carryOut = low >> 8;
+		return low & 0xFF;
+	}
 
-	// return the BCD corrected result
-	return adjusted;
+	uint16_t high = decimalByteTable[low >> 8][dst >> 8][src >> 8];
+	*carryOut = high >> 8;
+	return (low & 0xFF) | ((high & 0xFF) << 8);
 }
 
-int executeAL(Instruction* instruction) {
-	uint16_t dstValue, result;
-	int16_t srcValue;
-	int isByteMode = instruction->wb;
-	int useConstant = instruction->rc;
+// the handlers below rely on alOperation being copied into each one with its constant arguments folded away
+#ifdef _MSC_VER
+#define AL_INLINE static __forceinline
+#else
+#define AL_INLINE static inline __attribute__((always_inline))
+#endif
+
+#define AL_MASK(isByteMode) ((isByteMode) ? 0xFFu : 0xFFFFu)
+#define AL_SIGN_SHIFT(isByteMode) ((isByteMode) ? 7 : 15)
+
+// PSW with C, Z, N and V replaced for dst + src + carry, sum is the full sum of the width-masked operands
+// each flag is shifted straight into its PSW bit (C 0, Z 1, N 2, V 4) rather than tested and set
+AL_INLINE uint16_t arithmeticFlags(uint32_t sum, uint32_t dst, uint32_t src, int isByteMode) {
+	uint32_t result = sum & AL_MASK(isByteMode);
+	int shift = AL_SIGN_SHIFT(isByteMode);
+
+	return (uint16_t)((PSW & ~(PSW_C | PSW_Z | PSW_N | PSW_V))
+		| ((sum >> (shift + 1)) & 1)
+		| ((result == 0) << 1)
+		| (((result >> shift) & 1) << 2)
+		| ((((dst ^ result) & (src ^ result)) >> shift & 1) << 4));
+}
 
-	// skip either dst or src fetch if R/C is 1 and use constant instead
+// PSW with N and Z from the result, C and V cleared
+AL_INLINE uint16_t logicFlags(uint32_t result, int isByteMode) {
+	result &= AL_MASK(isByteMode);
 
-	// read destination register value
-	if (!readFromRegister(instruction->operands[0], &dstValue)) {
-		printf("Error reading destination register in %s instruction\n", instruction->mnemonic);
-		return 2;
-	}
+	return (uint16_t)((PSW & ~(PSW_C | PSW_Z | PSW_N | PSW_V))
+		| ((result == 0) << 1)
+		| (((result >> AL_SIGN_SHIFT(isByteMode)) & 1) << 2));
+}
 
-	// check if we skip register read and use constant
-	if (useConstant) {
-		srcValue = constants[instruction->operands[1]];
-	}
-	else {
-		// read source register value
-		if (!readFromRegister(instruction->operands[1], &srcValue)) {
-			printf("Error reading source register in %s instruction\n", instruction->mnemonic);
-			return 2;
-		}
+// writes the result, byte mode keeps the high byte, writes to the PC go through writeToRegister for its interrupt return check
+AL_INLINE int writeALResult(int dst, uint32_t result, int isByteMode) {
+	if (dst == R_PC) {
+		return writeToRegister(dst, result, isByteMode, 0);
 	}
 
-	// mask source value based on byte/word mode
-	if (isByteMode) {
-		srcValue = (int8_t)srcValue;
-	}
+	registerFile[dst] = isByteMode ? (registerFile[dst] & 0xFF00) | (result & 0xFF) : (uint16_t)result;
+	return 0;
+}
 
-	switch (instruction->opcode) {
-	case 0x40: // ADD
-	case 0x41: // ADDC (addition with carry)
-		printf("Adding %d and %d\n", dstValue, srcValue);
-		result = dstValue + srcValue + (instruction->opcode == 0x41 && PSW & PSW_C ? 1 : 0); // add DST and SRC, with carry if ADDC
-		updateFlags(result, srcValue, dstValue, isByteMode, 0); // update the PSW flags based on the operation result
-		return writeToRegister(instruction->operands[0], result, isByteMode, 0); // write result in dst register
-
-	case 0x42: // SUB
-	case 0x43: // SUBC (subtraction with carry)
-		result = dstValue + (~srcValue + 1) + (instruction->opcode == 0x43 && PSW & PSW_C ? 1 : 0); // subtract dst and src, with carry if SUBC
-		updateFlags(result, srcValue, dstValue, isByteMode, 1); // update the PSW flags based on the operation result
-		return  writeToRegister(instruction->operands[0], result, isByteMode, 0); // write result in dst register		
-
-	case 0x44: // DADD (decimal addition, see: https://www.ibm.com/docs/en/i/7.3?topic=concepts-arithmetic-operations#MCNPFAO__title__4)
-		result = dstValue + srcValue + (PSW & PSW_C ? 1 : 0); // addition with carry
-		result = applyBCDAdjustment(result, isByteMode); // correct the result for BCD
-		updateFlags(result, srcValue, dstValue, isByteMode, 0);
-		return writeToRegister(instruction->operands[0], result, isByteMode, 0);
-
-	case 0x45: // CMP
-		printf("Comparing %d and %d\n", dstValue, srcValue);
-		result = dstValue + (~srcValue + 1); // subtract DST and SRC
-		updateFlags(result, srcValue, dstValue, isByteMode, 0); // update the PSW flags based on the operation result
+// every AL operation, op is the low nibble of the opcode (0x40-0x4B)
+// decode masks register numbers to 3 bits, so the register file is indexed directly
+AL_INLINE int alOperation(Instruction* instruction, int op, int isByteMode, int useConstant) {
+	int dst = instruction->operands[0];
+	uint32_t mask = AL_MASK(isByteMode);
+	uint32_t dstValue = registerFile[dst] & mask;
+	uint32_t srcValue = (useConstant ? (uint16_t)constants[instruction->operands[1]] : registerFile[instruction->operands[1]]) & mask;
+	uint32_t carry = PSW & PSW_C;
+	uint32_t bit = 1u << (srcValue & (isByteMode ? 0x07 : 0x0F)); // BIT, BIC and BIS take a bit number
+	uint32_t sum;
+	int carryOut;
+
+	switch (op) {
+	case 0x0: // ADD
+		if (traceEnabled) printf("Adding %d and %d\n", dstValue, srcValue);
+		sum = dstValue + srcValue;
+		PSW = arithmeticFlags(sum, dstValue, srcValue, isByteMode);
+		return writeALResult(dst, sum, isByteMode);
+
+	case 0x1: // ADDC (addition with carry)
+		sum = dstValue + srcValue + carry;
+		PSW = arithmeticFlags(sum, dstValue, srcValue, isByteMode);
+		return writeALResult(dst, sum, isByteMode);
+
+	case 0x2: // SUB, DST + ~SRC + 1 (C set means no borrow)
+		sum = dstValue + (~srcValue & mask) + 1;
+		PSW = arithmeticFlags(sum, dstValue, ~srcValue & mask, isByteMode);
+		return writeALResult(dst, sum, isByteMode);
+
+	case 0x3: // SUBC (subtraction with carry), the carry takes the place of the 1
+		sum = dstValue + (~srcValue & mask) + carry;
+		PSW = arithmeticFlags(sum, dstValue, ~srcValue & mask, isByteMode);
+		return writeALResult(dst, sum, isByteMode);
+
+	case 0x4: // DADD (decimal addition, see: https://www.ibm.com/docs/en/i/7.3?topic=concepts-arithmetic-operations#MCNPFAO__title__4)
+		sum = bcdAdd((uint16_t)dstValue, (uint16_t)srcValue, carry, isByteMode, &carryOut);
+		PSW = logicFlags(sum, isByteMode) | (carryOut ? PSW_C : 0); // N and Z from the result, C the decimal carry, V cleared
+		return writeALResult(dst, sum, isByteMode);
+
+	case 0x5: // CMP
+		if (traceEnabled) printf("Comparing %d and %d\n", dstValue, srcValue);
+		sum = dstValue + (~srcValue & mask) + 1;
+		PSW = arithmeticFlags(sum, dstValue, ~srcValue & mask, isByteMode);
 		return 0;
 
-	case 0x46: // XOR (see: https://www.geeksforgeeks.org/bitwise-operators-in-c-cpp/)
-		result = dstValue ^ srcValue;
-		updateFlags(result, srcValue, dstValue, isByteMode, 0);
-		return writeToRegister(instruction->operands[0], result, isByteMode, 0);
-
-	case 0x47: // AND
-		result = dstValue & srcValue;
-		updateFlags(result, srcValue, dstValue, isByteMode, 0);
-		return writeToRegister(instruction->operands[0], result, isByteMode, 0);
-
-	case 0x48: // OR
-		result = dstValue | srcValue;
-		updateFlags(result, srcValue, dstValue, isByteMode, 0);
-		return writeToRegister(instruction->operands[0], result, isByteMode, 0);
-
-	case 0x49: // BIT (bit test)
-		result = dstValue & (1 << srcValue);
-		// reset all PSW flags before setting new zero flag
-		PSW &= ~(PSW_Z | PSW_N | PSW_C | PSW_V);
-		// set zero flag is result zero
-		if (!result) {
-			SET_FLAG(PSW_Z);
-		}
+	case 0x6: // XOR (see: https://www.geeksforgeeks.org/bitwise-operators-in-c-cpp/)
+		PSW = logicFlags(dstValue ^ srcValue, isByteMode);
+		return writeALResult(dst, dstValue ^ srcValue, isByteMode);
+
+	case 0x7: // AND
+		PSW = logicFlags(dstValue & srcValue, isByteMode);
+		return writeALResult(dst, dstValue & srcValue, isByteMode);
+
+	case 0x8: // OR
+		PSW = logicFlags(dstValue | srcValue, isByteMode);
+		return writeALResult(dst, dstValue | srcValue, isByteMode);
+
+	case 0x9: // BIT (bit test)
+		PSW = logicFlags(dstValue & bit, isByteMode);
 		return 0;
 
-	case 0x4A: // BIC (bit clear)
-		result = dstValue & ~(1 << srcValue);
-		updateFlags(result, srcValue, dstValue, isByteMode, 0);
-		return writeToRegister(instruction->operands[0], result, isByteMode, 0);
+	case 0xA: // BIC (bit clear)
+		PSW = logicFlags(dstValue & ~bit, isByteMode);
+		return writeALResult(dst, dstValue & ~bit, isByteMode);
 
-	case 0x4B: // BIS (bit set)
-		result = dstValue | (1 << srcValue);
-		updateFlags(result, srcValue, dstValue, isByteMode, 0);
-		return writeToRegister(instruction->operands[0], result, isByteMode, 0);
+	case 0xB: // BIS (bit set)
+		PSW = logicFlags(dstValue | bit, isByteMode);
+		return writeALResult(dst, dstValue | bit, isByteMode);
 
 	default:
 		return 1;
 	}
-}
\ No newline at end of file
+}
+
+// four handlers per operation, word/byte x register/constant, in AL_HANDLER_INDEX order
+#define AL_SPECIALIZATIONS(name, op) \
+	static int name##Word(Instruction* instruction) { return alOperation(instruction, op, 0, 0); } \
+	static int name##WordConstant(Instruction* instruction) { return alOperation(instruction, op, 0, 1); } \
+	static int name##Byte(Instruction* instruction) { return alOperation(instruction, op, 1, 0); } \
+	static int name##ByteConstant(Instruction* instruction) { return alOperation(instruction, op, 1, 1); }
+
+#define AL_HANDLER_ROW(name) name##Word, name##WordConstant, name##Byte, name##ByteConstant
+
+AL_SPECIALIZATIONS(add, 0x0)
+AL_SPECIALIZATIONS(addc, 0x1)
+AL_SPECIALIZATIONS(sub, 0x2)
+AL_SPECIALIZATIONS(subc, 0x3)
+AL_SPECIALIZATIONS(dadd, 0x4)
+AL_SPECIALIZATIONS(cmp, 0x5)
+AL_SPECIALIZATIONS(xor, 0x6)
+AL_SPECIALIZATIONS(and, 0x7)
+AL_SPECIALIZATIONS(or, 0x8)
+AL_SPECIALIZATIONS(bit, 0x9)
+AL_SPECIALIZATIONS(bic, 0xA)
+AL_SPECIALIZATIONS(bis, 0xB)
+
+static int (* const alHandlers[AL_HANDLER_COUNT])(Instruction* instruction) = {
+	AL_HANDLER_ROW(add), AL_HANDLER_ROW(addc), AL_HANDLER_ROW(sub), AL_HANDLER_ROW(subc),
+	AL_HANDLER_ROW(dadd), AL_HANDLER_ROW(cmp), AL_HANDLER_ROW(xor), AL_HANDLER_ROW(and),
+	AL_HANDLER_ROW(or), AL_HANDLER_ROW(bit), AL_HANDLER_ROW(bic), AL_HANDLER_ROW(bis),
+};
+
+int executeAL(Instruction* instruction) {
+	// decode already picked the handler for this opcode, width and source kind
+	return alHandlers[instruction->handler](instruction);
+}
@@ -4,9 +4,22 @@
 #include "decode.h"
 #include <stdint.h>
 
-// executes instruction belonging to the memory access instruction types
+// 12 operations x word/byte x register/constant source
+#define AL_HANDLER_COUNT 48
+
+// handler for an AL instruction word, bits 11-8 pick the operation, W/B (bit 6) and R/C (bit 7) the specialization
+#define AL_HANDLER_INDEX(instructionWord) ((((instructionWord) >> 6) & 0x3C) | (((instructionWord) >> 5) & 0x02) | (((instructionWord) >> 7) & 0x01))
+
+// executes instruction belonging to the arithmetic and logic instruction types, through the handler decode picked
 // returns 0/1/2 for execute return status code
 int executeAL(Instruction* instruction);
 
+// fills the byte-pair table bcdAdd looks up, call once before any thread executes instructions
+void initializeDecimalAdder();
+
+// decimal dst + src + carryIn over 2 (byte mode) or 4 BCD digits, sets carryOut to the carry out of the top digit
+// digits above 9 are taken at face value, a digit sum of 10 or more carries and keeps the sum less 10
+uint16_t bcdAdd(uint16_t dst, uint16_t src, int carryIn, int isByteMode, int* carryOut);
+
 #endif // !EXECUTE_AL_H
 
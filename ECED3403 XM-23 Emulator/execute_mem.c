@@ -1,6 +1,7 @@
 #include "execute_mem.h"
 #include "registers.h"
 #include "bus.h"
+#include "cache.h"
 #include <stdbool.h>
 
 // helper to encapsulate writing to simulated memory for ST/STR
@@ -81,19 +82,15 @@ int executeMEM(Instruction* instruction) {
 
 		// add offset to address from source if LDR
 		if (instruction->opcode == 0x80) {
-			int16_t offset = instruction->operands[2] & 0x3F;  // extract lower 6 bits
+			int16_t offset = instruction->operands[2] & 0x7F;  // 7-bit byte offset
 
-			// if bit 5 is set, extend the sign to 16 bits
-			if (instruction->operands[2] & 0x20) {
-				offset |= 0xFFC0;
+			// if bit 6 is set, extend the sign to 16 bits
+			if (instruction->operands[2] & 0x40) {
+				offset |= 0xFF80;
 			}
 
-			if (instruction->wb) {
-				addressFromSource += offset;  // byte mode
-			}
-			else {
-				addressFromSource += offset * 2;  // word mode
-			}
+			// the offset is in bytes for both byte and word mode
+			addressFromSource += offset;
 		}
 
 		// handle pre increment/decrement if needed
@@ -102,6 +99,11 @@ int executeMEM(Instruction* instruction) {
 			return 2;
 		}
 
+		// data cache model, the PC is already past this instruction
+		if (dataCache != NULL) {
+			cacheAccess(dataCache, addressFromSource, instruction->wb ? 1 : 2, registerFile[R_PC] - 2);
+		}
+
 		// fetch the lsb from memory
 		uint8_t lsb;
 		if (bus(addressFromSource, &lsb, 0) != 0) {
@@ -162,21 +164,22 @@ int executeMEM(Instruction* instruction) {
 
 		// if STR, add the offset
 		if (instruction->opcode == 0xC0) {
-			int16_t offset = instruction->operands[2] & 0x3F; // extract lower 6 bits
+			int16_t offset = instruction->operands[2] & 0x7F; // 7-bit byte offset
 
-			// if bit 5 is set, extend the sign
-			if (instruction->operands[2] & 0x20) {
-				offset |= 0xFFC0;  // extend sign
+			// if bit 6 is set, extend the sign
+			if (instruction->operands[2] & 0x40) {
+				offset |= 0xFF80;  // extend sign
 			}
 
-			if (instruction->wb) {
-				addressToWrite += offset;  // byte mode
-			}
-			else {
-				addressToWrite += offset * 2;  // word mode
-			}
+			// the offset is in bytes for both byte and word mode
+			addressToWrite += offset;
 		}
 		
+		// data cache model, writes allocate like reads
+		if (dataCache != NULL) {
+			cacheAccess(dataCache, addressToWrite, instruction->wb ? 1 : 2, registerFile[R_PC] - 2);
+		}
+
 		// write the register value to memory
 		if (!handleMemoryWrite(addressToWrite, valueToStore, instruction->wb, instruction->mnemonic)) return 2;
 
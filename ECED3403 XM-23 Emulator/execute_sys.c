@@ -0,0 +1,79 @@
+#include "execute_sys.h"
+#include "registers.h"
+#include "interrupts.h"
+#include "cpu.h"
+
+// CEX condition truth tables, bit i is set if the condition holds for flags i = V:N:Z:C (V is bit 3)
+// evaluating a condition is a single shift and mask instead of testing flags per condition
+static const uint16_t cexConditionTable[16] = {
+	0xCCCC,	// EQ
+	0x3333,	// NE
+	0xAAAA,	// CS/HS
+	0x5555,	// CC/LO
+	0xF0F0,	// MI
+	0x0F0F,	// PL
+	0xFF00,	// VS
+	0x00FF,	// VC
+	0x2222,	// HI
+	0xDDDD,	// LS
+	0xF00F,	// GE
+	0x0FF0,	// LT
+	0x3003,	// GT
+	0xCFFC,	// LE
+	0xFFFF,	// TR
+	0x0000,	// FL
+};
+
+// packs the PSW V, N, Z and C flags into the 4-bit index used by the CEX truth tables
+static int cexFlagIndex() {
+	return (PSW & (PSW_N | PSW_Z | PSW_C)) | ((PSW & PSW_V) >> 1);
+}
+
+int executeSYS(Instruction* instruction) {
+	switch (instruction->opcode) {
+	case 0x4D80: // SETPRI
+		// replace the current priority, requests it was masking may now be taken
+		PSW = (PSW & ~PSW_CP_MASK) | ((instruction->operands[0] & 0x07) << 5);
+		updateInterruptPending();
+		return 0;
+
+	case 0x4D90: // SVC
+		// trap through the vector given by the instruction, LR and the return PC are saved by the entry
+		enterException(instruction->operands[0] & 0x0F);
+		return 0;
+
+	case 0x4DA0: // SETCC
+		// V, SLP, N, Z and C occupy PSW bits 4-0, the same positions as in the instruction
+		PSW |= instruction->operands[0] & 0x1F;
+		updateInterruptPending(); // SLP may have been set
+		return 0;
+
+	case 0x4DC0: // CLRCC
+		PSW &= ~(instruction->operands[0] & 0x1F);
+		updateInterruptPending();
+		return 0;
+
+	case 0x5000: // CEX
+	{
+		int trueCount = instruction->operands[1];
+		int falseCount = instruction->operands[2];
+
+		// the condition is evaluated once here, the following instructions are never decoded just to be skipped
+		if ((cexConditionTable[instruction->operands[0]] >> cexFlagIndex()) & 1) {
+			// run the true block, the cpu loop skips the false block once it has finished
+			cexExecuteCount = trueCount;
+			cexSkipCount = falseCount;
+			if (trueCount == 0) {
+				registerFile[R_PC] += 2 * falseCount;
+			}
+		}
+		else {
+			// skip the true block now and let the false block run normally
+			registerFile[R_PC] += 2 * trueCount;
+		}
+		return 0;
+	}
+	default:
+		return 1;
+	}
+}
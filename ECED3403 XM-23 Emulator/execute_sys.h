@@ -0,0 +1,11 @@
+#ifndef EXECUTE_SYS_H
+#define EXECUTE_SYS_H
+
+#include "decode.h"
+#include <stdint.h>
+
+// executes instruction belonging to the PSW and systems instruction types (SETPRI, SVC, SETCC, CLRCC, CEX)
+// returns 0/1/2 for execute return status code
+int executeSYS(Instruction* instruction);
+
+#endif // !EXECUTE_SYS_H
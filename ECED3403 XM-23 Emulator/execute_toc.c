@@ -1,6 +1,42 @@
 #include "execute_toc.h"
 #include "cpu.h"
 #include "registers.h"
+#include "fuzzer.h"
+#include "coverage.h"
+#include "branch_predictor.h"
+
+// moves the PC to a taken branch target, recording the edge when a fuzzer or coverage run is collecting it
+static void takeBranch(uint16_t target) {
+	// the PC has already moved past the branch instruction
+	if (edgeCoverageMap != NULL) {
+		edgeCoverageMap[EDGE_INDEX(registerFile[R_PC] - 2, target)]++;
+	}
+	if (coverageMap != NULL) {
+		COVERAGE_SET(coverageMap->taken, registerFile[R_PC] - 2);
+	}
+	registerFile[R_PC] = target;
+}
+
+// records a conditional branch that fell through
+static void skipBranch() {
+	if (coverageMap != NULL) {
+		COVERAGE_SET(coverageMap->notTaken, registerFile[R_PC] - 2);
+	}
+}
+
+// resolves a conditional branch, letting the predictors guess first when a prediction run is on
+static void conditionalBranch(int condition, uint16_t target) {
+	if (branchPredictors != NULL) {
+		predictBranch(registerFile[R_PC] - 2, target, condition != 0);
+	}
+
+	if (condition) {
+		takeBranch(target);
+	}
+	else {
+		skipBranch();
+	}
+}
 
 int executeTOC(Instruction* instruction) {
 	switch (instruction->opcode) {
@@ -9,68 +45,47 @@ int executeTOC(Instruction* instruction) {
 		registerFile[R_LR] = registerFile[R_PC];
 		
 		// set PC to link address (branch PC)
-		registerFile[R_PC] = instruction->operands[0];
+		takeBranch(instruction->operands[0]);
 		return 0;
 
 	case 0x20: // BEQ/BZ
 		// check if zero flag is up on PSW
-		if (PSW & PSW_Z) {
-			// update PC to the branch address
-			registerFile[R_PC] = instruction->operands[0];
-		}
+		conditionalBranch(PSW & PSW_Z, instruction->operands[0]);
 		return 0;
 
 	case 0x24: // BNE/BNZ
 		// check if zero flag is down on PSW
-		if (!(PSW & PSW_Z)) {
-			// update PC to the branch address
-			registerFile[R_PC] = instruction->operands[0];
-		}
+		conditionalBranch(!(PSW & PSW_Z), instruction->operands[0]);
 		return 0;
 
 	case 0x28: // BC/BHS
 		// check if carry flag is set on PSW
-		if (PSW & PSW_C) {
-			// update PC to branch address
-			registerFile[R_PC] = instruction->operands[0];
-		}
+		conditionalBranch(PSW & PSW_C, instruction->operands[0]);
 		return 0;
 
 	case 0x2C: // BNC/BLO
 		// check if carry flag is down on PSW
-		if (!(PSW & PSW_C)) {
-			// update PC to branch address
-			registerFile[R_PC] = instruction->operands[0];
-		}
+		conditionalBranch(!(PSW & PSW_C), instruction->operands[0]);
 		return 0;
 
 	case 0x30: // BN
 		// check if negative flag is set on PSW
-		if (PSW & PSW_N) {
-			// update PC to branch address
-			registerFile[R_PC] = instruction->operands[0];
-		}
+		conditionalBranch(PSW & PSW_N, instruction->operands[0]);
 		return 0;
 
 	case 0x34: // BGE
-		// check if N and V are both set after subtraction
-		if (((PSW & PSW_N) >> 2) && ((PSW & PSW_V) >> 4)) {
-			// update PC to branch address
-			registerFile[R_PC] = instruction->operands[0];
-		}
+		// check if N == V (signs match after subtraction)
+		conditionalBranch(((PSW & PSW_N) >> 2) == ((PSW & PSW_V) >> 4), instruction->operands[0]);
 		return 0;
 
 	case 0x38: // BLT
 		// check if N != V (signs DO NOT match after subtraction)
-		if (((PSW & PSW_N) >> 2) != ((PSW & PSW_V) >> 4)) {
-			// update PC to branch address
-			registerFile[R_PC] = instruction->operands[0];
-		}
+		conditionalBranch(((PSW & PSW_N) >> 2) != ((PSW & PSW_V) >> 4), instruction->operands[0]);
 		return 0;
 
 	case 0x3C: // BRA
 		// update PC to the branch address
-		registerFile[R_PC] = instruction->operands[0];
+		takeBranch(instruction->operands[0]);
 		return 0;
 
 	default:
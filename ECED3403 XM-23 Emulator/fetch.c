@@ -1,13 +1,22 @@
 #include "fetch.h"
 #include "bus.h"
 #include "registers.h"
+#include "cpu.h"
+#include "cache.h"
 
 #include <stdio.h>
 
 uint16_t fetch() {
 	// define the high and low bytes of the instruction word that will be fetched
 	uint8_t highByte, lowByte;
-	printf("Fetching from address 0x%04X\n", registerFile[R_PC]);
+	if (traceEnabled) {
+		printf("Fetching from address 0x%04X\n", registerFile[R_PC]);
+	}
+
+	// instruction cache model, the whole word is one access
+	if (instructionCache != NULL) {
+		cacheAccess(instructionCache, registerFile[R_PC], 2, registerFile[R_PC]);
+	}
 
 	// fetch the low byte of the instruction from memory
 	if (bus(registerFile[R_PC], &lowByte, 0) != 0) {
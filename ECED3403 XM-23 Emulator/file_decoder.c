@@ -1,6 +1,14 @@
 #include "file_decoder.h"
 #include "memory.h"
 #include "cpu.h"
+#include "registers.h"
+
+uint8_t loadedImageMap[MEMORY_SIZE / 8];
+
+// set while decoding records for a library machine, nothing is printed
+static THREAD_LOCAL int quietDecode = 0;
+
+#define DECODER_PRINT(...) do { if (!quietDecode) printf(__VA_ARGS__); } while (0)
 
 #define MAX_RECORD_LENGTH 81 // sources say max length ranges from 64 - 80 characters, going with highest 
 							 // (sources: https://www.systutorials.com/docs/linux/man/5-srec/, https://srecord.sourceforge.net/reference-1.65.pdf)
@@ -60,8 +68,8 @@ static int validateChecksum(int checksum, int sum) {
 	}
 }
 
-static void decodeType0(char *record) {
-	printf("--------- Decoding S0 record ---------\n\n");
+static int decodeType0(char *record) {
+	DECODER_PRINT("--------- Decoding S0 record ---------\n\n");
 
 	int recordLength = getRecordLength(record);
 	int checkSum = getRecordCheckSum(record, recordLength);
@@ -70,8 +78,8 @@ static void decodeType0(char *record) {
 	char* filename = (char*)malloc((recordLength - 3) + 1);
 
 	if (filename == NULL) {
-		printf("Memory allocation failed for filename");
-		return;
+		DECODER_PRINT("Memory allocation failed for filename");
+		return 0;
 	}
 
 	for (int i = 0; i < (recordLength - 3); i++) {
@@ -82,16 +90,19 @@ static void decodeType0(char *record) {
 
 	filename[recordLength - 3] = '\0'; // null terminate the string
 
-	if (validateChecksum(checkSum, rollingSum)) {
-		printf("Filename: %s\n\n", filename);
+	int valid = validateChecksum(checkSum, rollingSum);
+	if (valid) {
+		DECODER_PRINT("Filename: %s\n\n", filename);
 	}
 	else {
-		printf("S0 record has invalid checksum! Record ignored\n\n");
+		DECODER_PRINT("S0 record has invalid checksum! Record ignored\n\n");
 	}
+	free(filename);
+	return valid;
 }
 
-static void decodeType1(char *record) {
-	printf("--------- Decoding S1 record ---------\n\n");
+static int decodeType1(char *record) {
+	DECODER_PRINT("--------- Decoding S1 record ---------\n\n");
 
 	int recordLength = getRecordLength(record);
 
@@ -99,6 +110,10 @@ static void decodeType1(char *record) {
 	int rollingSum = recordLength;
 
 	unsigned char* data = (unsigned char*)malloc(recordLength - 3);
+	if (data == NULL) {
+		DECODER_PRINT("Memory allocation failed for record data\n");
+		return 0;
+	}
 
 	int address = getRecordAddrField(record);
 	rollingSum += getAddrAsIntSum(address);
@@ -111,20 +126,30 @@ static void decodeType1(char *record) {
 		data[i] = hex;
 	}
 
-	if (validateChecksum(checkSum, rollingSum)) {
-		printf("Starting address: 0x%04X\n", address);
+	int valid = validateChecksum(checkSum, rollingSum);
+	if (valid) {
+		DECODER_PRINT("Starting address: 0x%04X\n", address);
 		writeArrayToMemory(address, data, recordLength - 3);
-		printf("\nMemory written:\n\n");
-		printMemorySection(address, recordLength - 3);
-		printf("\n");
+
+		// remember which addresses the image occupies, library loads keep to their own machine
+		for (int i = 0; i < recordLength - 3 && address + i < MEMORY_SIZE && !quietDecode; i++) {
+			loadedImageMap[(address + i) >> 3] |= 1 << ((address + i) & 7);
+		}
+		DECODER_PRINT("\nMemory written:\n\n");
+		if (!quietDecode) {
+			printMemorySection(address, recordLength - 3);
+		}
+		DECODER_PRINT("\n");
 	}
 	else {
-		printf("S1 record has invalid checksum! Data not written to memory\n\n");
+		DECODER_PRINT("S1 record has invalid checksum! Data not written to memory\n\n");
 	}
+	free(data);
+	return valid;
 }
 
-static void decodeType9(char *record) {
-	printf("--------- Decoding S9 record ---------\n\n");
+static int decodeType9(char *record) {
+	DECODER_PRINT("--------- Decoding S9 record ---------\n\n");
 
 	int recordLength = getRecordLength(record);
 	int checkSum = getRecordCheckSum(record, recordLength);
@@ -138,47 +163,111 @@ static void decodeType9(char *record) {
 		rollingSum += hex;
 	}
 
-	if (validateChecksum(checkSum, rollingSum)) {
-		printf("Starting address: 0x%04X\n", address);
-		printf("\n");
+	int valid = validateChecksum(checkSum, rollingSum);
+	if (valid) {
+		DECODER_PRINT("Starting address: 0x%04X\n", address);
+		DECODER_PRINT("\n");
 
 		// initialize program counter to starting address
-		initializePC(address);
+		if (quietDecode) {
+			registerFile[R_PC] = address;
+		}
+		else {
+			initializePC(address);
+		}
 	}
 	else {
-		printf("S9 record has invalid checksum! Data not written to memory\n\n");
+		DECODER_PRINT("S9 record has invalid checksum! Data not written to memory\n\n");
 	}
+	return valid;
 }
 
-static void processRecord(char *record) {
+// returns 0 for a record that was rejected, other record types are skipped and count as decoded
+static int processRecord(char *record) {
 
 	// verify it begins with S
 	if (record[0] != 'S') {
-		printf("Invalid S-Record, ignoring line\n");
-		return;
+		DECODER_PRINT("Invalid S-Record, ignoring line\n");
+		return 0;
 	}
 
 	char type = record[1];
 
 	switch (type) {
 		case '0':
-			decodeType0(record);
-			break;
+			return decodeType0(record);
 		case '1':
-			decodeType1(record);
-			break;
+			return decodeType1(record);
 		case '9':
-			decodeType9(record);
-			break;
+			return decodeType9(record);
 	}
+	return 1;
 }
 
 void decodeFile(FILE* file) {
 	char* record[MAX_RECORD_LENGTH];
 
-	printf("Decoding file...\n\n");
+	DECODER_PRINT("Decoding file...\n\n");
 	
 	while (fgets(record, sizeof(record), file)) {
 		processRecord(record);
 	}
-};
\ No newline at end of file
+};
+
+// checks a record from a buffer has hex digits throughout and the length its count field gives,
+// a file is trusted to be assembler output but a buffer may come from anywhere
+static int isWellFormedRecord(const char* record, size_t lineLength) {
+	if (lineLength < 10 || record[0] != 'S') {
+		return 0;
+	}
+	for (size_t i = 2; i < lineLength; i++) {
+		if (!((record[i] >= '0' && record[i] <= '9') || (record[i] >= 'A' && record[i] <= 'F'))) {
+			return 0;
+		}
+	}
+
+	int count = getRecordLength((char*)record);
+	return count >= 3 && lineLength == 4 + 2 * (size_t)count;
+}
+
+int decodeRecords(const char* text, size_t length) {
+	char record[MAX_RECORD_LENGTH + 1];
+	size_t position = 0;
+	int records = 0;
+
+	quietDecode = 1;
+	while (position < length) {
+		size_t lineLength = 0;
+
+		// copy one line, anything past the longest record is dropped
+		while (position < length && text[position] != '\n') {
+			if (lineLength < MAX_RECORD_LENGTH) {
+				record[lineLength++] = text[position];
+			}
+			position++;
+		}
+		position++;
+
+		// tolerate CRLF line ends and blank lines
+		while (lineLength > 0 && (record[lineLength - 1] == '\r' || record[lineLength - 1] == ' ')) {
+			lineLength--;
+		}
+		if (lineLength == 0) {
+			continue;
+		}
+		record[lineLength] = '\0';
+
+		if (!isWellFormedRecord(record, lineLength) || !processRecord(record)) {
+			quietDecode = 0;
+			return -1;
+		}
+		records++;
+	}
+	quietDecode = 0;
+
+	return records;
+}
+
+int isLoadedAddress(uint16_t address) {
+	return (loadedImageMap[address >> 3] >> (address & 7)) & 1;
+}
@@ -3,11 +3,24 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include "memory.h"
 
 // S-record types expected from XM-23 assembler
 enum RecordTypes { S0, S1, S9 };
 
+// one bit per byte written by the S1 records of the loaded file
+extern uint8_t loadedImageMap[MEMORY_SIZE / 8];
+
 // decodes file and stores raw instructions in memory
 void decodeFile(FILE* file);
 
+// decodes S-records from a text buffer into memory without printing, the S9 record sets the PC
+// loadedImageMap is left alone, returns the number of records, or -1 at the first line that isn't a record
+// or fails its checksum (records before it are already in memory)
+int decodeRecords(const char* text, size_t length);
+
+// returns 1 if the byte at address came from the loaded file
+int isLoadedAddress(uint16_t address);
+
 #endif // !FILE_DECODER_H
@@ -0,0 +1,444 @@
+#define _CRT_SECURE_NO_WARNINGS // to avoid errors on functions like fopen
+
+#include "fuzzer.h"
+#include "cpu.h"
+#include "interrupts.h"
+#include "memory.h"
+#include "platform.h"
+#include "registers.h"
+#include "scheduler.h"
+#include "state_hash.h"
+#include "timer.h"
+#include "uart.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MUTATIONS_PER_PARENT 64		// executions run from one corpus entry before picking another
+#define MAX_STACKED_MUTATIONS 8		// mutations applied on top of each other per execution
+#define STATUS_INTERVAL 1			// seconds between progress lines
+#define REPORT_BATCH 1024			// executions a worker runs between checking the clock and reporting them
+#define CORPUS_MAGIC "XM23FUZ1"
+
+THREAD_LOCAL uint8_t* edgeCoverageMap = NULL;
+
+// the machine as loaded, restored before every execution
+typedef struct {
+	uint8_t* memory;
+	uint16_t registers[REGISTER_COUNT];
+	uint16_t psw;
+} Snapshot;
+
+// shared between the workers
+typedef struct {
+	Snapshot base;
+	uint16_t inputAddress;
+	int inputLength;
+	uint64_t cycleBudget;
+	time_t endTime;
+
+	HostMutex corpusMutex;
+	uint8_t* corpus;			// corpusCount inputs of inputLength bytes
+	int corpusCount;
+	int corpusCapacity;
+
+	uint8_t virginMap[FUZZ_MAP_SIZE];	// bucket bits not yet seen by any execution, AFL style
+	int edgesFound;
+
+	volatile uint32_t executions;		// in batches of REPORT_BATCH, summed as workers report
+	volatile uint32_t halted;
+	volatile uint32_t asleep;
+	volatile uint32_t timeouts;
+} FuzzContext;
+
+// hit counts grouped into buckets (1, 2, 3, 4-7, 8-15, 16-31, 32-127, 128+), one bit per bucket
+static uint8_t countClass[256];
+
+static void buildCountClasses() {
+	for (int count = 0; count < 256; count++) {
+		countClass[count] =
+			count == 0 ? 0 : count == 1 ? 1 : count == 2 ? 2 : count == 3 ? 4 :
+			count < 8 ? 8 : count < 16 ? 16 : count < 32 ? 32 : count < 128 ? 64 : 128;
+	}
+}
+
+static uint32_t nextRandom(uint32_t* state) {
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+// adds an input to the corpus, caller holds the corpus mutex
+static int addToCorpus(FuzzContext* context, const uint8_t* input) {
+	if (context->corpusCount == context->corpusCapacity) {
+		int capacity = context->corpusCapacity ? context->corpusCapacity * 2 : 64;
+		uint8_t* grown = (uint8_t*)realloc(context->corpus, (size_t)capacity * context->inputLength);
+		if (grown == NULL) {
+			return 0;
+		}
+		context->corpus = grown;
+		context->corpusCapacity = capacity;
+	}
+
+	memcpy(context->corpus + (size_t)context->corpusCount * context->inputLength, input, context->inputLength);
+	context->corpusCount++;
+	return 1;
+}
+
+// corpus file layout: this header, then fixed-length inputs back to back
+// a corpus only means something for the program and input region it was found with
+typedef struct {
+	char magic[8];
+	uint64_t programHash;
+	uint32_t inputAddress;
+	uint32_t inputLength;
+} CorpusHeader;
+
+// the loaded image with the input region left out, so seeds written into the image don't invalidate the corpus
+static uint64_t hashProgram(FuzzContext* context) {
+	uint32_t inputEnd = context->inputAddress + context->inputLength;
+	uint64_t hash = hashBytes(context->base.memory, context->inputAddress, 0);
+	return hashBytes(context->base.memory + inputEnd, MEMORY_SIZE - inputEnd, hash);
+}
+
+static void fillCorpusHeader(FuzzContext* context, CorpusHeader* header) {
+	memset(header, 0, sizeof(CorpusHeader));
+	memcpy(header->magic, CORPUS_MAGIC, sizeof(header->magic));
+	header->programHash = hashProgram(context);
+	header->inputAddress = context->inputAddress;
+	header->inputLength = context->inputLength;
+}
+
+// seeds the corpus from the corpus file if it was saved for this program and input region,
+// otherwise from the input region as loaded
+static void loadCorpus(FuzzContext* context) {
+	FILE* file = fopen(FUZZ_CORPUS_FILE, "rb");
+	uint8_t* input = (uint8_t*)malloc(context->inputLength);
+	CorpusHeader expected, header;
+
+	fillCorpusHeader(context, &expected);
+
+	if (file != NULL && input != NULL) {
+		if (fread(&header, sizeof(header), 1, file) == 1 && memcmp(&header, &expected, sizeof(header)) == 0) {
+			while (fread(input, 1, context->inputLength, file) == (size_t)context->inputLength) {
+				addToCorpus(context, input);
+			}
+		}
+		else {
+			printf("Fuzzer warning: %s was saved for another program or input region, it will be overwritten\n",
+				FUZZ_CORPUS_FILE);
+		}
+	}
+	if (file != NULL) {
+		fclose(file);
+	}
+	free(input);
+
+	if (context->corpusCount == 0) {
+		addToCorpus(context, context->base.memory + context->inputAddress);
+	}
+}
+
+static void saveCorpus(FuzzContext* context) {
+	FILE* file = fopen(FUZZ_CORPUS_FILE, "wb");
+	CorpusHeader header;
+
+	if (file == NULL) {
+		printf("Fuzzer error: Unable to write %s\n", FUZZ_CORPUS_FILE);
+		return;
+	}
+	fillCorpusHeader(context, &header);
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(context->corpus, context->inputLength, context->corpusCount, file);
+	fclose(file);
+}
+
+// applies a stack of random byte-level mutations, splicing in part of another corpus entry now and then
+static void mutateInput(uint8_t* input, int length, const uint8_t* spliceSource, uint32_t* random) {
+	static const uint8_t interesting[] = { 0x00, 0x01, 0x02, 0x0A, 0x0D, 0x10, 0x20, 0x7F, 0x80, 0xFE, 0xFF };
+	int mutations = 1 + nextRandom(random) % MAX_STACKED_MUTATIONS;
+
+	for (int i = 0; i < mutations; i++) {
+		int position = nextRandom(random) % length;
+
+		switch (nextRandom(random) % 7) {
+			case 0: // flip a bit
+				input[position] ^= 1 << (nextRandom(random) & 0x07);
+				break;
+			case 1: // random byte
+				input[position] = (uint8_t)nextRandom(random);
+				break;
+			case 2: // small add or subtract
+				input[position] += (uint8_t)(nextRandom(random) % 35) - 17;
+				break;
+			case 3: // interesting byte value
+				input[position] = interesting[nextRandom(random) % sizeof(interesting)];
+				break;
+			case 4: // interesting word value, little endian like the guest
+				if (position + 1 < length) {
+					uint16_t value = (nextRandom(random) & 1) ? 0x8000 : 0x7FFF;
+					input[position] = value & 0xFF;
+					input[position + 1] = value >> 8;
+				}
+				break;
+			case 5: // copy a block within the input
+			{
+				int source = nextRandom(random) % length;
+				int count = 1 + nextRandom(random) % 16;
+				if (count > length - position) count = length - position;
+				if (count > length - source) count = length - source;
+				memmove(input + position, input + source, count);
+				break;
+			}
+			default: // splice the tail of another entry
+				if (spliceSource != NULL) {
+					memcpy(input + position, spliceSource + position, length - position);
+				}
+				break;
+		}
+	}
+}
+
+// puts the base snapshot back, only pages written since the last restore are copied
+static void restoreSnapshot(const Snapshot* base) {
+	for (int page = 0; page < MEMORY_PAGE_COUNT; page++) {
+		if (dirtyPages[page]) {
+			memcpy(memory + (page << MEMORY_PAGE_SHIFT), base->memory + (page << MEMORY_PAGE_SHIFT), 1 << MEMORY_PAGE_SHIFT);
+			dirtyPages[page] = 0;
+		}
+	}
+
+	memcpy(registerFile, base->registers, sizeof(registerFile));
+	PSW = base->psw;
+	cpuClock = 0;
+	instructionCount = 0;
+	cexExecuteCount = 0;
+	cexSkipCount = 0;
+	restoreInterruptState(0, 0);
+
+	// devices start every execution stopped and empty, as they are after loading
+	initializeScheduler();
+	initializeTimer();
+	initializeUART();
+}
+
+// buckets this execution's hit counts in place, returns 1 if a bucket bit was never seen before
+static int hasNewCoverage(FuzzContext* context, uint8_t* trace) {
+	int isNew = 0;
+
+	// most of the map is untouched, scan it a word at a time
+	uint64_t* words = (uint64_t*)trace;
+	for (int i = 0; i < FUZZ_MAP_SIZE / 8; i++) {
+		if (words[i] == 0) {
+			continue;
+		}
+		for (int j = i * 8; j < i * 8 + 8; j++) {
+			trace[j] = countClass[trace[j]];
+			if (trace[j] & context->virginMap[j]) {
+				isNew = 1;
+			}
+		}
+	}
+	return isNew;
+}
+
+// folds a trace into the virgin map under the corpus mutex, returns 1 if it still added anything
+static int commitCoverage(FuzzContext* context, const uint8_t* trace) {
+	int added = 0;
+
+	for (int i = 0; i < FUZZ_MAP_SIZE; i++) {
+		if (trace[i] & context->virginMap[i]) {
+			if (context->virginMap[i] == 0xFF) {
+				context->edgesFound++;
+			}
+			context->virginMap[i] &= ~trace[i];
+			added = 1;
+		}
+	}
+	return added;
+}
+
+static void fuzzWorker(void* argument) {
+	FuzzContext* context = (FuzzContext*)argument;
+	int length = context->inputLength;
+	uint8_t* parent = (uint8_t*)malloc(length);
+	uint8_t* splice = (uint8_t*)malloc(length);
+	uint8_t* input = (uint8_t*)malloc(length);
+	uint8_t* trace = (uint8_t*)calloc(FUZZ_MAP_SIZE, 1);
+	uint8_t pages[MEMORY_PAGE_COUNT];
+	uint32_t random = (uint32_t)(uintptr_t)&random ^ (uint32_t)time(NULL);
+	uint32_t executions = 0, halted = 0, asleep = 0, timeouts = 0;
+	int haveSplice = 0;
+
+	if (parent == NULL || splice == NULL || input == NULL || trace == NULL) {
+		printf("Fuzzer error: Out of memory in worker\n");
+		free(parent);
+		free(splice);
+		free(input);
+		free(trace);
+		return;
+	}
+	if (random == 0) random = 1;
+
+	// private machine, starts as a full copy of the base snapshot
+	initializeMemory();
+	memcpy(memory, context->base.memory, MEMORY_SIZE);
+	memset(pages, 0, sizeof(pages));
+	dirtyPages = pages;
+	edgeCoverageMap = trace;
+	traceEnabled = 0;
+
+	// this thread's own timer and UART on its device ports, so the guest sees the same devices as a real run
+	initializeScheduler();
+	initializeTimer();
+	initializeUART();
+	uartDiscardOutput(1);
+
+	while (1) {
+		// check the clock and report counts every so often rather than per execution
+		if (executions % REPORT_BATCH == 0 && executions) {
+			atomicAdd32(&context->executions, 1);
+			if (time(NULL) >= context->endTime) {
+				break;
+			}
+		}
+
+		// pick a new parent, and maybe a splice partner, from the shared corpus
+		if (executions % MUTATIONS_PER_PARENT == 0) {
+			hostMutexLock(&context->corpusMutex);
+			memcpy(parent, context->corpus + (size_t)(nextRandom(&random) % context->corpusCount) * length, length);
+			haveSplice = context->corpusCount > 1;
+			if (haveSplice) {
+				memcpy(splice, context->corpus + (size_t)(nextRandom(&random) % context->corpusCount) * length, length);
+			}
+			hostMutexUnlock(&context->corpusMutex);
+		}
+
+		memcpy(input, parent, length);
+		mutateInput(input, length, haveSplice && (nextRandom(&random) & 0x0F) == 0 ? splice : NULL, &random);
+
+		restoreSnapshot(&context->base);
+		memcpy(memory + context->inputAddress, input, length);
+
+		int status = cpuRun(context->cycleBudget);
+		executions++;
+		if (status == CPU_HALTED) halted++;
+		else if (status == CPU_ASLEEP) asleep++;
+		else timeouts++;
+
+		if (hasNewCoverage(context, trace)) {
+			hostMutexLock(&context->corpusMutex);
+			if (commitCoverage(context, trace)) {
+				addToCorpus(context, input);
+			}
+			hostMutexUnlock(&context->corpusMutex);
+		}
+		memset(trace, 0, FUZZ_MAP_SIZE);
+	}
+
+	atomicAdd32(&context->halted, halted);
+	atomicAdd32(&context->asleep, asleep);
+	atomicAdd32(&context->timeouts, timeouts);
+
+	edgeCoverageMap = NULL;
+	dirtyPages = NULL;
+	uartDiscardOutput(0);
+	cleanupMemory();
+	free(parent);
+	free(splice);
+	free(input);
+	free(trace);
+}
+
+int runFuzzer(uint16_t inputAddress, int inputLength, int threadCount, int seconds, uint64_t cycleBudget) {
+	FuzzContext* context;
+	HostThread* threads;
+
+	if (inputLength <= 0 || inputLength > FUZZ_MAX_INPUT_LENGTH || inputAddress + inputLength > MEMORY_SIZE) {
+		printf("Fuzzer error: Input region 0x%04X+%d is not valid (1-%d bytes inside memory)\n",
+			inputAddress, inputLength, FUZZ_MAX_INPUT_LENGTH);
+		return 1;
+	}
+	if (threadCount <= 0) threadCount = hostProcessorCount();
+	if (seconds <= 0) seconds = FUZZ_DEFAULT_SECONDS;
+	if (cycleBudget == 0) cycleBudget = FUZZ_DEFAULT_CYCLES;
+
+	context = (FuzzContext*)calloc(1, sizeof(FuzzContext));
+	threads = (HostThread*)malloc(threadCount * sizeof(HostThread));
+	if (context == NULL || threads == NULL || (context->base.memory = (uint8_t*)malloc(MEMORY_SIZE)) == NULL) {
+		printf("Fuzzer error: Out of memory\n");
+		free(context);
+		free(threads);
+		return 1;
+	}
+
+	// the machine as loaded by the caller is the base every execution starts from
+	memcpy(context->base.memory, memory, MEMORY_SIZE);
+	memcpy(context->base.registers, registerFile, sizeof(registerFile));
+	context->base.psw = PSW;
+	context->inputAddress = inputAddress;
+	context->inputLength = inputLength;
+	context->cycleBudget = cycleBudget;
+	memset(context->virginMap, 0xFF, FUZZ_MAP_SIZE);
+	hostMutexInit(&context->corpusMutex);
+	buildCountClasses();
+	loadCorpus(context);
+
+	printf("Fuzzing input 0x%04X+%d on %d threads for %d s, %llu cycles per execution, %d seed inputs\n\n",
+		inputAddress, inputLength, threadCount, seconds, (unsigned long long)cycleBudget, context->corpusCount);
+
+	time_t start = time(NULL);
+	context->endTime = start + seconds;
+
+	int started = 0;
+	for (int i = 0; i < threadCount; i++) {
+		if (!hostThreadCreate(&threads[i], fuzzWorker, context)) {
+			printf("Fuzzer error: Unable to start worker %d\n", i);
+			break;
+		}
+		started++;
+	}
+
+	// progress from the calling thread while the workers run
+	time_t lastStatus = start;
+	while (time(NULL) < context->endTime && started) {
+		hostSleep(100);
+		time_t now = time(NULL);
+		if (now - lastStatus >= STATUS_INTERVAL) {
+			hostMutexLock(&context->corpusMutex);
+			uint64_t reported = (uint64_t)context->executions * REPORT_BATCH;
+			printf("%4lld s  %12llu execs  %10.0f/s  corpus %6d  edges %6d\n",
+				(long long)(now - start), (unsigned long long)reported,
+				(double)reported / (double)(now - start), context->corpusCount, context->edgesFound);
+			hostMutexUnlock(&context->corpusMutex);
+			lastStatus = now;
+		}
+	}
+
+	for (int i = 0; i < started; i++) {
+		hostThreadJoin(threads[i]);
+	}
+
+	double elapsed = difftime(time(NULL), start);
+	uint64_t executions = (uint64_t)context->halted + context->asleep + context->timeouts;
+
+	printf("\n%llu executions in %.0f s (%.0f/s), %d corpus inputs, %d edges\n",
+		(unsigned long long)executions, elapsed, elapsed > 0 ? executions / elapsed : 0.0,
+		context->corpusCount, context->edgesFound);
+	printf("Outcomes: %u halted, %u asleep, %u hit the cycle budget\n", context->halted, context->asleep, context->timeouts);
+
+	saveCorpus(context);
+	printf("Corpus written to %s\n", FUZZ_CORPUS_FILE);
+
+	hostMutexDestroy(&context->corpusMutex);
+	free(context->corpus);
+	free(context->base.memory);
+	free(context);
+	free(threads);
+	return 0;
+}
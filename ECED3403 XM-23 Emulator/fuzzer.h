@@ -0,0 +1,25 @@
+#ifndef FUZZER_H
+#define FUZZER_H
+
+#include <stdint.h>
+#include "tls.h"
+
+#define FUZZ_MAP_SIZE (1 << 14)				// edge coverage map entries, one hit count byte each
+#define FUZZ_DEFAULT_CYCLES 100000ULL		// cycle budget per execution
+#define FUZZ_DEFAULT_SECONDS 10
+#define FUZZ_MAX_INPUT_LENGTH 4096
+#define FUZZ_CORPUS_FILE "fuzz_corpus.bin"	// inputs kept between runs of the same program, read as seeds and rewritten at the end
+
+// map index for a taken branch from one instruction address to another
+#define EDGE_INDEX(from, to) ((((uint16_t)(from) >> 1) * 0x9E37u ^ ((uint16_t)(to) >> 1)) & (FUZZ_MAP_SIZE - 1))
+
+// hit counts for taken branch edges on this thread, NULL unless a fuzz worker is running
+extern THREAD_LOCAL uint8_t* edgeCoverageMap;
+
+// fuzzes the program already loaded into memory: every execution restores the loaded memory and registers,
+// writes a mutated input of inputLength bytes at inputAddress and runs for cycleBudget cycles
+// inputs reaching new branch edges are added to a corpus shared by threadCount workers (0 for one per processor)
+// returns 0 once the time is up, 1 if the fuzzer couldn't start
+int runFuzzer(uint16_t inputAddress, int inputLength, int threadCount, int seconds, uint64_t cycleBudget);
+
+#endif // !FUZZER_H
@@ -0,0 +1,35 @@
+#include "hotspots.h"
+#include "decode.h"
+#include "memory.h"
+
+int findHotspots(const uint32_t* counts, int limit, uint16_t* addresses) {
+	int found = 0;
+
+	if (limit <= 0) {
+		return 0;
+	}
+
+	// one pass keeping the picks sorted, an insertion per word is fine for a report of a few lines
+	for (int word = 0; word < MEMORY_SIZE / 2; word++) {
+		uint32_t count = counts[word];
+
+		if (count == 0 || (found == limit && count <= counts[addresses[found - 1] >> 1])) {
+			continue;
+		}
+
+		int slot = found < limit ? found++ : limit - 1;
+		while (slot > 0 && counts[addresses[slot - 1] >> 1] < count) {
+			addresses[slot] = addresses[slot - 1];
+			slot--;
+		}
+		addresses[slot] = (uint16_t)(word << 1);
+	}
+	return found;
+}
+
+const char* hotspotMnemonic(uint16_t address, uint16_t* word) {
+	Instruction instruction;
+
+	*word = memory[address] | (memory[address + 1] << 8);
+	return decode(*word, &instruction) ? instruction.mnemonic : "?";
+}
@@ -0,0 +1,13 @@
+#ifndef HOTSPOTS_H
+#define HOTSPOTS_H
+
+#include <stdint.h>
+
+// picks the addresses of the instruction words with the largest nonzero counts, largest first, ties to the lower address
+// counts holds one entry per word address, returns how many were picked, at most limit
+int findHotspots(const uint32_t* counts, int limit, uint16_t* addresses);
+
+// the word in memory at address and its mnemonic, "?" if it doesn't decode
+const char* hotspotMnemonic(uint16_t address, uint16_t* word);
+
+#endif // !HOTSPOTS_H
@@ -0,0 +1,227 @@
+#include "interrupts.h"
+#include "registers.h"
+#include "bus.h"
+#include "platform.h"
+#include "cpu.h"
+#include "timing.h"
+
+#include <stdio.h>
+
+#define MAX_EXTERNAL_SOURCES 4
+
+THREAD_LOCAL volatile uint32_t interruptPending = 0;
+
+// vectors that have been requested by devices and not yet taken
+static THREAD_LOCAL uint16_t interruptRequests = 0;
+
+// devices fed by host threads, and the lock/condition a sleeping cpu blocks on waiting for them
+static ExternalInputHandler externalSources[MAX_EXTERNAL_SOURCES];
+static int externalSourceCount = 0;
+static volatile uint32_t* externalPendingWord = NULL; // the cpu thread's interruptPending, for the source threads
+static HostMutex externalMutex;
+static HostCondition externalCondition;
+static int externalInitialized = 0;
+
+// reads the handler priority (CP field) from a vector's PSW word
+static int vectorPriority(int vector) {
+	uint8_t lsb;
+	bus(VECTOR_ADDRESS(vector), &lsb, BUS_READ);
+	return (lsb & PSW_CP_MASK) >> 5;
+}
+
+static uint16_t readVectorWord(uint16_t address) {
+	uint8_t lsb, msb;
+	bus(address, &lsb, BUS_READ);
+	bus(address + 1, &msb, BUS_READ);
+	return (msb << 8) | lsb;
+}
+
+// pushes a word onto the stack (pre-decrementing SP)
+static void pushWord(uint16_t value) {
+	uint8_t lsb = value & 0xFF;
+	uint8_t msb = (value >> 8) & 0xFF;
+
+	registerFile[R_SP] -= 2;
+	bus(registerFile[R_SP], &lsb, BUS_WRITE);
+	bus(registerFile[R_SP] + 1, &msb, BUS_WRITE);
+}
+
+// pops a word off the stack (post-incrementing SP)
+static uint16_t popWord() {
+	uint8_t lsb, msb;
+
+	bus(registerFile[R_SP], &lsb, BUS_READ);
+	bus(registerFile[R_SP] + 1, &msb, BUS_READ);
+	registerFile[R_SP] += 2;
+
+	return (msb << 8) | lsb;
+}
+
+void initializeInterrupts() {
+	interruptRequests = 0;
+	interruptPending = 0;
+	externalSourceCount = 0;
+
+	if (!externalInitialized) {
+		hostMutexInit(&externalMutex);
+		hostConditionInit(&externalCondition);
+		externalInitialized = 1;
+	}
+}
+
+void updateInterruptPending() {
+	int currentPriority = (PSW & PSW_CP_MASK) >> 5;
+	uint32_t pending = 0;
+
+	// only requests whose handler priority beats the current priority count as pending
+	for (int vector = 0; vector < VECTOR_COUNT; vector++) {
+		if ((interruptRequests & (1u << vector)) && vectorPriority(vector) > currentPriority) {
+			pending |= 1u << vector;
+		}
+	}
+
+	if (PSW & PSW_SLP_MASK) {
+		pending |= INTERRUPT_SLEEP_PENDING;
+	}
+
+	// set and clear only the bits owned by the cpu thread, an external source may be setting its bit concurrently
+	uint32_t cpuBits = 0xFFFF | INTERRUPT_SLEEP_PENDING;
+	atomicOr32(&interruptPending, pending);
+	atomicAnd32(&interruptPending, pending | ~cpuBits);
+}
+
+void raiseInterrupt(int vector) {
+	if (vector < 0 || vector >= VECTOR_COUNT) {
+		printf("Interrupt error: Vector %d does not exist\n", vector);
+		return;
+	}
+	interruptRequests |= 1u << vector;
+	updateInterruptPending();
+}
+
+void clearInterrupt(int vector) {
+	if (vector < 0 || vector >= VECTOR_COUNT) {
+		return;
+	}
+	interruptRequests &= ~(1u << vector);
+	updateInterruptPending();
+}
+
+void enterException(int vector) {
+	uint16_t oldPSW = PSW;
+	uint16_t newPSW = readVectorWord(VECTOR_ADDRESS(vector));
+
+	// save state, the handler's return pops it back in reverse order
+	// the saved PSW has SLP cleared so the interrupted code wakes up once the handler returns
+	pushWord(registerFile[R_PC]);
+	pushWord(registerFile[R_LR]);
+	pushWord(oldPSW & ~PSW_SLP_MASK);
+
+	// handler runs with the vector's PSW, remembering the interrupted priority as the previous priority
+	PSW = (newPSW & ~PSW_PP_MASK) | ((oldPSW & PSW_CP_MASK) << 8);
+
+	registerFile[R_PC] = readVectorWord(VECTOR_ADDRESS(vector) + 2);
+	registerFile[R_LR] = INTERRUPT_RETURN_ADDRESS;
+
+	// stacking three words and reading the vector has its own cost when a timing model is loaded
+	if (timingModel != NULL) {
+		cpuClock += timingModel->interruptEntry;
+	}
+
+	updateInterruptPending();
+}
+
+// restores the state pushed by enterException
+static void returnFromInterrupt() {
+	PSW = popWord();
+	registerFile[R_LR] = popWord();
+	registerFile[R_PC] = popWord();
+}
+
+void serviceInterrupts() {
+	if (interruptPending & INTERRUPT_RETURN_PENDING) {
+		atomicAnd32(&interruptPending, ~INTERRUPT_RETURN_PENDING);
+		returnFromInterrupt();
+		updateInterruptPending();
+	}
+
+	// let devices fed by host threads pick up their input and raise their interrupts
+	if (interruptPending & INTERRUPT_EXTERNAL_PENDING) {
+		atomicAnd32(&interruptPending, ~INTERRUPT_EXTERNAL_PENDING);
+		// backwards, a source may remove itself
+		for (int i = externalSourceCount - 1; i >= 0; i--) {
+			externalSources[i]();
+		}
+	}
+
+	if (!(interruptPending & 0xFFFF)) {
+		return;
+	}
+
+	// take the highest priority pending vector, lowest vector number wins ties
+	int bestVector = -1;
+	int bestPriority = -1;
+	for (int vector = 0; vector < VECTOR_COUNT; vector++) {
+		if (interruptPending & (1u << vector)) {
+			int priority = vectorPriority(vector);
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				bestVector = vector;
+			}
+		}
+	}
+
+	// device requests are acknowledged when taken
+	interruptRequests &= ~(1u << bestVector);
+	enterException(bestVector);
+}
+
+void registerExternalSource(ExternalInputHandler handler) {
+	if (externalSourceCount == MAX_EXTERNAL_SOURCES) {
+		printf("Interrupt error: Too many external sources\n");
+		return;
+	}
+	externalSources[externalSourceCount++] = handler;
+
+	// interruptPending is thread-local, the source threads signal through the registering thread's copy
+	externalPendingWord = &interruptPending;
+}
+
+void removeExternalSource(ExternalInputHandler handler) {
+	for (int i = 0; i < externalSourceCount; i++) {
+		if (externalSources[i] == handler) {
+			externalSources[i] = externalSources[--externalSourceCount];
+			return;
+		}
+	}
+}
+
+int hasExternalSources() {
+	// the sources only signal the thread that registered them, any other cpu thread can't be woken by them
+	return externalSourceCount > 0 && externalPendingWord == &interruptPending;
+}
+
+void signalExternalInterrupt() {
+	hostMutexLock(&externalMutex);
+	atomicOr32(externalPendingWord, INTERRUPT_EXTERNAL_PENDING);
+	hostConditionSignal(&externalCondition);
+	hostMutexUnlock(&externalMutex);
+}
+
+void waitForExternalInterrupt() {
+	hostMutexLock(&externalMutex);
+	while (!(interruptPending & INTERRUPT_EXTERNAL_PENDING)) {
+		hostConditionWait(&externalCondition, &externalMutex);
+	}
+	hostMutexUnlock(&externalMutex);
+}
+
+void saveInterruptState(uint32_t* pending, uint16_t* requests) {
+	*pending = interruptPending;
+	*requests = interruptRequests;
+}
+
+void restoreInterruptState(uint32_t pending, uint16_t requests) {
+	interruptPending = pending;
+	interruptRequests = requests;
+}
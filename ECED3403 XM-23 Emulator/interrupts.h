@@ -0,0 +1,69 @@
+#ifndef INTERRUPTS_H
+#define INTERRUPTS_H
+
+#include <stdint.h>
+#include "tls.h"
+
+// interrupt vector table, 16 vectors of 4 bytes at the top of memory (PSW word, then PC word)
+#define VECTOR_BASE  0xFFC0
+#define VECTOR_COUNT 16
+#define VECTOR_ADDRESS(vector) (VECTOR_BASE + 4 * (vector))
+
+// device vectors, device n raises vector n
+#define VECTOR_TIMER 0
+#define VECTOR_UART  1
+
+// LR is loaded with this value on entry, moving it into the PC returns from the handler
+#define INTERRUPT_RETURN_ADDRESS 0xFFFF
+
+// bits in interruptPending that aren't vectors
+#define INTERRUPT_RETURN_PENDING   (1u << 31)	// return from the current handler
+#define INTERRUPT_SLEEP_PENDING    (1u << 30)	// PSW SLP is set, the cpu should sleep until something happens
+#define INTERRUPT_EXTERNAL_PENDING (1u << 29)	// a host thread has input for a device (set from any thread)
+
+// bits 0-15 are requested vectors that the current priority lets through, plus the flags above
+// the cpu loop tests this once per instruction and only calls serviceInterrupts() when it is non-zero
+extern THREAD_LOCAL volatile uint32_t interruptPending;
+
+// run on the cpu thread when an external input source has signalled, lets the device raise its interrupt
+typedef void (*ExternalInputHandler)();
+
+// clears all requests and pending interrupts
+void initializeInterrupts();
+
+// requests the device interrupt for the given vector, taken once the vector priority is above the current priority
+void raiseInterrupt(int vector);
+
+// withdraws a request for the given vector that has not been taken yet
+void clearInterrupt(int vector);
+
+// immediately enters the handler for the given vector regardless of priority (used for traps like SVC)
+void enterException(int vector);
+
+// recomputes the pending word, call after anything changes the priority or sleep bit in the PSW
+void updateInterruptPending();
+
+// handles what interruptPending flagged: returns from a handler, passes on external input,
+// and enters the highest priority pending vector (waking the cpu if it was asleep)
+void serviceInterrupts();
+
+// registers a device that is fed by a host thread, the handler runs whenever that thread signals
+void registerExternalSource(ExternalInputHandler handler);
+
+// unregisters a device that no longer has a host thread feeding it
+void removeExternalSource(ExternalInputHandler handler);
+
+// returns 1 if any registered external source could still wake a sleeping cpu on this thread
+int hasExternalSources();
+
+// called from any host thread when an external source has new input, wakes a blocked cpu
+void signalExternalInterrupt();
+
+// blocks the host thread until an external source signals
+void waitForExternalInterrupt();
+
+// copies this thread's pending word and device requests out, or back in, when the thread switches machines
+void saveInterruptState(uint32_t* pending, uint16_t* requests);
+void restoreInterruptState(uint32_t pending, uint16_t requests);
+
+#endif // !INTERRUPTS_H
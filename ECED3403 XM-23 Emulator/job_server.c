@@ -0,0 +1,658 @@
+#define _CRT_SECURE_NO_WARNINGS // to avoid errors on functions like fopen
+
+#include "job_server.h"
+#include "memory.h"
+#include "platform.h"
+#include "xm23.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+
+typedef SOCKET HostSocket;
+#define INVALID_HOST_SOCKET INVALID_SOCKET
+#define closeSocket closesocket
+#define removeSocketPath(path) DeleteFileA(path)
+#define SEND_FLAGS 0
+
+static void setReceiveTimeout(HostSocket socket, int milliseconds) {
+	DWORD timeout = (DWORD)milliseconds;
+	setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+}
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+typedef int HostSocket;
+#define INVALID_HOST_SOCKET (-1)
+#define closeSocket close
+#define removeSocketPath(path) unlink(path)
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL // a client hanging up mid-job shouldn't kill the server
+#else
+#define SEND_FLAGS 0
+#endif
+
+static void setReceiveTimeout(HostSocket socket, int milliseconds) {
+	struct timeval timeout = { milliseconds / 1000, (milliseconds % 1000) * 1000 };
+	setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+}
+#endif
+
+#define SERVER_BACKLOG 64
+#define SERVER_QUEUE_SIZE 256	// jobs waiting for a worker, a power of 2, one at most per connection so also the connection limit
+#define STREAM_CHUNK 4096		// largest output frame sent while a job runs
+
+// decoded image, the memory a job starts from when its S-records match the text it was decoded from
+// shared by the cache and any jobs still copying from it, freed with its last reference
+typedef struct {
+	uint32_t references;	// the cache's own and one per job copying from it, under cacheMutex
+	uint32_t length;
+	uint16_t startPC;
+	uint8_t memory[MEMORY_SIZE];
+	uint8_t text[];			// the S-records, compared on a hit as the hash alone could collide
+} ImageData;
+
+typedef struct {
+	uint64_t hash;
+	uint32_t lastUse;
+	ImageData* image;
+} CachedImage;
+
+typedef struct JobConnection JobConnection;
+
+// shared between the acceptor, the connection readers and the workers
+typedef struct {
+	HostMutex queueMutex;
+	HostCondition queueReady;
+	JobConnection* queue[SERVER_QUEUE_SIZE];	// connections with a job received and waiting for a worker
+	uint32_t queueHead;
+	uint32_t queueTail;
+	uint32_t connectionCount;
+
+	HostMutex cacheMutex;
+	CachedImage cache[JOB_CACHE_ENTRIES];
+	uint32_t cacheClock;
+} JobServer;
+
+// one client, its reader thread receives a job, queues it for any worker and waits for the result before the next
+// so a client sending jobs back to back takes its turn with the others instead of holding a worker
+struct JobConnection {
+	JobServer* server;
+	HostSocket socket;
+	uint8_t* payload;		// the job as received: JobRequest, the S-records, then the console input
+	uint32_t payloadCapacity;
+	JobRequest request;
+
+	HostMutex doneMutex;
+	HostCondition doneReady;
+	int done;
+	int clientAlive;		// 0 once a worker couldn't send to the client
+};
+
+// per-worker state, the machine is created once and reset between jobs
+typedef struct {
+	JobServer* server;
+	XM23Machine* machine;
+} JobWorker;
+
+static int startSockets() {
+#ifdef _WIN32
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+		printf("Server error: Unable to start Winsock\n");
+		return 0;
+	}
+#endif
+	return 1;
+}
+
+// fills a socket address for the path, returns 0 if the path is too long
+static int socketAddress(const char* path, struct sockaddr_un* address) {
+	memset(address, 0, sizeof(*address));
+	address->sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address->sun_path)) {
+		printf("Server error: Socket path %s is too long\n", path);
+		return 0;
+	}
+	strcpy(address->sun_path, path);
+	return 1;
+}
+
+static int sendAll(HostSocket socket, const void* data, size_t length) {
+	const char* bytes = (const char*)data;
+
+	while (length > 0) {
+		int sent = send(socket, bytes, (int)(length > 0x40000000 ? 0x40000000 : length), SEND_FLAGS);
+		if (sent <= 0) {
+			return 0;
+		}
+		bytes += sent;
+		length -= sent;
+	}
+	return 1;
+}
+
+// returns 0 if the peer closed or failed before length bytes arrived
+static int receiveAll(HostSocket socket, void* buffer, size_t length) {
+	char* bytes = (char*)buffer;
+
+	while (length > 0) {
+		int received = recv(socket, bytes, (int)(length > 0x40000000 ? 0x40000000 : length), 0);
+		if (received <= 0) {
+			return 0;
+		}
+		bytes += received;
+		length -= received;
+	}
+	return 1;
+}
+
+static int sendFrame(HostSocket socket, uint32_t type, const void* payload, uint32_t length) {
+	JobFrame frame = { type, length };
+	return sendAll(socket, &frame, sizeof(frame)) && (length == 0 || sendAll(socket, payload, length));
+}
+
+// FNV-1a over the S-record text, picks the cache entry whose text is then compared
+static uint64_t imageHash(const uint8_t* data, uint32_t length) {
+	uint64_t hash = 0xCBF29CE484222325ULL;
+
+	for (uint32_t i = 0; i < length; i++) {
+		hash = (hash ^ data[i]) * 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+static void releaseImage(JobServer* server, ImageData* image) {
+	hostMutexLock(&server->cacheMutex);
+	uint32_t references = --image->references;
+	hostMutexUnlock(&server->cacheMutex);
+
+	if (references == 0) {
+		free(image);
+	}
+}
+
+// copies a cached image into the machine, returns 0 if the text isn't cached
+static int loadCachedImage(JobServer* server, XM23Machine* machine, uint64_t hash, const uint8_t* text, uint32_t length) {
+	ImageData* image = NULL;
+
+	hostMutexLock(&server->cacheMutex);
+	for (int i = 0; i < JOB_CACHE_ENTRIES; i++) {
+		CachedImage* entry = &server->cache[i];
+		if (entry->image != NULL && entry->hash == hash && entry->image->length == length) {
+			image = entry->image;
+			image->references++;
+			entry->lastUse = ++server->cacheClock;
+			break;
+		}
+	}
+	hostMutexUnlock(&server->cacheMutex);
+
+	if (image == NULL) {
+		return 0;
+	}
+
+	// compared and copied outside the lock, the reference keeps the image alive if it's evicted meanwhile
+	int found = memcmp(image->text, text, length) == 0;
+	if (found) {
+		uint16_t registers[8] = { 0 };
+
+		xm23WriteMemory(machine, 0, image->memory, MEMORY_SIZE);
+		registers[7] = image->startPC;
+		xm23SetRegisters(machine, registers);
+	}
+	releaseImage(server, image);
+
+	return found;
+}
+
+// keeps the freshly loaded machine memory, replacing the least recently used entry
+static void cacheImage(JobServer* server, XM23Machine* machine, uint64_t hash, const uint8_t* text, uint32_t length) {
+	ImageData* image = (ImageData*)malloc(sizeof(ImageData) + length);
+	ImageData* evicted = NULL;
+	uint16_t registers[8];
+
+	if (image == NULL) {
+		return;
+	}
+	xm23ReadMemory(machine, 0, image->memory, MEMORY_SIZE);
+	xm23GetRegisters(machine, registers);
+	memcpy(image->text, text, length);
+	image->references = 1;
+	image->length = length;
+	image->startPC = registers[7];
+
+	hostMutexLock(&server->cacheMutex);
+	CachedImage* victim = &server->cache[0];
+	for (int i = 0; i < JOB_CACHE_ENTRIES; i++) {
+		CachedImage* entry = &server->cache[i];
+		if (entry->image == NULL) {
+			victim = entry;
+			break;
+		}
+		if (entry->lastUse < victim->lastUse) {
+			victim = entry;
+		}
+	}
+	if (victim->image != NULL && --victim->image->references == 0) {
+		evicted = victim->image;
+	}
+	victim->image = image;
+	victim->hash = hash;
+	victim->lastUse = ++server->cacheClock;
+	hostMutexUnlock(&server->cacheMutex);
+
+	free(evicted);
+}
+
+// sends whatever the guest has written since the last call
+static int streamOutput(JobWorker* worker, HostSocket socket) {
+	char chunk[STREAM_CHUNK];
+	size_t length;
+
+	while ((length = xm23ReadOutput(worker->machine, chunk, sizeof(chunk))) > 0) {
+		if (!sendFrame(socket, JOB_FRAME_OUTPUT, chunk, (uint32_t)length)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// runs one submitted job on the worker's machine, streaming output back in slices, returns 0 if the client went away
+static int runJob(JobWorker* worker, HostSocket socket, const JobRequest* request, const uint8_t* payload) {
+	XM23Machine* machine = worker->machine;
+	const uint8_t* image = payload + sizeof(JobRequest);
+	const uint8_t* input = image + request->imageLength;
+	uint64_t cycleLimit = request->cycleLimit ? request->cycleLimit : JOB_DEFAULT_CYCLES;
+	uint64_t hash = imageHash(image, request->imageLength);
+	JobResult result;
+
+	memset(&result, 0, sizeof(result));
+	xm23Reset(machine);
+
+	result.cacheHit = loadCachedImage(worker->server, machine, hash, image, request->imageLength);
+	if (!result.cacheHit) {
+		if (xm23LoadSRecords(machine, (const char*)image, request->imageLength) < 0) {
+			result.stopReason = JOB_STATUS_BAD_REQUEST;
+			return sendFrame(socket, JOB_FRAME_RESULT, &result, sizeof(result));
+		}
+		cacheImage(worker->server, machine, hash, image, request->imageLength);
+	}
+	xm23SetInput(machine, input, request->inputLength);
+
+	// run in slices so long jobs send their output as they go
+	XM23StopReason reason = XM23_STOP_CYCLE_LIMIT;
+	while (reason == XM23_STOP_CYCLE_LIMIT && xm23Cycles(machine) < cycleLimit) {
+		uint64_t remaining = cycleLimit - xm23Cycles(machine);
+		reason = xm23Run(machine, remaining < JOB_SLICE_CYCLES ? remaining : JOB_SLICE_CYCLES);
+		if (!streamOutput(worker, socket)) {
+			return 0;
+		}
+	}
+
+	result.stopReason = reason;
+	result.cycles = xm23Cycles(machine);
+	result.instructions = xm23Instructions(machine);
+	xm23GetRegisters(machine, result.registers);
+	result.psw = xm23GetPSW(machine);
+	return sendFrame(socket, JOB_FRAME_RESULT, &result, sizeof(result));
+}
+
+// queues a received job for the workers and waits until one has run it, returns 0 if the client went away
+static int dispatchJob(JobConnection* connection) {
+	JobServer* server = connection->server;
+
+	connection->done = 0;
+	hostMutexLock(&server->queueMutex);
+	server->queue[server->queueTail++ % SERVER_QUEUE_SIZE] = connection;
+	hostConditionSignal(&server->queueReady);
+	hostMutexUnlock(&server->queueMutex);
+
+	hostMutexLock(&connection->doneMutex);
+	while (!connection->done) {
+		hostConditionWait(&connection->doneReady, &connection->doneMutex);
+	}
+	hostMutexUnlock(&connection->doneMutex);
+	return connection->clientAlive;
+}
+
+// reads jobs from one client until it disconnects, sends something that isn't a job or goes quiet
+static void connectionReader(void* argument) {
+	JobConnection* connection = (JobConnection*)argument;
+	JobServer* server = connection->server;
+	HostSocket socket = connection->socket;
+	JobFrame frame;
+
+	// only a reader thread waits on an idle client, but it still holds a connection slot
+	setReceiveTimeout(socket, JOB_IDLE_TIMEOUT_MS);
+	while (receiveAll(socket, &frame, sizeof(frame))) {
+		if (frame.type != JOB_FRAME_SUBMIT || frame.length < sizeof(JobRequest) ||
+			frame.length > sizeof(JobRequest) + JOB_MAX_IMAGE + JOB_MAX_INPUT) {
+			break;
+		}
+
+		if (frame.length > connection->payloadCapacity) {
+			uint8_t* payload = (uint8_t*)realloc(connection->payload, frame.length);
+			if (payload == NULL) {
+				break;
+			}
+			connection->payload = payload;
+			connection->payloadCapacity = frame.length;
+		}
+		if (!receiveAll(socket, connection->payload, frame.length)) {
+			break;
+		}
+
+		memcpy(&connection->request, connection->payload, sizeof(JobRequest));
+		if (connection->request.imageLength > JOB_MAX_IMAGE || connection->request.inputLength > JOB_MAX_INPUT ||
+			sizeof(JobRequest) + (uint64_t)connection->request.imageLength + connection->request.inputLength != frame.length) {
+			JobResult result;
+			memset(&result, 0, sizeof(result));
+			result.stopReason = JOB_STATUS_BAD_REQUEST;
+			sendFrame(socket, JOB_FRAME_RESULT, &result, sizeof(result));
+			break;
+		}
+
+		if (!dispatchJob(connection)) {
+			break;
+		}
+	}
+
+	closeSocket(socket);
+	hostMutexLock(&server->queueMutex);
+	server->connectionCount--;
+	hostMutexUnlock(&server->queueMutex);
+
+	hostMutexDestroy(&connection->doneMutex);
+	hostConditionDestroy(&connection->doneReady);
+	free(connection->payload);
+	free(connection);
+}
+
+static void jobWorker(void* argument) {
+	JobWorker* worker = (JobWorker*)argument;
+	JobServer* server = worker->server;
+
+	while (1) {
+		hostMutexLock(&server->queueMutex);
+		while (server->queueHead == server->queueTail) {
+			hostConditionWait(&server->queueReady, &server->queueMutex);
+		}
+		JobConnection* connection = server->queue[server->queueHead++ % SERVER_QUEUE_SIZE];
+		hostMutexUnlock(&server->queueMutex);
+
+		int alive = runJob(worker, connection->socket, &connection->request, connection->payload);
+
+		hostMutexLock(&connection->doneMutex);
+		connection->clientAlive = alive;
+		connection->done = 1;
+		hostConditionSignal(&connection->doneReady);
+		hostMutexUnlock(&connection->doneMutex);
+	}
+}
+
+int runJobServer(const char* socketPath, int workerCount) {
+	static JobServer server;
+	struct sockaddr_un address;
+	HostSocket listener;
+
+	if (workerCount <= 0) workerCount = hostProcessorCount();
+	if (!startSockets() || !socketAddress(socketPath, &address)) {
+		return 1;
+	}
+
+	listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener == INVALID_HOST_SOCKET) {
+		printf("Server error: Unable to create socket\n");
+		return 1;
+	}
+	removeSocketPath(socketPath);
+	if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, SERVER_BACKLOG) != 0) {
+		printf("Server error: Unable to listen on %s\n", socketPath);
+		closeSocket(listener);
+		return 1;
+	}
+
+	hostMutexInit(&server.queueMutex);
+	hostConditionInit(&server.queueReady);
+	hostMutexInit(&server.cacheMutex);
+
+	// machines are allocated up front so a job never waits for one
+	int started = 0;
+	for (int i = 0; i < workerCount; i++) {
+		JobWorker* worker = (JobWorker*)calloc(1, sizeof(JobWorker));
+		HostThread thread;
+
+		if (worker == NULL || (worker->machine = xm23Create()) == NULL) {
+			free(worker);
+			break;
+		}
+		worker->server = &server;
+		if (!hostThreadCreate(&thread, jobWorker, worker)) {
+			xm23Destroy(worker->machine);
+			free(worker);
+			break;
+		}
+		started++;
+	}
+	if (started == 0) {
+		printf("Server error: Unable to start any workers\n");
+		closeSocket(listener);
+		return 1;
+	}
+
+	printf("Serving jobs on %s with %d worker%s\n", socketPath, started, started == 1 ? "" : "s");
+	fflush(stdout);
+
+	while (1) {
+		HostSocket client = accept(listener, NULL, NULL);
+		JobConnection* connection;
+		HostThread reader;
+
+		if (client == INVALID_HOST_SOCKET) {
+			continue;
+		}
+
+		// each connection queues one job at a time, capping connections keeps the queue from ever filling
+		hostMutexLock(&server.queueMutex);
+		int full = server.connectionCount == SERVER_QUEUE_SIZE;
+		if (!full) {
+			server.connectionCount++;
+		}
+		hostMutexUnlock(&server.queueMutex);
+
+		connection = full ? NULL : (JobConnection*)calloc(1, sizeof(JobConnection));
+		if (connection != NULL) {
+			connection->server = &server;
+			connection->socket = client;
+			hostMutexInit(&connection->doneMutex);
+			hostConditionInit(&connection->doneReady);
+			if (hostThreadCreate(&reader, connectionReader, connection)) {
+				hostThreadDetach(reader);
+				continue;
+			}
+			hostMutexDestroy(&connection->doneMutex);
+			hostConditionDestroy(&connection->doneReady);
+			free(connection);
+		}
+
+		// turned away rather than block accepting
+		if (!full) {
+			hostMutexLock(&server.queueMutex);
+			server.connectionCount--;
+			hostMutexUnlock(&server.queueMutex);
+		}
+		closeSocket(client);
+	}
+}
+
+// shared between the load generator's client threads
+typedef struct {
+	const char* socketPath;
+	uint8_t* message;		// complete JOB_FRAME_SUBMIT frame, sent as is for every job
+	size_t messageLength;
+	uint32_t jobCount;
+	uint64_t* latencies;	// nanoseconds, one slot per job
+	volatile uint32_t nextJob;
+	volatile uint32_t nextSlot;
+	volatile uint32_t cacheHits;
+	volatile uint32_t outputBytes;
+} LoadContext;
+
+// returns 0 if the server closed the connection or sent something unexpected
+static int awaitResult(HostSocket socket, LoadContext* context) {
+	JobFrame frame;
+	JobResult result;
+	char discard[STREAM_CHUNK];
+
+	while (receiveAll(socket, &frame, sizeof(frame))) {
+		if (frame.type == JOB_FRAME_OUTPUT && frame.length <= sizeof(discard)) {
+			if (!receiveAll(socket, discard, frame.length)) {
+				return 0;
+			}
+			atomicAdd32(&context->outputBytes, frame.length);
+		}
+		else if (frame.type == JOB_FRAME_RESULT && frame.length == sizeof(result)) {
+			if (!receiveAll(socket, &result, sizeof(result))) {
+				return 0;
+			}
+			if (result.cacheHit) {
+				atomicAdd32(&context->cacheHits, 1);
+			}
+			return result.stopReason != JOB_STATUS_BAD_REQUEST;
+		}
+		else {
+			return 0;
+		}
+	}
+	return 0;
+}
+
+static void loadClient(void* argument) {
+	LoadContext* context = (LoadContext*)argument;
+	struct sockaddr_un address;
+	HostSocket client = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	socketAddress(context->socketPath, &address);
+	if (client == INVALID_HOST_SOCKET || connect(client, (struct sockaddr*)&address, sizeof(address)) != 0) {
+		if (client != INVALID_HOST_SOCKET) {
+			closeSocket(client);
+		}
+		return;
+	}
+
+	// jobs are taken from a shared count, so clients that finish early pick up the rest
+	// latency covers sending the job through to its result, so queueing behind other clients counts
+	while (atomicAdd32(&context->nextJob, 1) < context->jobCount) {
+		uint64_t start = hostTimeNanoseconds();
+		if (!sendAll(client, context->message, context->messageLength) || !awaitResult(client, context)) {
+			break;
+		}
+		context->latencies[atomicAdd32(&context->nextSlot, 1)] = hostTimeNanoseconds() - start;
+	}
+
+	closeSocket(client);
+}
+
+static int compareLatency(const void* a, const void* b) {
+	uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return x < y ? -1 : x > y;
+}
+
+// reads the whole file, returns NULL if it can't be read or is too large for a job
+static uint8_t* readImage(const char* path, uint32_t* length) {
+	FILE* file = fopen(path, "rb");
+	uint8_t* data;
+	long size;
+
+	if (file == NULL) {
+		printf("Load generator error: Unable to open %s\n", path);
+		return NULL;
+	}
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (size < 0 || size > JOB_MAX_IMAGE || (data = (uint8_t*)malloc(size ? size : 1)) == NULL ||
+		fread(data, 1, size, file) != (size_t)size) {
+		printf("Load generator error: Unable to read %s\n", path);
+		fclose(file);
+		return NULL;
+	}
+	fclose(file);
+	*length = (uint32_t)size;
+	return data;
+}
+
+int runLoadGenerator(const char* socketPath, const char* imagePath, int jobCount, int clientCount, uint64_t cycleLimit) {
+	static LoadContext context;
+	HostThread threads[256];
+	uint32_t imageLength;
+	uint8_t* image;
+
+	if (clientCount <= 0) clientCount = 1;
+	if (clientCount > 256) clientCount = 256;
+	if (jobCount < clientCount) jobCount = clientCount;
+	if (!startSockets() || (image = readImage(imagePath, &imageLength)) == NULL) {
+		return 1;
+	}
+
+	// one frame per job: header, request, image, no console input
+	JobFrame frame = { JOB_FRAME_SUBMIT, (uint32_t)(sizeof(JobRequest) + imageLength) };
+	JobRequest request = { cycleLimit, imageLength, 0 };
+	context.socketPath = socketPath;
+	context.jobCount = (uint32_t)jobCount;
+	context.messageLength = sizeof(frame) + sizeof(request) + imageLength;
+	context.message = (uint8_t*)malloc(context.messageLength);
+	context.latencies = (uint64_t*)calloc(jobCount, sizeof(uint64_t));
+	if (context.message == NULL || context.latencies == NULL) {
+		printf("Load generator error: Unable to allocate job buffers\n");
+		free(image);
+		return 1;
+	}
+	memcpy(context.message, &frame, sizeof(frame));
+	memcpy(context.message + sizeof(frame), &request, sizeof(request));
+	memcpy(context.message + sizeof(frame) + sizeof(request), image, imageLength);
+	free(image);
+
+	uint64_t start = hostTimeNanoseconds();
+	int started = 0;
+	for (int i = 0; i < clientCount; i++) {
+		if (hostThreadCreate(&threads[started], loadClient, &context)) {
+			started++;
+		}
+	}
+	for (int i = 0; i < started; i++) {
+		hostThreadJoin(threads[i]);
+	}
+	double seconds = (hostTimeNanoseconds() - start) / 1e9;
+
+	// a job a client failed on or never got to, because it couldn't connect or the server went away, is a failure
+	uint32_t completed = context.nextSlot;
+	uint32_t failures = (uint32_t)jobCount - completed;
+	printf("Load generator: %u jobs from %d client%s, %u failed, %.2f s\n",
+		completed, clientCount, clientCount == 1 ? "" : "s", failures, seconds);
+
+	if (completed > 0) {
+		qsort(context.latencies, completed, sizeof(uint64_t), compareLatency);
+		printf("  Throughput   : %.1f jobs/s\n", seconds > 0 ? completed / seconds : 0.0);
+		printf("  Cache hits   : %u of %u\n", context.cacheHits, completed);
+		printf("  Output bytes : %u\n", context.outputBytes);
+		printf("  Latency (us) : p50 %.1f  p99 %.1f  max %.1f\n",
+			context.latencies[(completed - 1) / 2] / 1e3,
+			context.latencies[(uint32_t)((completed - 1) * 0.99)] / 1e3,
+			context.latencies[completed - 1] / 1e3);
+	}
+
+	free(context.message);
+	free(context.latencies);
+	return failures == 0 && completed > 0 ? 0 : 1;
+}
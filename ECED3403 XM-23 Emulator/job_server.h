@@ -0,0 +1,52 @@
+#ifndef JOB_SERVER_H
+#define JOB_SERVER_H
+
+#include <stdint.h>
+
+#define JOB_DEFAULT_CYCLES 10000000ULL	// cycle limit for jobs that don't give one
+#define JOB_SLICE_CYCLES 1000000ULL		// cycles run between streaming output back to the client
+#define JOB_MAX_IMAGE (1 << 20)			// largest S-record text accepted in a job
+#define JOB_MAX_INPUT (1 << 20)			// largest console input accepted in a job
+#define JOB_CACHE_ENTRIES 32			// decoded images kept by content hash
+#define JOB_IDLE_TIMEOUT_MS 10000		// a connection that sends nothing for this long is closed
+
+// every message on the socket is a frame header followed by length bytes of payload, in host byte order
+// a client sends JOB_FRAME_SUBMIT, gets zero or more JOB_FRAME_OUTPUT while it runs, then one JOB_FRAME_RESULT
+// and may then submit another job on the same connection, within JOB_IDLE_TIMEOUT_MS of the result
+#define JOB_FRAME_SUBMIT 1	// JobRequest, then imageLength bytes of S-records, then inputLength bytes of console input
+#define JOB_FRAME_OUTPUT 2	// console output written by the guest since the last frame
+#define JOB_FRAME_RESULT 3	// JobResult
+
+#define JOB_STATUS_BAD_REQUEST 0xFFFFFFFFu	// stopReason when the job couldn't be read or its image didn't load
+
+typedef struct {
+	uint32_t type;
+	uint32_t length;
+} JobFrame;
+
+typedef struct {
+	uint64_t cycleLimit;	// 0 for JOB_DEFAULT_CYCLES
+	uint32_t imageLength;
+	uint32_t inputLength;
+} JobRequest;
+
+typedef struct {
+	uint32_t stopReason;	// XM23StopReason, or JOB_STATUS_BAD_REQUEST
+	uint32_t cacheHit;		// the image was already decoded by an earlier job
+	uint64_t cycles;
+	uint64_t instructions;
+	uint16_t registers[8];
+	uint16_t psw;
+	uint16_t reserved[3];
+} JobResult;
+
+// serves jobs on a Unix domain socket with a pool of workers each holding a ready machine, runs until killed
+// jobs from every connection share one queue, so workers take them in arrival order whichever client sent them
+// workerCount 0 uses one worker per host processor, returns 1 if the socket couldn't be set up
+int runJobServer(const char* socketPath, int workerCount);
+
+// submits jobCount copies of the image from clientCount concurrent connections and reports job latency percentiles
+// returns 0 if every job completed, 1 otherwise
+int runLoadGenerator(const char* socketPath, const char* imagePath, int jobCount, int clientCount, uint64_t cycleLimit);
+
+#endif // !JOB_SERVER_H
@@ -0,0 +1,849 @@
+#include "lockstep.h"
+#include "cpu.h"
+#include "decode.h"
+#include "execute.h"
+#include "bus.h"
+#include "interrupts.h"
+#include "memory.h"
+#include "registers.h"
+#include "platform.h"
+#include "scheduler.h"
+#include "state_hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// the AVX2 kernels are built wherever the compiler can target AVX2 one function at a time,
+// and only used once the host is known to have it, so one build runs on any x86 processor
+#if defined(_M_X64) || defined(_M_IX86) || ((defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)))
+#include <immintrin.h>
+#define LOCKSTEP_AVX2
+#ifdef _MSC_VER
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+#define LANE_BLOCK 16 // 16-bit lanes per AVX2 register, lane arrays are padded to a multiple of this
+
+#define FLAG_BITS (PSW_C | PSW_Z | PSW_N | PSW_V)
+
+#define MARK_STORED(map, address) ((map)[(uint16_t)(address) >> 3] |= (uint8_t)(1 << ((address) & 7)))
+#define WAS_STORED(map, address) (((map)[(uint16_t)(address) >> 3] >> ((address) & 7)) & 1)
+
+// final state of one lane
+typedef struct {
+	uint16_t registers[REGISTER_COUNT];
+	uint16_t psw;
+	int status;
+	uint64_t instructions;
+	uint64_t memoryHash;	// the lane's memory at the end, compared rather than kept
+} LaneResult;
+
+// the lanes still running in lockstep, one array per register so an instruction touches contiguous lanes
+// active lanes are kept packed at the front, a lane leaving swaps the last active lane into its slot
+typedef struct {
+	int activeCount;
+	uint16_t* registers[REGISTER_COUNT];
+	uint16_t* psw;
+	int* laneId;
+	uint8_t** laneMemory;
+	uint32_t* pending;		// interrupt state a lane's instruction raised, the scalar engine services it
+	uint16_t* fetched;		// each lane's next instruction word, filled when lanes may have rewritten their code
+	uint8_t* storedMap;		// one bit per address any lane has stored to, the only places lane memories can differ
+} LaneSet;
+
+// the program as loaded, every lane starts from it
+typedef struct {
+	uint8_t* memory;
+	uint16_t registers[REGISTER_COUNT];
+	uint16_t psw;
+} LaneImage;
+
+static uint64_t lockstepInstructions;	// lane instructions executed while in lockstep
+static int splitLanes;					// lanes handed to the scalar engine before finishing
+static int useAVX2;						// the host has AVX2, checked once per run
+
+// rounds the active count up to whole blocks, padding lanes compute garbage that is never read
+static int paddedCount(const LaneSet* set) {
+	return (set->activeCount + LANE_BLOCK - 1) / LANE_BLOCK * LANE_BLOCK;
+}
+
+// runs a lane's state to the cycle limit on the scalar engine from the given clock, then records it
+static void finishLaneScalar(const LaneSet* set, int slot, uint64_t clock, uint64_t instructions,
+	uint64_t cycleLimit, LaneResult* results) {
+	LaneResult* result = &results[set->laneId[slot]];
+	uint8_t* savedMemory = memory;
+
+	for (int r = 0; r < REGISTER_COUNT; r++) {
+		registerFile[r] = set->registers[r][slot];
+	}
+	PSW = set->psw[slot];
+	memory = set->laneMemory[slot];
+	cpuClock = clock;
+	instructionCount = instructions;
+	cexExecuteCount = 0;
+	cexSkipCount = 0;
+	interruptPending = set->pending[slot];
+
+	result->status = cpuRun(cycleLimit);
+	memcpy(result->registers, registerFile, sizeof(registerFile));
+	result->psw = PSW;
+	result->instructions = instructionCount;
+	result->memoryHash = hashBytes(memory, MEMORY_SIZE, 0);
+
+	memory = savedMemory;
+	interruptPending = 0;
+}
+
+// records a lane that ended in lockstep
+static void finishLaneInPlace(const LaneSet* set, int slot, int status, uint64_t instructions, LaneResult* results) {
+	LaneResult* result = &results[set->laneId[slot]];
+
+	for (int r = 0; r < REGISTER_COUNT; r++) {
+		result->registers[r] = set->registers[r][slot];
+	}
+	result->psw = set->psw[slot];
+	result->status = status;
+	result->memoryHash = hashBytes(set->laneMemory[slot], MEMORY_SIZE, 0);
+	result->instructions = instructions;
+}
+
+// drops a lane from the set, its memory is freed
+static void removeLane(LaneSet* set, int slot) {
+	int last = --set->activeCount;
+
+	free(set->laneMemory[slot]);
+	for (int r = 0; r < REGISTER_COUNT; r++) {
+		set->registers[r][slot] = set->registers[r][last];
+	}
+	set->psw[slot] = set->psw[last];
+	set->laneId[slot] = set->laneId[last];
+	set->laneMemory[slot] = set->laneMemory[last];
+	set->pending[slot] = set->pending[last];
+}
+
+#ifdef LOCKSTEP_AVX2
+// AVX2 form of addToLanes, a block of lanes per instruction
+static AVX2_TARGET void addToLanesAVX2(uint16_t* values, uint16_t amount, int count) {
+	for (int i = 0; i < count; i += LANE_BLOCK) {
+		__m256i v = _mm256_loadu_si256((__m256i*)(values + i));
+		_mm256_storeu_si256((__m256i*)(values + i), _mm256_add_epi16(v, _mm256_set1_epi16((short)amount)));
+	}
+}
+#endif
+
+// adds a constant to one register in every lane, used to move all the PCs past a fetch
+static void addToLanes(uint16_t* values, uint16_t amount, int count) {
+#ifdef LOCKSTEP_AVX2
+	if (useAVX2) {
+		addToLanesAVX2(values, amount, count);
+		return;
+	}
+#endif
+	for (int i = 0; i < count; i += LANE_BLOCK) {
+		for (int j = i; j < i + LANE_BLOCK; j++) {
+			values[j] += amount;
+		}
+	}
+}
+
+// PSW flag bits from a result, carry and overflow already in bit 0
+static uint16_t laneFlags(uint16_t result, uint16_t carry, uint16_t overflow) {
+	return carry | (result == 0 ? PSW_Z : 0) | ((result >> 15) ? PSW_N : 0) | (overflow ? PSW_V : 0);
+}
+
+#ifdef LOCKSTEP_AVX2
+// AVX2 form of executeALWord once it has ruled out the per-lane cases
+static AVX2_TARGET void executeALWordAVX2(uint16_t* d, uint16_t* s, uint16_t* psw, uint16_t opcode, uint16_t constant, uint16_t bit,
+	int useConstant, int count) {
+	int isArithmetic = opcode <= 0x43 || opcode == 0x45;
+	int isSubtraction = opcode == 0x42 || opcode == 0x43 || opcode == 0x45;
+	int writesResult = opcode != 0x45 && opcode != 0x49;
+
+	for (int i = 0; i < count; i += LANE_BLOCK) {
+		const __m256i one = _mm256_set1_epi16(1);
+		const __m256i zero = _mm256_setzero_si256();
+		__m256i vd = _mm256_loadu_si256((__m256i*)(d + i));
+		__m256i vs = useConstant ? _mm256_set1_epi16((short)constant) : _mm256_loadu_si256((__m256i*)(s + i));
+		__m256i vp = _mm256_loadu_si256((__m256i*)(psw + i));
+		__m256i result, carry = zero, overflow = zero;
+
+		if (isArithmetic) {
+			// subtraction adds the complement, SUB and CMP carry in 1, ADDC and SUBC carry in C
+			__m256i addend = isSubtraction ? _mm256_xor_si256(vs, _mm256_set1_epi16(-1)) : vs;
+			__m256i carryIn = (opcode == 0x41 || opcode == 0x43) ? _mm256_and_si256(vp, one) : (opcode == 0x40 ? zero : one);
+			result = _mm256_add_epi16(_mm256_add_epi16(vd, addend), carryIn);
+			carry = _mm256_srli_epi16(_mm256_or_si256(_mm256_and_si256(vd, addend),
+				_mm256_andnot_si256(result, _mm256_or_si256(vd, addend))), 15);
+			overflow = _mm256_srli_epi16(_mm256_and_si256(_mm256_xor_si256(vd, result), _mm256_xor_si256(addend, result)), 15);
+		}
+		else {
+			__m256i vbit = _mm256_set1_epi16((short)bit);
+			switch (opcode) {
+				case 0x46: result = _mm256_xor_si256(vd, vs); break;
+				case 0x47: result = _mm256_and_si256(vd, vs); break;
+				case 0x48: result = _mm256_or_si256(vd, vs); break;
+				case 0x49: result = _mm256_and_si256(vd, vbit); break;
+				case 0x4A: result = _mm256_andnot_si256(vbit, vd); break;
+				default:   result = _mm256_or_si256(vd, vbit); break;
+			}
+		}
+
+		__m256i flags = _mm256_or_si256(
+			_mm256_or_si256(carry, _mm256_slli_epi16(_mm256_and_si256(_mm256_cmpeq_epi16(result, zero), one), 1)),
+			_mm256_or_si256(_mm256_slli_epi16(_mm256_srli_epi16(result, 15), 2), _mm256_slli_epi16(overflow, 4)));
+		vp = _mm256_or_si256(_mm256_andnot_si256(_mm256_set1_epi16(FLAG_BITS), vp), flags);
+
+		_mm256_storeu_si256((__m256i*)(psw + i), vp);
+		if (writesResult) {
+			_mm256_storeu_si256((__m256i*)(d + i), result);
+		}
+	}
+}
+#endif
+
+// word-mode ADD/ADDC/SUB/SUBC/CMP and XOR/AND/OR, plus BIT/BIC/BIS with a constant bit number
+// returns 0 if the instruction needs the per-lane path
+static int executeALWord(LaneSet* set, uint16_t opcode, int dst, int src, int useConstant, int count) {
+	uint16_t* d = set->registers[dst];
+	uint16_t* s = set->registers[src];
+	uint16_t* psw = set->psw;
+	uint16_t constant = (uint16_t)(int16_t)constants[src];
+	int isArithmetic = opcode <= 0x43 || opcode == 0x45;
+	int isSubtraction = opcode == 0x42 || opcode == 0x43 || opcode == 0x45;
+	int writesResult = opcode != 0x45 && opcode != 0x49;
+
+	// DADD, and bit numbers that differ per lane, stay on the per-lane path
+	if (opcode == 0x44 || (opcode >= 0x49 && !useConstant)) {
+		return 0;
+	}
+	uint16_t bit = 1 << (constant & 0x0F);
+
+#ifdef LOCKSTEP_AVX2
+	if (useAVX2) {
+		executeALWordAVX2(d, s, psw, opcode, constant, bit, useConstant, count);
+		return 1;
+	}
+#endif
+	for (int i = 0; i < count; i += LANE_BLOCK) {
+		for (int j = i; j < i + LANE_BLOCK; j++) {
+			uint16_t dj = d[j], sj = useConstant ? constant : s[j];
+			uint16_t result, carry = 0, overflow = 0;
+
+			if (isArithmetic) {
+				uint16_t addend = isSubtraction ? ~sj : sj;
+				uint16_t carryIn = (opcode == 0x41 || opcode == 0x43) ? (psw[j] & PSW_C) : (opcode == 0x40 ? 0 : 1);
+				result = dj + addend + carryIn;
+				carry = ((dj & addend) | ((dj | addend) & ~result)) >> 15;
+				overflow = ((dj ^ result) & (addend ^ result)) >> 15;
+			}
+			else {
+				switch (opcode) {
+					case 0x46: result = dj ^ sj; break;
+					case 0x47: result = dj & sj; break;
+					case 0x48: result = dj | sj; break;
+					case 0x49: result = dj & bit; break;
+					case 0x4A: result = dj & ~bit; break;
+					default:   result = dj | bit; break;
+				}
+			}
+
+			psw[j] = (psw[j] & ~FLAG_BITS) | laneFlags(result, carry, overflow);
+			if (writesResult) {
+				d[j] = result;
+			}
+		}
+	}
+	return 1;
+}
+
+#ifdef LOCKSTEP_AVX2
+// AVX2 form of executeSOWord
+static AVX2_TARGET void executeSOWordAVX2(uint16_t* d, uint16_t* psw, uint16_t opcode, int count) {
+	int setsCarry = opcode == 0x4D00 || opcode == 0x4D08;
+
+	for (int i = 0; i < count; i += LANE_BLOCK) {
+		const __m256i one = _mm256_set1_epi16(1);
+		const __m256i zero = _mm256_setzero_si256();
+		__m256i vd = _mm256_loadu_si256((__m256i*)(d + i));
+		__m256i vp = _mm256_loadu_si256((__m256i*)(psw + i));
+		__m256i result;
+
+		switch (opcode) {
+			case 0x4D00: result = _mm256_srai_epi16(vd, 1); break;
+			case 0x4D08: result = _mm256_or_si256(_mm256_srli_epi16(vd, 1), _mm256_slli_epi16(_mm256_and_si256(vp, one), 15)); break;
+			case 0x4D10: result = _mm256_xor_si256(vd, _mm256_set1_epi16(-1)); break;
+			case 0x4D18: result = _mm256_or_si256(_mm256_slli_epi16(vd, 8), _mm256_srli_epi16(vd, 8)); break;
+			default:     result = _mm256_srai_epi16(_mm256_slli_epi16(vd, 8), 8); break;
+		}
+
+		__m256i flags = _mm256_or_si256(
+			setsCarry ? _mm256_and_si256(vd, one) : zero,
+			_mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(_mm256_cmpeq_epi16(result, zero), one), 1),
+				_mm256_slli_epi16(_mm256_srli_epi16(result, 15), 2)));
+		vp = _mm256_or_si256(_mm256_andnot_si256(_mm256_set1_epi16(FLAG_BITS), vp), flags);
+
+		_mm256_storeu_si256((__m256i*)(psw + i), vp);
+		_mm256_storeu_si256((__m256i*)(d + i), result);
+	}
+}
+#endif
+
+// word-mode SRA/RRC/COMP and SWPB/SXT, returns 0 if the instruction needs the per-lane path
+static int executeSOWord(LaneSet* set, uint16_t opcode, int dst, int count) {
+	uint16_t* d = set->registers[dst];
+	uint16_t* psw = set->psw;
+	int setsCarry = opcode == 0x4D00 || opcode == 0x4D08;
+
+#ifdef LOCKSTEP_AVX2
+	if (useAVX2) {
+		executeSOWordAVX2(d, psw, opcode, count);
+		return 1;
+	}
+#endif
+	for (int i = 0; i < count; i += LANE_BLOCK) {
+		for (int j = i; j < i + LANE_BLOCK; j++) {
+			uint16_t dj = d[j], result;
+
+			switch (opcode) {
+				case 0x4D00: result = (dj >> 1) | (dj & 0x8000); break;
+				case 0x4D08: result = (dj >> 1) | ((psw[j] & PSW_C) << 15); break;
+				case 0x4D10: result = ~dj; break;
+				case 0x4D18: result = (dj << 8) | (dj >> 8); break;
+				default:     result = (uint16_t)(int16_t)(int8_t)(dj & 0xFF); break;
+			}
+
+			psw[j] = (psw[j] & ~FLAG_BITS) | laneFlags(result, setsCarry ? (dj & 1) : 0, 0);
+			d[j] = result;
+		}
+	}
+	return 1;
+}
+
+#ifdef LOCKSTEP_AVX2
+// AVX2 form of executeRINLanes
+static AVX2_TARGET void executeRINLanesAVX2(uint16_t* d, uint16_t keep, uint16_t add, int count) {
+	for (int i = 0; i < count; i += LANE_BLOCK) {
+		__m256i vd = _mm256_loadu_si256((__m256i*)(d + i));
+		vd = _mm256_or_si256(_mm256_and_si256(vd, _mm256_set1_epi16((short)keep)), _mm256_set1_epi16((short)add));
+		_mm256_storeu_si256((__m256i*)(d + i), vd);
+	}
+}
+#endif
+
+// MOVL/MOVLZ/MOVLS/MOVH, each keeps part of the register and ors in the immediate byte
+static void executeRINLanes(LaneSet* set, uint16_t opcode, int dst, uint16_t value, int count) {
+	uint16_t* d = set->registers[dst];
+	uint16_t keep, add;
+
+	switch (opcode) {
+		case 0x60: keep = 0xFF00; add = value; break;
+		case 0x68: keep = 0x0000; add = value; break;
+		case 0x70: keep = 0x0000; add = 0xFF00 | value; break;
+		default:   keep = 0x00FF; add = value << 8; break;
+	}
+
+#ifdef LOCKSTEP_AVX2
+	if (useAVX2) {
+		executeRINLanesAVX2(d, keep, add, count);
+		return;
+	}
+#endif
+	for (int i = 0; i < count; i += LANE_BLOCK) {
+		for (int j = i; j < i + LANE_BLOCK; j++) {
+			d[j] = (d[j] & keep) | add;
+		}
+	}
+}
+
+// flags the lanes a kernel moved the interrupt return address into the PC for, as writeToRegister does
+static void markInterruptReturns(LaneSet* set) {
+	for (int slot = 0; slot < set->activeCount; slot++) {
+		if (set->registers[R_PC][slot] == INTERRUPT_RETURN_ADDRESS) {
+			set->pending[slot] |= INTERRUPT_RETURN_PENDING;
+		}
+	}
+}
+
+// runs a decoded instruction for one lane on the scalar execute()
+static void executeOneLane(LaneSet* set, int slot, const Instruction* instruction) {
+	uint8_t* savedMemory = memory;
+
+	for (int r = 0; r < REGISTER_COUNT; r++) {
+		registerFile[r] = set->registers[r][slot];
+	}
+	PSW = set->psw[slot];
+	memory = set->laneMemory[slot];
+
+	// execute() narrows the opcode in place, so every lane gets its own copy
+	Instruction laneInstruction = *instruction;
+	execute(&laneInstruction);
+
+	for (int r = 0; r < REGISTER_COUNT; r++) {
+		set->registers[r][slot] = registerFile[r];
+	}
+	set->psw[slot] = PSW;
+	set->pending[slot] |= interruptPending;
+
+	memory = savedMemory;
+	interruptPending = 0;
+}
+
+// everything without a lockstep kernel runs through the scalar execute() lane by lane
+static void executePerLane(LaneSet* set, const Instruction* instruction) {
+	for (int slot = 0; slot < set->activeCount; slot++) {
+		executeOneLane(set, slot, instruction);
+	}
+}
+
+// LD/ST/LDR/STR straight on each lane's memory, accesses to device ports go through execute() and the bus
+static void executeMEMLanes(LaneSet* set, const Instruction* instruction, uint16_t opcode, uint16_t word) {
+	int dst = word & 0x07;
+	int src = (word >> 3) & 0x07;
+	int isByteMode = (word >> 6) & 0x01;
+	int isLoad = opcode == 0x58 || opcode == 0x80;
+	int isRelative = opcode >= 0x80;
+	int isPre = (word >> 9) & 0x01;
+	int16_t step = isRelative ? 0 : (word & 0x0100) ? -(isByteMode ? 1 : 2) : (word & 0x0080) ? (isByteMode ? 1 : 2) : 0;
+	int16_t offset = isRelative ? (int16_t)(word << 2) >> 9 : 0;
+	uint16_t* addressRegister = set->registers[isLoad ? src : dst];
+
+	for (int slot = 0; slot < set->activeCount; slot++) {
+		uint8_t* laneMemory = set->laneMemory[slot];
+		uint16_t value = set->registers[src][slot]; // ST reads its value before any address update
+		uint16_t address = addressRegister[slot] + offset + (isPre ? step : 0);
+
+		if (address < DEVICE_PORT_COUNT) {
+			executeOneLane(set, slot, instruction);
+			continue;
+		}
+
+		if (!isLoad) {
+			MARK_STORED(set->storedMap, address);
+			MARK_STORED(set->storedMap, (uint16_t)(address + !isByteMode));
+		}
+
+		if (isPre && step) {
+			addressRegister[slot] = address;
+		}
+
+		if (isLoad) {
+			uint16_t* d = &set->registers[dst][slot];
+			*d = isByteMode ? (*d & 0xFF00) | laneMemory[address] : laneMemory[address] | (laneMemory[(uint16_t)(address + 1)] << 8);
+		}
+		else {
+			laneMemory[address] = value & 0xFF;
+			if (!isByteMode) {
+				laneMemory[(uint16_t)(address + 1)] = value >> 8;
+			}
+		}
+
+		if (!isPre && step) {
+			addressRegister[slot] = address + step;
+		}
+	}
+
+	if ((isLoad && dst == R_PC) || (step && addressRegister == set->registers[R_PC])) {
+		markInterruptReturns(set);
+	}
+}
+
+// branch condition for one lane, same tests as executeTOC
+static int laneBranchTaken(uint16_t opcode, uint16_t psw) {
+	int c = (psw & PSW_C) != 0, z = (psw & PSW_Z) != 0, n = (psw & PSW_N) != 0, v = (psw & PSW_V) != 0;
+
+	switch (opcode) {
+		case 0x20: return z;
+		case 0x24: return !z;
+		case 0x28: return c;
+		case 0x2C: return !c;
+		case 0x30: return n;
+		case 0x34: return n == v;
+		case 0x38: return n != v;
+		default:   return 1;
+	}
+}
+
+// moves each lane's PC for a branch, the PCs now in the lanes have already been advanced past it
+static void executeBranchLanes(LaneSet* set, uint16_t opcode, uint16_t word) {
+	uint16_t* pc = set->registers[R_PC];
+	int16_t offset;
+
+	if (opcode == 0x00) {
+		// BL, always taken
+		offset = (int16_t)(word << 3) >> 3;
+		for (int slot = 0; slot < set->activeCount; slot++) {
+			set->registers[R_LR][slot] = pc[slot];
+			pc[slot] += offset * 2;
+		}
+		return;
+	}
+
+	offset = (int16_t)(word << 6) >> 6;
+	for (int slot = 0; slot < set->activeCount; slot++) {
+		if (laneBranchTaken(opcode, set->psw[slot])) {
+			pc[slot] += offset * 2;
+		}
+	}
+}
+
+// keeps the larger group of lanes sharing a key and finishes the rest on the scalar engine
+static void keepLargestGroup(LaneSet* set, const uint16_t* keys, uint64_t clock, uint64_t instructions, uint64_t cycleLimit,
+	LaneResult* results) {
+	uint16_t leader = keys[0], other = keys[0];
+	int leaderCount = 0, otherCount = 0;
+
+	for (int slot = 0; slot < set->activeCount; slot++) {
+		if (keys[slot] == leader) {
+			leaderCount++;
+		}
+		else {
+			if (otherCount == 0) other = keys[slot];
+			if (keys[slot] == other) otherCount++;
+		}
+	}
+	if (leaderCount == set->activeCount) {
+		return;
+	}
+	if (otherCount > leaderCount) {
+		leader = other;
+	}
+
+	// backwards so the lane swapped into a freed slot has already been checked
+	for (int slot = set->activeCount - 1; slot >= 0; slot--) {
+		if (keys[slot] != leader) {
+			finishLaneScalar(set, slot, clock, instructions, cycleLimit, results);
+			removeLane(set, slot);
+			splitLanes++;
+		}
+	}
+}
+
+// after anything that could move a PC, keeps the larger group of lanes sharing a PC
+static void reconverge(LaneSet* set, uint64_t clock, uint64_t instructions, uint64_t cycleLimit, LaneResult* results) {
+	keepLargestGroup(set, set->registers[R_PC], clock, instructions, cycleLimit, results);
+}
+
+// lanes may have stored different values over the code at the shared PC, keeps the larger group fetching the same word
+static void reconvergeFetch(LaneSet* set, uint64_t clock, uint64_t instructions, uint64_t cycleLimit, LaneResult* results) {
+	uint16_t pc = set->registers[R_PC][0];
+
+	if (!WAS_STORED(set->storedMap, pc) && !WAS_STORED(set->storedMap, (uint16_t)(pc + 1))) {
+		return;
+	}
+	for (int slot = 0; slot < set->activeCount; slot++) {
+		uint8_t* code = set->laneMemory[slot];
+		set->fetched[slot] = code[pc] | (code[(uint16_t)(pc + 1)] << 8);
+	}
+	keepLargestGroup(set, set->fetched, clock, instructions, cycleLimit, results);
+}
+
+// hands the lanes whose instruction raised interrupt state, such as an interrupt return, to the scalar engine to service it
+static void splitPendingLanes(LaneSet* set, uint64_t clock, uint64_t instructions, uint64_t cycleLimit, LaneResult* results) {
+	for (int slot = set->activeCount - 1; slot >= 0; slot--) {
+		if (set->pending[slot]) {
+			finishLaneScalar(set, slot, clock, instructions, cycleLimit, results);
+			removeLane(set, slot);
+			splitLanes++;
+		}
+	}
+}
+
+// hands every remaining lane to the scalar engine
+static void splitAllLanes(LaneSet* set, uint64_t clock, uint64_t instructions, uint64_t cycleLimit, LaneResult* results) {
+	while (set->activeCount > 0) {
+		finishLaneScalar(set, set->activeCount - 1, clock, instructions, cycleLimit, results);
+		removeLane(set, set->activeCount - 1);
+		splitLanes++;
+	}
+}
+
+// runs the lanes in lockstep until they halt, reach the cycle limit or have all been split off
+static void runLanes(LaneSet* set, uint64_t cycleLimit, LaneResult* results) {
+	uint64_t clock = 0, instructions = 0;
+
+	while (set->activeCount > 0) {
+		// stop where the scalar engine would stop stepping
+		if (clock >= cycleLimit) {
+			for (int slot = set->activeCount - 1; slot >= 0; slot--) {
+				finishLaneInPlace(set, slot, CPU_RUNNING, instructions, results);
+				removeLane(set, slot);
+			}
+			return;
+		}
+
+		reconvergeFetch(set, clock, instructions, cycleLimit, results);
+
+		uint16_t pc = set->registers[R_PC][0];
+		uint8_t* code = set->laneMemory[0];
+		uint16_t word = code[pc] | (code[(uint16_t)(pc + 1)] << 8);
+		Instruction instruction;
+		int decoded = word != 0x0000 && decode(word, &instruction);
+
+		// PSW and system instructions can enter handlers, sleep or skip per lane, the scalar engine takes over before them
+		if (decoded && instruction.type == SYS) {
+			splitAllLanes(set, clock, instructions, cycleLimit, results);
+			return;
+		}
+
+		// fetch, every lane moves past the instruction word
+		clock += 1;
+		addToLanes(set->registers[R_PC], 2, paddedCount(set));
+
+		if (word == 0x0000) {
+			for (int slot = set->activeCount - 1; slot >= 0; slot--) {
+				finishLaneInPlace(set, slot, CPU_HALTED, instructions, results);
+				removeLane(set, slot);
+			}
+			return;
+		}
+
+		instructions++;
+		lockstepInstructions += set->activeCount;
+		clock += 1;
+
+		if (!decoded) {
+			continue;
+		}
+
+		// same opcode form the execute functions switch on, narrowed to a byte except for SO and REX
+		uint16_t opcode = instruction.type == SO || instruction.type == REX ? instruction.opcode : instruction.opcode >> 8;
+		int dst = word & 0x07;
+		int src = (word >> 3) & 0x07;
+		int isByteMode = instruction.wb == 1;
+		int count = paddedCount(set);
+		int handled = 0;
+		int writesPC = 0;	// a kernel wrote R7, where execute() would have checked for an interrupt return
+
+		switch (instruction.type) {
+			case AL:
+				handled = !isByteMode && executeALWord(set, opcode, dst, src, instruction.rc, count);
+				writesPC = dst == R_PC && opcode != 0x45 && opcode != 0x49;
+				break;
+			case SO:
+				handled = !isByteMode && executeSOWord(set, opcode, dst, count);
+				writesPC = dst == R_PC;
+				break;
+			case RIN:
+				executeRINLanes(set, opcode, dst, instruction.operands[1], count);
+				handled = 1;
+				writesPC = dst == R_PC;
+				break;
+			case REX:
+				if (!isByteMode) {
+					uint16_t* temporary = set->registers[dst];
+					if (opcode == 0x4C00) {
+						memcpy(set->registers[dst], set->registers[src], count * sizeof(uint16_t));
+					}
+					else {
+						set->registers[dst] = set->registers[src];
+						set->registers[src] = temporary;
+					}
+					handled = 1;
+					writesPC = dst == R_PC || (opcode != 0x4C00 && src == R_PC);
+				}
+				break;
+			case TOC:
+				executeBranchLanes(set, opcode, word);
+				handled = 1;
+				break;
+			case MEM:
+				executeMEMLanes(set, &instruction, opcode, word);
+				handled = 1;
+				break;
+			default:
+				break;
+		}
+
+		if (!handled) {
+			executePerLane(set, &instruction);
+		}
+
+		// memory access costs the same extra cycles as on the scalar engine
+		clock += instruction.type == MEM ? 4 : 1;
+
+		// per-lane and memory instructions can raise interrupt state as well as kernels writing R7
+		if (handled && writesPC) {
+			markInterruptReturns(set);
+		}
+		if (!handled || writesPC || instruction.type == MEM) {
+			splitPendingLanes(set, clock, instructions, cycleLimit, results);
+		}
+
+		// branches, and anything naming R7, may have sent lanes different ways
+		if (instruction.type == TOC || dst == R_PC || src == R_PC) {
+			reconverge(set, clock, instructions, cycleLimit, results);
+		}
+	}
+}
+
+// allocates a lane set for laneCount lanes, each with its own copy of the image and R0 = lane number
+static int createLaneSet(LaneSet* set, const LaneImage* image, int laneCount) {
+	int padded = (laneCount + LANE_BLOCK - 1) / LANE_BLOCK * LANE_BLOCK;
+
+	memset(set, 0, sizeof(LaneSet));
+	for (int r = 0; r < REGISTER_COUNT; r++) {
+		set->registers[r] = (uint16_t*)calloc(padded, sizeof(uint16_t));
+		if (set->registers[r] == NULL) return 0;
+	}
+	set->psw = (uint16_t*)calloc(padded, sizeof(uint16_t));
+	set->laneId = (int*)calloc(padded, sizeof(int));
+	set->laneMemory = (uint8_t**)calloc(padded, sizeof(uint8_t*));
+	set->pending = (uint32_t*)calloc(padded, sizeof(uint32_t));
+	set->fetched = (uint16_t*)calloc(padded, sizeof(uint16_t));
+	set->storedMap = (uint8_t*)calloc(MEMORY_SIZE / 8, 1);
+	if (set->psw == NULL || set->laneId == NULL || set->laneMemory == NULL ||
+		set->pending == NULL || set->fetched == NULL || set->storedMap == NULL) return 0;
+
+	for (int lane = 0; lane < laneCount; lane++) {
+		set->laneMemory[lane] = (uint8_t*)malloc(MEMORY_SIZE);
+		if (set->laneMemory[lane] == NULL) return 0;
+		memcpy(set->laneMemory[lane], image->memory, MEMORY_SIZE);
+
+		for (int r = 0; r < REGISTER_COUNT; r++) {
+			set->registers[r][lane] = image->registers[r];
+		}
+		set->registers[0][lane] = (uint16_t)lane;
+		set->psw[lane] = image->psw;
+		set->laneId[lane] = lane;
+		set->activeCount++;
+	}
+	return 1;
+}
+
+static void destroyLaneSet(LaneSet* set) {
+	for (int slot = 0; slot < set->activeCount; slot++) {
+		free(set->laneMemory[slot]);
+	}
+	for (int r = 0; r < REGISTER_COUNT; r++) {
+		free(set->registers[r]);
+	}
+	free(set->psw);
+	free(set->laneId);
+	free(set->laneMemory);
+	free(set->pending);
+	free(set->fetched);
+	free(set->storedMap);
+}
+
+// the reference: every lane run start to finish on its own by the scalar engine
+static void runScalarLanes(const LaneImage* image, int laneCount, uint64_t cycleLimit, LaneResult* results) {
+	for (int lane = 0; lane < laneCount; lane++) {
+		memcpy(memory, image->memory, MEMORY_SIZE);
+		memcpy(registerFile, image->registers, sizeof(registerFile));
+		registerFile[0] = (uint16_t)lane;
+		PSW = image->psw;
+		cpuClock = 0;
+		instructionCount = 0;
+		cexExecuteCount = 0;
+		cexSkipCount = 0;
+		interruptPending = 0;
+
+		results[lane].status = cpuRun(cycleLimit);
+		memcpy(results[lane].registers, registerFile, sizeof(registerFile));
+		results[lane].psw = PSW;
+		results[lane].instructions = instructionCount;
+		results[lane].memoryHash = hashBytes(memory, MEMORY_SIZE, 0);
+	}
+}
+
+static uint64_t totalInstructions(const LaneResult* results, int laneCount) {
+	uint64_t total = 0;
+	for (int lane = 0; lane < laneCount; lane++) {
+		total += results[lane].instructions;
+	}
+	return total;
+}
+
+int runLockstep(int laneCount, uint64_t cycleLimit) {
+	LaneImage image;
+	LaneSet set;
+	LaneResult* scalarResults;
+	LaneResult* lockstepResults;
+	int mismatches = 0;
+
+	if (laneCount <= 0) laneCount = LOCKSTEP_DEFAULT_LANES;
+	if (cycleLimit == 0) cycleLimit = LOCKSTEP_DEFAULT_CYCLES;
+
+	// the loaded program is the image every lane starts from
+	image.memory = (uint8_t*)malloc(MEMORY_SIZE);
+	scalarResults = (LaneResult*)calloc(laneCount, sizeof(LaneResult));
+	lockstepResults = (LaneResult*)calloc(laneCount, sizeof(LaneResult));
+	if (image.memory == NULL || scalarResults == NULL || lockstepResults == NULL) {
+		printf("Lockstep error: Out of memory\n");
+		free(image.memory);
+		free(scalarResults);
+		free(lockstepResults);
+		return 1;
+	}
+	memcpy(image.memory, memory, MEMORY_SIZE);
+	memcpy(image.registers, registerFile, sizeof(registerFile));
+	image.psw = PSW;
+
+	// lanes run headless with no devices, like the other batch modes
+	traceEnabled = 0;
+	initializeScheduler();
+
+#ifdef LOCKSTEP_AVX2
+	useAVX2 = hostHasAVX2();
+#endif
+	printf("Lockstep run: %d lanes, %llu cycles each, %s kernels\n\n", laneCount, (unsigned long long)cycleLimit,
+		useAVX2 ? "AVX2" : "portable");
+
+	clock_t start = clock();
+	runScalarLanes(&image, laneCount, cycleLimit, scalarResults);
+	double scalarSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	start = clock();
+	if (!createLaneSet(&set, &image, laneCount)) {
+		printf("Lockstep error: Out of memory for %d lanes\n", laneCount);
+		destroyLaneSet(&set);
+		free(image.memory);
+		free(scalarResults);
+		free(lockstepResults);
+		return 1;
+	}
+	lockstepInstructions = 0;
+	splitLanes = 0;
+	runLanes(&set, cycleLimit, lockstepResults);
+	double lockstepSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	destroyLaneSet(&set);
+
+	// every lane has to end exactly where its scalar run did, registers, flags and memory
+	for (int lane = 0; lane < laneCount; lane++) {
+		LaneResult* expected = &scalarResults[lane];
+		LaneResult* actual = &lockstepResults[lane];
+		if (memcmp(expected->registers, actual->registers, sizeof(expected->registers)) != 0 ||
+			expected->psw != actual->psw || expected->status != actual->status || expected->instructions != actual->instructions ||
+			expected->memoryHash != actual->memoryHash) {
+			if (mismatches++ < 5) {
+				printf("Lane %d differs: PC 0x%04X/0x%04X PSW 0x%04X/0x%04X R0 0x%04X/0x%04X instructions %llu/%llu%s\n", lane,
+					expected->registers[R_PC], actual->registers[R_PC], expected->psw, actual->psw,
+					expected->registers[0], actual->registers[0],
+					(unsigned long long)expected->instructions, (unsigned long long)actual->instructions,
+					expected->memoryHash != actual->memoryHash ? " memory" : "");
+			}
+		}
+	}
+
+	uint64_t instructions = totalInstructions(scalarResults, laneCount);
+	printf("%-10s %16s %10s %12s\n", "Engine", "Instructions", "Seconds", "M instr/s");
+	printf("----------------------------------------------------\n");
+	printf("%-10s %16llu %10.3f %12.2f\n", "Scalar", (unsigned long long)instructions, scalarSeconds,
+		scalarSeconds > 0 ? instructions / scalarSeconds / 1e6 : 0.0);
+	printf("%-10s %16llu %10.3f %12.2f\n", "Lockstep", (unsigned long long)totalInstructions(lockstepResults, laneCount),
+		lockstepSeconds, lockstepSeconds > 0 ? instructions / lockstepSeconds / 1e6 : 0.0);
+	printf("\nSpeedup %.2fx, %.1f%% of instructions ran in lockstep, %d lanes split off to the scalar engine\n",
+		lockstepSeconds > 0 ? scalarSeconds / lockstepSeconds : 0.0,
+		instructions ? 100.0 * lockstepInstructions / instructions : 0.0, splitLanes);
+	printf("%d of %d lanes differ from their scalar run\n", mismatches, laneCount);
+
+	free(image.memory);
+	free(scalarResults);
+	free(lockstepResults);
+	return mismatches ? 1 : 0;
+}
@@ -0,0 +1,15 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <stdint.h>
+
+#define LOCKSTEP_DEFAULT_LANES 1024
+#define LOCKSTEP_DEFAULT_CYCLES 1000000ULL	// cycle limit per lane
+
+// runs laneCount copies of the program already loaded into memory, lane n starting with R0 = n
+// first as independent scalar instances, then in lockstep with the register files held as structure-of-arrays
+// lanes whose branches diverge from the group, or that reach a PSW/system instruction, are finished by the scalar engine
+// prints throughput for both and checks every lane ended in the same state, returns 0/1 for match/mismatch
+int runLockstep(int laneCount, uint64_t cycleLimit);
+
+#endif // !LOCKSTEP_H
@@ -10,15 +10,107 @@ Changelog
 
 */
 
+#define _CRT_SECURE_NO_WARNINGS // to avoid errors on functions like sscanf
+
 #include "file_loader.h"
 #include "file_decoder.h"
 #include "memory.h"
 #include "cpu.h"
 #include "decode.h"
 #include "registers.h"
+#include "scheduler.h"
+#include "interrupts.h"
+#include "execute_al.h"
+#include "timer.h"
+#include "uart.h"
+#include "bench.h"
+#include "conformance.h"
+#include "fuzzer.h"
+#include "coverage.h"
+#include "lockstep.h"
+#include "timing.h"
+#include "pipeline.h"
+#include "cache.h"
+#include "branch_predictor.h"
+#include "job_server.h"
+#include "timeslice.h"
+#include "multicore.h"
+#include "console.h"
+#include "pacing.h"
+#include "memory_dump.h"
+#include "persist.h"
+#include "state_export.h"
+#include "state_hash.h"
+
+#include <stdlib.h>
+#include <string.h>
 
 int main(int argc, char* argv[]) {
 	FILE* file = NULL;
+	const char* uartInputFile = NULL;
+	int uartStdin = 0;
+	int fuzzLength = 0;
+	int lockstepLanes = 0;
+	int instanceCount = 0;
+	int coreCount = 0;
+	unsigned long long quantum = MULTICORE_DEFAULT_QUANTUM;
+	int pipelineMode = 0;
+	int predictMode = 0;
+	int consoleMode = 0;
+	unsigned int fuzzAddress = 0;
+	int threadCount = 0;
+	int seconds = 0;
+	unsigned long long cycleLimit = 0;
+	uint64_t targetHz = 0;
+	const char* coverageFile = NULL;
+	const char* listingFile = NULL;
+	const char* timingFile = NULL;
+	const char* exportName = NULL;
+	const char* persistFile = NULL;
+	const char* persistRanges = NULL;
+	const char* dumpFile = NULL;
+	const char* referenceFile = NULL;
+	int exitStatus = 0;
+	int detectLoops = 0;
+	int printHash = 0;
+	const char* instructionCacheConfig = NULL;
+	const char* dataCacheConfig = NULL;
+
+	// the decimal add table is read by every emulator thread, so it is filled before any of them start
+	initializeDecimalAdder();
+
+	// benchmarks run on built-in guest programs, no file needed
+	if (argc > 2 && strcmp(argv[1], "-bench") == 0) {
+		initializeMemory();
+		int result = runBenchmark(argv[2]);
+		cleanupMemory();
+		return result;
+	}
+
+	// conformance sweep checks every instruction word against the reference model, optional seed and thread counts
+	if (argc > 1 && strcmp(argv[1], "-conformance") == 0) {
+		int seeds = argc > 2 ? atoi(argv[2]) : CONFORMANCE_DEFAULT_SEEDS;
+		int threads = argc > 3 ? atoi(argv[3]) : 0;
+		return runConformanceSweep(seeds, threads) == 0 ? 0 : 1;
+	}
+
+	// job server keeps warm machines for jobs sent over a Unix domain socket, optional worker count
+	if (argc > 2 && strcmp(argv[1], "-serve") == 0) {
+		return runJobServer(argv[2], argc > 3 ? atoi(argv[3]) : 0);
+	}
+
+	// load generator submits jobs to a running server and reports latency, optional job, client and cycle counts
+	if (argc > 3 && strcmp(argv[1], "-loadgen") == 0) {
+		int jobs = argc > 4 ? atoi(argv[4]) : 1000;
+		int clients = argc > 5 ? atoi(argv[5]) : 4;
+		uint64_t cycles = argc > 6 ? strtoull(argv[6], NULL, 10) : 0;
+		return runLoadGenerator(argv[2], argv[3], jobs, clients, cycles);
+	}
+
+	// monitor reads another emulator's exported state, optional interval in milliseconds
+	if (argc > 2 && strcmp(argv[1], "-monitor") == 0) {
+		return runMonitor(argv[2], argc > 3 ? atoi(argv[3]) : 0);
+	}
 
 	// check if a file was provided to the program
 	if (argc > 1) {
@@ -26,33 +118,337 @@ int main(int argc, char* argv[]) {
 	}
 	else {
 		printf("No file provided!\n");
+		printf("Usage: %s <file.xme> [-uart-in <file>] [-uart-stdin]\n", argv[0]);
+		printf("       %s <file.xme> -ui [-uart-in <file>]\n", argv[0]);
+		printf("       %s <file.xme> -hz <rate, e.g. 1M or 16MHz> [-cycles <n>]\n", argv[0]);
+		printf("       %s <file.xme> [-cycles <n>] [-coverage <file.cov> [-listing <file.lst>]] [-timing <file.cfg>] [-predict]\n", argv[0]);
+		printf("       %s <file.xme> [-icache <size,line,ways[,lru|random][,penalty]>] [-dcache <...>]\n", argv[0]);
+		printf("       %s <file.xme> -lockstep <lanes> [-cycles <n>]\n", argv[0]);
+		printf("       %s <file.xme> -pipeline [-cycles <n>]\n", argv[0]);
+		printf("       %s <file.xme> -instances <n> [-threads <n>] [-seconds <n>]\n", argv[0]);
+		printf("       %s <file.xme> -cores <n> [-quantum <cycles>] [-cycles <n>]\n", argv[0]);
+		printf("       %s <file.xme> -fuzz <input addr (hex)> <input length> [-threads <n>] [-seconds <n>] [-cycles <n>]\n", argv[0]);
+		printf("       %s -bench <name>\n", argv[0]);
+		printf("       %s -conformance [seeds] [threads]\n", argv[0]);
+		printf("       %s <file.xme> -export <segment name> [any run options]\n", argv[0]);
+		printf("       %s <file.xme> -persist <file> [-persist-ranges <start-end,...> (hex)] [any run options]\n", argv[0]);
+		printf("       %s <file.xme> [-dump <file[.hex]>] [-diff <reference dump>] [any run options]\n", argv[0]);
+		printf("       %s <file.xme> -detect-loops [-cycles <n>] [-hash]\n", argv[0]);
+		printf("       %s -monitor <segment name> [interval ms]\n", argv[0]);
+		printf("       %s -serve <socket> [workers]\n", argv[0]);
+		printf("       %s -loadgen <socket> <file.xme> [jobs] [clients] [cycles]\n", argv[0]);
 		return 1;
 	}
 
+	// read optional arguments after the file name
+	for (int i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "-uart-in") == 0 && i + 1 < argc) {
+			uartInputFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "-uart-stdin") == 0) {
+			uartStdin = 1;
+		}
+		else if (strcmp(argv[i], "-fuzz") == 0 && i + 2 < argc) {
+			sscanf(argv[++i], "%x", &fuzzAddress);
+			fuzzLength = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-lockstep") == 0 && i + 1 < argc) {
+			lockstepLanes = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-instances") == 0 && i + 1 < argc) {
+			instanceCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-cores") == 0 && i + 1 < argc) {
+			coreCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-quantum") == 0 && i + 1 < argc) {
+			quantum = strtoull(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "-hz") == 0 && i + 1 < argc) {
+			targetHz = parseClockRate(argv[++i]);
+			if (targetHz == 0) {
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-export") == 0 && i + 1 < argc) {
+			exportName = argv[++i];
+		}
+		else if (strcmp(argv[i], "-persist") == 0 && i + 1 < argc) {
+			persistFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "-persist-ranges") == 0 && i + 1 < argc) {
+			persistRanges = argv[++i];
+		}
+		else if (strcmp(argv[i], "-dump") == 0 && i + 1 < argc) {
+			dumpFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "-diff") == 0 && i + 1 < argc) {
+			referenceFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "-detect-loops") == 0) {
+			detectLoops = 1;
+		}
+		else if (strcmp(argv[i], "-hash") == 0) {
+			printHash = 1;
+		}
+		else if (strcmp(argv[i], "-ui") == 0) {
+			consoleMode = 1;
+		}
+		else if (strcmp(argv[i], "-predict") == 0) {
+			predictMode = 1;
+		}
+		else if (strcmp(argv[i], "-pipeline") == 0) {
+			pipelineMode = 1;
+		}
+		else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+			threadCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-seconds") == 0 && i + 1 < argc) {
+			seconds = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-cycles") == 0 && i + 1 < argc) {
+			cycleLimit = strtoull(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "-coverage") == 0 && i + 1 < argc) {
+			coverageFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "-listing") == 0 && i + 1 < argc) {
+			listingFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "-timing") == 0 && i + 1 < argc) {
+			timingFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "-icache") == 0 && i + 1 < argc) {
+			instructionCacheConfig = argv[++i];
+		}
+		else if (strcmp(argv[i], "-dcache") == 0 && i + 1 < argc) {
+			dataCacheConfig = argv[++i];
+		}
+		else {
+			printf("Unknown option %s ignored\n", argv[i]);
+		}
+	}
+
 	// check if we were able to open file
 	if (file == NULL) {
 		printf("Unable to open file\n");
 		return 1;
 	}
 
+	// both take over guest memory's backing, only one of them can have it
+	if (persistFile != NULL && exportName != NULL) {
+		printf("-persist and -export can't be used together\n");
+		return 1;
+	}
+	// these run copies of the loaded image and never write back to the machine's memory
+	if (persistFile != NULL && (fuzzLength > 0 || lockstepLanes > 0 || instanceCount > 0)) {
+		printf("-persist can't be used with -fuzz, -lockstep or -instances\n");
+		return 1;
+	}
+
 	// initialize simulated memory
 	initializeMemory();
 
+	// carry memory over from the last run, the program is loaded over it below
+	if (persistFile != NULL && !startPersistence(persistFile, persistRanges)) {
+		return 1;
+	}
+
 	// initialize XM-23 register file
 	initializeRegisterFile();
 
+	// clear the device event queue and any interrupt requests
+	initializeScheduler();
+	initializeInterrupts();
+
+	// attach the memory-mapped timer and UART console and its input source
+	initializeTimer();
+	initializeUART();
+	if (uartInputFile != NULL && !uartLoadInputFile(uartInputFile)) {
+		return 1;
+	}
+	// the debugger and the threaded console read commands from stdin, so only a headless guest can have it
+	if (uartStdin && cycleLimit == 0 && targetHz == 0 && !detectLoops) {
+		printf("-uart-stdin needs a headless run (-cycles, -hz or -detect-loops), use -uart-in for guest input\n");
+		return 1;
+	}
+	uartUseStdin(uartStdin);
+
 	// decode the file and store raw instructions in memory
 	decodeFile(file);
 
-	// start fetch/decode/execute loop
-	cpuCycle();
+	// fuzz the loaded program headless instead of running it
+	if (fuzzLength > 0) {
+		int result = runFuzzer((uint16_t)fuzzAddress, fuzzLength, threadCount, seconds, cycleLimit);
+		cleanupUART();
+		cleanupMemory();
+		return result;
+	}
+
+	// run many copies of the loaded program side by side instead of running it once
+	if (lockstepLanes > 0) {
+		int result = runLockstep(lockstepLanes, cycleLimit);
+		cleanupUART();
+		cleanupMemory();
+		return result;
+	}
+
+	// time-slice many long-running copies of the loaded program over a worker pool
+	if (instanceCount > 0) {
+		int result = runTimeSliced(instanceCount, threadCount, seconds);
+		cleanupUART();
+		cleanupMemory();
+		return result;
+	}
+
+	// run several cores over the loaded program's memory
+	if (coreCount > 0) {
+		int result = runMulticore(coreCount, quantum, cycleLimit);
+		if (finishPersistence() != 0) {
+			result = 1;
+		}
+		uartFlush();
+		cleanupUART();
+		cleanupMemory();
+		return result;
+	}
+
+	// replay the run through a pipeline model instead of running it interactively
+	if (pipelineMode) {
+		int result = runPipeline(cycleLimit);
+		if (finishPersistence() != 0) {
+			result = 1;
+		}
+		uartFlush();
+		cleanupUART();
+		cleanupMemory();
+		return result;
+	}
+
+	// count cycles from a per-opcode cost table instead of the fixed costs
+	if (timingFile != NULL && !loadTimingModel(timingFile)) {
+		return 1;
+	}
+
+	// model instruction and data caches, misses add their penalty to cpuClock
+	if (instructionCacheConfig != NULL) {
+		CacheConfig config;
+		if (!parseCacheConfig(instructionCacheConfig, &config) || (instructionCache = createCache("I-cache", &config)) == NULL) {
+			return 1;
+		}
+	}
+	if (dataCacheConfig != NULL) {
+		CacheConfig config;
+		if (!parseCacheConfig(dataCacheConfig, &config) || (dataCache = createCache("D-cache", &config)) == NULL) {
+			return 1;
+		}
+	}
+
+	// run the candidate branch predictors, also needed to charge a timing model's misprediction penalty
+	if ((predictMode || (timingModel != NULL && timingModel->mispredictPenalty > 0)) && !startBranchPredictors()) {
+		return 1;
+	}
 
-	// free memory when done
+	// back guest memory with a shared segment and publish registers alongside it for monitoring tools
+	if (exportName != NULL && !startExport(exportName)) {
+		return 1;
+	}
+
+	// collect executed addresses and branch outcomes for this run
+	if (coverageFile != NULL && !startCoverage()) {
+		return 1;
+	}
+
+	// start fetch/decode/execute loop, headless up to a cycle limit if one was given, paced to a clock rate if given,
+	// or stopping once the program repeats itself exactly
+	if (cycleLimit > 0 || targetHz > 0 || detectLoops) {
+		uint64_t period = 0;
+		int status;
+
+		traceEnabled = 0;
+		if (targetHz > 0) {
+			status = runPaced(cycleLimit ? cycleLimit : UINT64_MAX, targetHz);
+		}
+		else if (detectLoops) {
+			status = cpuRunDetectingLoops(cycleLimit ? cycleLimit : UINT64_MAX, LOOP_CHECK_CYCLES, &period);
+		}
+		else {
+			status = cpuRun(cycleLimit);
+		}
+		printf("%s after %llu cycles, %llu instructions\n",
+			status == CPU_HALTED ? "Halted" : status == CPU_ASLEEP ? "Asleep" : status == CPU_LOOPING ? "Looping" : "Cycle limit reached",
+			(unsigned long long)cpuClock, (unsigned long long)instructionCount);
+		if (status == CPU_LOOPING) {
+			printf("State repeated after %llu cycles, PC 0x%04X\n", (unsigned long long)period, registerFile[R_PC]);
+		}
+	}
+	else if (consoleMode) {
+		runConsole();
+	}
+	else {
+		cpuCycle();
+	}
+
+	// report predictor accuracy
+	finishBranchPredictors(predictMode);
+
+	// report cache hit rates
+	if (instructionCache != NULL) {
+		finishCache(instructionCache);
+		instructionCache = NULL;
+	}
+	if (dataCache != NULL) {
+		finishCache(dataCache);
+		dataCache = NULL;
+	}
+
+	// merge this run into the coverage file, failing to write it fails the run
+	if (coverageFile != NULL && finishCoverage(coverageFile, listingFile) != 0) {
+		exitStatus = 1;
+	}
+
+	// final state hash for comparing runs
+	if (printHash) {
+		printf("State hash %016llX\n", (unsigned long long)hashMachineState());
+	}
+
+	// write out the final memory, and compare it with a reference run's, a difference fails the run
+	if (dumpFile != NULL && !dumpMemory(memory, dumpFile, 0, MEMORY_SIZE)) {
+		printf("Dump error: Unable to write %s\n", dumpFile);
+		exitStatus = 1;
+	}
+	if (referenceFile != NULL) {
+		uint8_t* reference = (uint8_t*)calloc(MEMORY_SIZE, sizeof(uint8_t));
+		int32_t length = reference != NULL ? loadMemoryDump(reference, referenceFile, 0) : -1;
+		if (length < 0) {
+			printf("Dump error: Unable to read %s\n", referenceFile);
+			exitStatus = 1;
+		}
+		else if (printMemoryDiff(reference, memory, 0, (uint32_t)length) > 0) {
+			exitStatus = 1;
+		}
+		free(reference);
+	}
+
+	// detach from the shared segment, monitors see the final state
+	finishExport();
+
+	// flush persistent memory to its file, failing to write it back fails the run
+	if (finishPersistence() != 0) {
+		exitStatus = 1;
+	}
+
+	// write out any remaining guest output and free memory when done
+	uartFlush();
+	cleanupUART();
 	cleanupMemory();
+	unloadTimingModel();
 
-	// hold program until user decides to exit
-	printf("Press any key to exit...\n");
-	getchar();
+	// hold program until user decides to exit, headless runs just exit
+	if (cycleLimit == 0 && targetHz == 0 && !detectLoops && !consoleMode) {
+		printf("Press any key to exit...\n");
+		getchar();
+	}
 
-	return 0;
+	return exitStatus;
 }
\ No newline at end of file
@@ -1,8 +1,13 @@
 #include "memory.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
-uint8_t* memory = NULL;
+THREAD_LOCAL uint8_t* memory = NULL;
+THREAD_LOCAL uint8_t* dirtyPages = NULL;
+
+// memory points at storage someone else owns and releases
+static THREAD_LOCAL int memoryIsBacked = 0;
 
 void initializeMemory() {
 	memory = (uint8_t*)calloc(MEMORY_SIZE, sizeof(uint8_t));
@@ -12,11 +17,31 @@ void initializeMemory() {
 	}
 }
 
+void useMemoryBacking(uint8_t* backing) {
+	if (!memoryIsBacked) {
+		free(memory);
+	}
+	memory = backing;
+	memoryIsBacked = 1;
+}
+
+void releaseMemoryBacking() {
+	uint8_t* backing = memory;
+
+	if (!memoryIsBacked) {
+		return;
+	}
+	memoryIsBacked = 0;
+	initializeMemory();
+	memcpy(memory, backing, MEMORY_SIZE);
+}
+
 void cleanupMemory() {
-	if (memory != NULL) {
+	if (memory != NULL && !memoryIsBacked) {
 		free(memory);
-		memory = NULL;
 	}
+	memory = NULL;
+	memoryIsBacked = 0;
 }
 
 uint8_t readMemory(uint16_t address) {
@@ -64,6 +89,11 @@ void writeMemory(uint16_t address, uint8_t value) {
 	}
 	// write value to memory
 	memory[address] = value;
+
+	// track the page for snapshot restores
+	if (dirtyPages != NULL) {
+		dirtyPages[address >> MEMORY_PAGE_SHIFT] = 1;
+	}
 }
 
 void writeArrayToMemory(uint16_t startAddress, uint8_t *data, int dataLength) {
@@ -2,15 +2,30 @@
 #define MEMORY_H
 
 #include <stdint.h>
+#include "tls.h"
 
 #define MEMORY_SIZE 65536 // 64kB memory
 #define MAX_MEMORY_PRINT 48 // define max memory addresses to print at a time (keeping small to not overwhelm the console)
 
-extern uint8_t *memory;
+#define MEMORY_PAGE_SHIFT 8 // 256 byte pages for write tracking
+#define MEMORY_PAGE_COUNT (MEMORY_SIZE >> MEMORY_PAGE_SHIFT)
+
+extern THREAD_LOCAL uint8_t *memory;
+
+// when not NULL, writeMemory flags the page of every write here so a snapshot can be restored page by page
+extern THREAD_LOCAL uint8_t* dirtyPages;
 
 // initializes simulated memory for the XM-23 program
 void initializeMemory();
 
+// replaces the allocation with MEMORY_SIZE bytes of storage the caller owns, such as a mapped segment
+// its contents are used as they are, and cleanupMemory() leaves releasing it to the caller
+void useMemoryBacking(uint8_t* backing);
+
+// copies the backing's contents into a fresh allocation and switches to it, so the caller can release the backing
+// while guest memory stays readable for the rest of shutdown, does nothing when memory isn't backed
+void releaseMemoryBacking();
+
 // frees the simulated memory
 void cleanupMemory();
 
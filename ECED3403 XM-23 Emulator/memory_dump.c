@@ -0,0 +1,197 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "memory_dump.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DIFF_SSE2
+#endif
+
+// true for file names that should get a hex listing rather than raw bytes
+static int isHexName(const char* path) {
+	const char* extension = strrchr(path, '.');
+	return extension != NULL && (strcmp(extension, ".hex") == 0 || strcmp(extension, ".txt") == 0 ||
+		strcmp(extension, ".HEX") == 0 || strcmp(extension, ".TXT") == 0);
+}
+
+int dumpMemory(const uint8_t* image, const char* path, uint16_t address, uint32_t length) {
+	static const char digits[] = "0123456789ABCDEF";
+	uint8_t* buffer;
+	size_t size = 0;
+
+	if (length > MEMORY_SIZE) {
+		length = MEMORY_SIZE;
+	}
+
+	// the whole dump is built first so it goes out in one write
+	if (isHexName(path)) {
+		buffer = (uint8_t*)malloc((length / DUMP_HEX_LINE + 1) * (6 + 3 * DUMP_HEX_LINE + 1));
+		if (buffer == NULL) {
+			return 0;
+		}
+		for (uint32_t i = 0; i < length; i++) {
+			uint16_t at = (uint16_t)(address + i);
+			if (i % DUMP_HEX_LINE == 0) {
+				size += sprintf((char*)buffer + size, "%s%04X:", i == 0 ? "" : "\n", at);
+			}
+			buffer[size++] = ' ';
+			buffer[size++] = digits[image[at] >> 4];
+			buffer[size++] = digits[image[at] & 0x0F];
+		}
+		buffer[size++] = '\n';
+	}
+	else {
+		buffer = (uint8_t*)malloc(length);
+		if (buffer == NULL) {
+			return 0;
+		}
+		size = (uint32_t)(MEMORY_SIZE - address) < length ? (uint32_t)(MEMORY_SIZE - address) : length;
+		memcpy(buffer, image + address, size);
+		memcpy(buffer + size, image, length - size);
+		size = length;
+	}
+
+	FILE* file = fopen(path, "wb");
+	int written = file != NULL && fwrite(buffer, 1, size, file) == size;
+	if (file != NULL && fclose(file) != 0) {
+		written = 0;
+	}
+	free(buffer);
+	return written;
+}
+
+// reads the bytes of "AAAA: xx xx ..." lines in file order, the line addresses are skipped over like the raw
+// format has none, returns -1 for a line that isn't in that form
+static int32_t loadHexDump(uint8_t* image, FILE* file, uint16_t address) {
+	char line[16 + 3 * DUMP_HEX_LINE];
+	uint32_t length = 0;
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		const char* text = line;
+		unsigned int value;
+		int used = 0;
+
+		if (strspn(line, " \r\n") == strlen(line)) {
+			continue;
+		}
+		if (sscanf(text, "%4x:%n", &value, &used) != 1 || used == 0) {
+			return -1;
+		}
+		text += used;
+		while (sscanf(text, " %2x%n", &value, &used) == 1) {
+			if (length < (uint32_t)(MEMORY_SIZE - address)) {
+				image[address + length++] = (uint8_t)value;
+			}
+			text += used;
+		}
+		if (text[strspn(text, " \r\n")] != '\0') {
+			return -1;
+		}
+	}
+	return (int32_t)length;
+}
+
+int32_t loadMemoryDump(uint8_t* image, const char* path, uint16_t address) {
+	FILE* file = fopen(path, "rb");
+	int32_t length;
+
+	if (file == NULL) {
+		return -1;
+	}
+	if (isHexName(path)) {
+		length = loadHexDump(image, file, address);
+	}
+	else {
+		length = (int32_t)fread(image + address, 1, MEMORY_SIZE - address, file);
+	}
+	fclose(file);
+	return length;
+}
+
+// returns the first offset from i where the images differ, or length
+static uint32_t skipMatching(const uint8_t* before, const uint8_t* after, uint32_t i, uint32_t length) {
+#ifdef DIFF_SSE2
+	while (i + 16 <= length) {
+		__m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(before + i)), _mm_loadu_si128((const __m128i*)(after + i)));
+		if (_mm_movemask_epi8(equal) != 0xFFFF) {
+			break;
+		}
+		i += 16;
+	}
+#endif
+	while (i + 8 <= length) {
+		uint64_t a, b;
+		memcpy(&a, before + i, sizeof(a));
+		memcpy(&b, after + i, sizeof(b));
+		if (a != b) {
+			break;
+		}
+		i += 8;
+	}
+	while (i < length && before[i] == after[i]) {
+		i++;
+	}
+	return i;
+}
+
+int diffMemory(const uint8_t* before, const uint8_t* after, uint16_t address, uint32_t length, MemoryRange* ranges, int maxRanges) {
+	int count = 0;
+	uint32_t i = 0;
+
+	if (length > (uint32_t)(MEMORY_SIZE - address)) {
+		length = (uint32_t)(MEMORY_SIZE - address);
+	}
+	before += address;
+	after += address;
+
+	// changes are usually a few scattered bytes, so only the changed runs are walked a byte at a time
+	while ((i = skipMatching(before, after, i, length)) < length) {
+		uint32_t start = i;
+		while (i < length && before[i] != after[i]) {
+			i++;
+		}
+		if (count < maxRanges) {
+			ranges[count].start = (uint16_t)(address + start);
+			ranges[count].length = i - start;
+		}
+		count++;
+	}
+	return count;
+}
+
+int printMemoryDiff(const uint8_t* before, const uint8_t* after, uint16_t address, uint32_t length) {
+	MemoryRange ranges[DIFF_PRINT_RANGES];
+	int count = diffMemory(before, after, address, length, ranges, DIFF_PRINT_RANGES);
+	uint32_t changed = 0;
+
+	if (count == 0) {
+		printf("No differences\n");
+		return 0;
+	}
+
+	for (int i = 0; i < count && i < DIFF_PRINT_RANGES; i++) {
+		printf("0x%04X-0x%04X  %5u bytes", ranges[i].start, ranges[i].start + ranges[i].length - 1, ranges[i].length);
+		if (ranges[i].length <= DIFF_PRINT_BYTES) {
+			printf("  ");
+			for (uint32_t j = 0; j < ranges[i].length; j++) {
+				printf("%02X", before[ranges[i].start + j]);
+			}
+			printf(" -> ");
+			for (uint32_t j = 0; j < ranges[i].length; j++) {
+				printf("%02X", after[ranges[i].start + j]);
+			}
+		}
+		printf("\n");
+		changed += ranges[i].length;
+	}
+	if (count > DIFF_PRINT_RANGES) {
+		printf("... and %d more ranges\n", count - DIFF_PRINT_RANGES);
+	}
+	else {
+		printf("%d ranges, %u bytes changed\n", count, changed);
+	}
+	return count;
+}
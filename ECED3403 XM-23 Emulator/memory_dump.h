@@ -0,0 +1,34 @@
+#ifndef MEMORY_DUMP_H
+#define MEMORY_DUMP_H
+
+#include <stdint.h>
+#include "memory.h"
+
+#define DUMP_HEX_LINE 16			// bytes per line of a hex dump
+#define DIFF_PRINT_RANGES 32		// changed ranges listed before the rest are only counted
+#define DIFF_PRINT_BYTES 8			// ranges up to this long also show their old and new bytes
+
+// a run of addresses, length may be MEMORY_SIZE so it is wider than an address
+typedef struct {
+	uint16_t start;
+	uint32_t length;
+} MemoryRange;
+
+// writes length bytes of image starting at address to path in a single write, wrapping at the end of memory
+// files named .hex or .txt get "AAAA: xx xx ..." lines, anything else gets the raw bytes
+// returns 0 if the file couldn't be written
+int dumpMemory(const uint8_t* image, const char* path, uint16_t address, uint32_t length);
+
+// reads up to MEMORY_SIZE - address bytes of a dump into image at address, as written by dumpMemory, raw bytes
+// or hex lines by the same file names, returns the number of bytes read, or -1 if the file couldn't be opened
+// or a hex line is malformed
+int32_t loadMemoryDump(uint8_t* image, const char* path, uint16_t address);
+
+// compares length bytes of two images from address, matching stretches are skipped a vector at a time
+// fills up to maxRanges ranges of changed bytes and returns how many there are in all
+int diffMemory(const uint8_t* before, const uint8_t* after, uint16_t address, uint32_t length, MemoryRange* ranges, int maxRanges);
+
+// diffs two images and prints the changed ranges, returns the number of ranges
+int printMemoryDiff(const uint8_t* before, const uint8_t* after, uint16_t address, uint32_t length);
+
+#endif // !MEMORY_DUMP_H
@@ -0,0 +1,214 @@
+#include "multicore.h"
+#include "cpu.h"
+#include "memory.h"
+#include "platform.h"
+#include "registers.h"
+#include "scheduler.h"
+#include "tas.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// keeps the cores within one quantum of each other, cores that stop running leave it
+typedef struct {
+	HostMutex mutex;
+	HostCondition released;
+	int participants;
+	int arrived;
+	uint32_t generation;
+} QuantumBarrier;
+
+// shared by all cores
+typedef struct {
+	uint8_t* memory;
+	uint16_t registers[REGISTER_COUNT];
+	uint16_t psw;
+	int coreCount;
+	uint64_t quantum;
+	uint64_t cycleLimit;
+	QuantumBarrier barrier;
+} MulticoreSystem;
+
+typedef struct {
+	MulticoreSystem* system;
+	int index;
+
+	// results, written by the core before it finishes
+	int status;
+	uint64_t instructions;
+	uint64_t cycles;
+	uint64_t wallNanoseconds;
+	uint64_t waitNanoseconds;
+} Core;
+
+static void barrierArrive(QuantumBarrier* barrier) {
+	hostMutexLock(&barrier->mutex);
+	if (++barrier->arrived == barrier->participants) {
+		barrier->arrived = 0;
+		barrier->generation++;
+		hostConditionBroadcast(&barrier->released);
+	}
+	else {
+		uint32_t generation = barrier->generation;
+		while (generation == barrier->generation) {
+			hostConditionWait(&barrier->released, &barrier->mutex);
+		}
+	}
+	hostMutexUnlock(&barrier->mutex);
+}
+
+// a core that halted or can't wake stops holding the others back
+static void barrierLeave(QuantumBarrier* barrier) {
+	hostMutexLock(&barrier->mutex);
+	barrier->participants--;
+	if (barrier->arrived > 0 && barrier->arrived == barrier->participants) {
+		barrier->arrived = 0;
+		barrier->generation++;
+		hostConditionBroadcast(&barrier->released);
+	}
+	hostMutexUnlock(&barrier->mutex);
+}
+
+// runs a core on the calling thread, whose cpu state is already set up
+static void runCore(Core* core) {
+	MulticoreSystem* system = core->system;
+	uint64_t start = hostTimeNanoseconds();
+	uint64_t epoch = 0;
+	int status = CPU_RUNNING;
+
+	while (status == CPU_RUNNING && cpuClock < system->cycleLimit) {
+		uint64_t target = system->cycleLimit;
+
+		if (system->quantum > 0 && (epoch + 1) * system->quantum < target) {
+			target = ++epoch * system->quantum;
+		}
+		status = cpuRun(target);
+
+		if (status == CPU_RUNNING && system->quantum > 0) {
+			uint64_t waitStart = hostTimeNanoseconds();
+			barrierArrive(&system->barrier);
+			core->waitNanoseconds += hostTimeNanoseconds() - waitStart;
+		}
+	}
+	if (system->quantum > 0) {
+		barrierLeave(&system->barrier);
+	}
+
+	core->status = status;
+	core->instructions = instructionCount;
+	core->cycles = cpuClock;
+	core->wallNanoseconds = hostTimeNanoseconds() - start;
+}
+
+// thread for cores 1 and up, this thread's cpu state starts out empty
+static void secondaryCore(void* argument) {
+	Core* core = (Core*)argument;
+	MulticoreSystem* system = core->system;
+
+	memory = system->memory;
+	memcpy(registerFile, system->registers, sizeof(registerFile));
+	PSW = system->psw;
+	cpuClock = 0;
+	instructionCount = 0;
+	traceEnabled = 0;
+	initializeScheduler();
+	attachTestAndSet(core->index, system->coreCount);
+
+	runCore(core);
+}
+
+static const char* statusName(int status) {
+	switch (status) {
+	case CPU_HALTED: return "halted";
+	case CPU_ASLEEP: return "asleep";
+	case CPU_FAULTED: return "faulted";
+	default: return "limit";
+	}
+}
+
+static void printReport(Core* cores, int coreCount, uint64_t wallNanoseconds, const MulticoreSystem* system) {
+	uint64_t totalInstructions = 0;
+	uint32_t acquired, contended;
+
+	printf("\n%d cores, quantum %llu cycles, limit %llu cycles per core\n\n", coreCount,
+		(unsigned long long)system->quantum, (unsigned long long)system->cycleLimit);
+	printf(" Core   Status   Instructions         Cycles   Wall s   Waiting   M instr/s\n");
+	printf("----------------------------------------------------------------------------\n");
+
+	for (int i = 0; i < coreCount; i++) {
+		Core* core = &cores[i];
+		double seconds = core->wallNanoseconds / 1e9;
+
+		totalInstructions += core->instructions;
+		printf("%5d %8s %14llu %14llu %8.2f %8.1f%% %11.2f\n", i, statusName(core->status),
+			(unsigned long long)core->instructions, (unsigned long long)core->cycles, seconds,
+			core->wallNanoseconds ? 100.0 * core->waitNanoseconds / core->wallNanoseconds : 0.0,
+			seconds > 0 ? core->instructions / seconds / 1e6 : 0.0);
+	}
+
+	double seconds = wallNanoseconds / 1e9;
+	double aggregate = seconds > 0 ? totalInstructions / seconds / 1e6 : 0.0;
+	// core 0's rate while it wasn't waiting on the others stands in for what a single core manages alone
+	uint64_t busyNanoseconds = cores[0].wallNanoseconds - cores[0].waitNanoseconds;
+	double singleCore = busyNanoseconds ? cores[0].instructions / (busyNanoseconds / 1e9) / 1e6 : 0.0;
+
+	testAndSetCounts(&acquired, &contended);
+	printf("\nAggregate: %llu instructions in %.2f s, %.2f M instr/s (%.2fx one busy core, %d host processor%s)\n",
+		(unsigned long long)totalInstructions, seconds, aggregate, singleCore > 0 ? aggregate / singleCore : 0.0,
+		hostProcessorCount(), hostProcessorCount() == 1 ? "" : "s");
+	printf("Locks: %u acquired, %u contended reads\n\n", acquired, contended);
+}
+
+int runMulticore(int coreCount, uint64_t quantum, uint64_t cycleLimit) {
+	static MulticoreSystem system;
+	static Core cores[MULTICORE_MAX_CORES];
+	HostThread threads[MULTICORE_MAX_CORES];
+	int started[MULTICORE_MAX_CORES] = { 0 };
+
+	if (coreCount > MULTICORE_MAX_CORES) {
+		printf("Multicore warning: %d cores requested, running %d\n", coreCount, MULTICORE_MAX_CORES);
+		coreCount = MULTICORE_MAX_CORES;
+	}
+
+	system.memory = memory;
+	memcpy(system.registers, registerFile, sizeof(system.registers));
+	system.psw = PSW;
+	system.coreCount = coreCount;
+	system.quantum = quantum;
+	system.cycleLimit = cycleLimit ? cycleLimit : MULTICORE_DEFAULT_CYCLES;
+	system.barrier.participants = coreCount;
+	hostMutexInit(&system.barrier.mutex);
+	hostConditionInit(&system.barrier.released);
+
+	initializeTestAndSet();
+	attachTestAndSet(0, coreCount);
+	traceEnabled = 0;
+
+	uint64_t start = hostTimeNanoseconds();
+	for (int i = 0; i < coreCount; i++) {
+		cores[i].system = &system;
+		cores[i].index = i;
+	}
+	for (int i = 1; i < coreCount; i++) {
+		started[i] = hostThreadCreate(&threads[i], secondaryCore, &cores[i]);
+		if (!started[i]) {
+			printf("Multicore error: Unable to start core %d, it won't run\n", i);
+			if (quantum > 0) {
+				barrierLeave(&system.barrier);
+			}
+		}
+	}
+
+	runCore(&cores[0]);
+	for (int i = 1; i < coreCount; i++) {
+		if (started[i]) {
+			hostThreadJoin(threads[i]);
+		}
+	}
+
+	printReport(cores, coreCount, hostTimeNanoseconds() - start, &system);
+
+	hostMutexDestroy(&system.barrier.mutex);
+	hostConditionDestroy(&system.barrier.released);
+	return 0;
+}
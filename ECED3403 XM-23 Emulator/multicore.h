@@ -0,0 +1,17 @@
+#ifndef MULTICORE_H
+#define MULTICORE_H
+
+#include <stdint.h>
+
+#define MULTICORE_MAX_CORES 16
+#define MULTICORE_DEFAULT_QUANTUM 10000ULL		// cycles a core runs before waiting for the others
+#define MULTICORE_DEFAULT_CYCLES 100000000ULL	// cycle limit per core when none is given
+
+// runs coreCount cores on the program already loaded into memory, all sharing that memory through bus()
+// core 0 runs on this thread and keeps its timer and UART, the others each get a host thread of their own
+// every core starts with the loaded registers and finds its index in the core id port (see tas.h)
+// with a quantum, no core runs more than quantum cycles ahead of the slowest, 0 lets them run free
+// prints per-core and aggregate throughput, returns 0
+int runMulticore(int coreCount, uint64_t quantum, uint64_t cycleLimit);
+
+#endif // !MULTICORE_H
@@ -0,0 +1,106 @@
+#include "pacing.h"
+#include "cpu.h"
+#include "platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+uint64_t parseClockRate(const char* text) {
+	char* end;
+	double rate = strtod(text, &end);
+
+	switch (*end) {
+	case 'k': case 'K': rate *= 1e3; end++; break;
+	case 'm': case 'M': rate *= 1e6; end++; break;
+	case 'g': case 'G': rate *= 1e9; end++; break;
+	}
+	if (end[0] == 'H' || end[0] == 'h') {
+		end += (end[1] == 'z' || end[1] == 'Z') ? 2 : 1;
+	}
+	if (end == text || *end != '\0' || rate < 1) {
+		printf("Pacing error: %s is not a clock rate\n", text);
+		return 0;
+	}
+	return (uint64_t)rate;
+}
+
+// wall time at which the guest should reach cycle, from the schedule's starting point
+static uint64_t scheduledTime(uint64_t baseTime, uint64_t baseCycle, uint64_t cycle, uint64_t targetHz) {
+	uint64_t cycles = cycle - baseCycle;
+
+	// split to keep cycles * 1e9 from overflowing on long runs
+	return baseTime + (cycles / targetHz) * 1000000000ULL + (cycles % targetHz) * 1000000000ULL / targetHz;
+}
+
+int runPaced(uint64_t cycleLimit, uint64_t targetHz) {
+	uint64_t batchCycles = targetHz * PACING_BATCH_NS / 1000000000ULL;
+	uint64_t startTime = hostTimeNanoseconds();
+	uint64_t startCycle = cpuClock;
+	uint64_t baseTime = startTime, baseCycle = startCycle;
+	uint64_t reportTime = startTime, reportCycle = startCycle;
+	uint64_t busyTime = 0, lateTotal = 0, lateMax = 0, batches = 0, overruns = 0, resyncs = 0, dropped = 0;
+	int status = CPU_RUNNING;
+
+	if (batchCycles == 0) {
+		batchCycles = 1;
+	}
+
+	printf("Pacing to %.6g MHz in batches of %llu cycles\n", targetHz / 1e6, (unsigned long long)batchCycles);
+
+	while (status == CPU_RUNNING && cpuClock < cycleLimit) {
+		uint64_t batchStart = hostTimeNanoseconds();
+		uint64_t batchEnd = cpuClock + batchCycles < cycleLimit ? cpuClock + batchCycles : cycleLimit;
+
+		status = cpuRun(batchEnd);
+
+		uint64_t now = hostTimeNanoseconds();
+		uint64_t due = scheduledTime(baseTime, baseCycle, cpuClock, targetHz);
+		busyTime += now - batchStart;
+		batches++;
+
+		if (now < due) {
+			hostSleepUntil(due);
+			uint64_t late = hostTimeNanoseconds() - due;
+			lateTotal += late;
+			if (late > lateMax) lateMax = late;
+		}
+		else if (now - due > PACING_RESYNC_NS) {
+			// blocked on input or the host can't keep up, start over from here rather than run flat out to catch up
+			dropped += now - due;
+			baseTime = now;
+			baseCycle = cpuClock;
+			resyncs++;
+		}
+		else {
+			overruns++;
+		}
+
+		now = hostTimeNanoseconds();
+		if (now - reportTime >= PACING_REPORT_NS) {
+			double seconds = (now - reportTime) / 1e9;
+			int64_t drift = (int64_t)(now - scheduledTime(baseTime, baseCycle, cpuClock, targetHz));
+
+			printf("  %8.3f MHz achieved, drift %+8.3f ms\n", (cpuClock - reportCycle) / seconds / 1e6, drift / 1e6);
+			reportTime = now;
+			reportCycle = cpuClock;
+		}
+	}
+
+	uint64_t elapsed = hostTimeNanoseconds() - startTime;
+	int64_t drift = (int64_t)(hostTimeNanoseconds() - scheduledTime(baseTime, baseCycle, cpuClock, targetHz));
+	double seconds = elapsed / 1e9;
+	uint64_t slept = batches - overruns - resyncs;
+
+	printf("\nPaced run: %llu cycles in %.3f s\n", (unsigned long long)(cpuClock - startCycle), seconds);
+	printf("  Target rate     : %.6g MHz\n", targetHz / 1e6);
+	printf("  Achieved rate   : %.6g MHz\n", seconds > 0 ? (cpuClock - startCycle) / seconds / 1e6 : 0.0);
+	printf("  Final drift     : %+.3f ms (wall time past the schedule)\n", drift / 1e6);
+	printf("  Wake lateness   : mean %.1f us, max %.1f us over %llu sleeps\n",
+		slept ? lateTotal / 1e3 / slept : 0.0, lateMax / 1e3, (unsigned long long)slept);
+	printf("  Batches late    : %llu of %llu, %llu schedule restarts dropping %.3f ms\n",
+		(unsigned long long)overruns, (unsigned long long)batches, (unsigned long long)resyncs, dropped / 1e6);
+	printf("  Host busy       : %.1f%%\n", elapsed ? 100.0 * busyTime / elapsed : 0.0);
+
+	return status;
+}
@@ -0,0 +1,18 @@
+#ifndef PACING_H
+#define PACING_H
+
+#include <stdint.h>
+
+#define PACING_BATCH_NS 1000000ULL		// wall time each batch of guest cycles is aligned to, 1 ms
+#define PACING_RESYNC_NS 100000000ULL	// falling further behind than this restarts the schedule instead of catching up
+#define PACING_REPORT_NS 1000000000ULL	// time between progress lines
+
+// parses a guest clock rate such as 1000000, 1M, 16MHz or 32.768k, returns 0 if it isn't one
+uint64_t parseClockRate(const char* text);
+
+// runs headless like cpuRun, but keeps cpuClock in step with wall time at targetHz
+// runs a batch of cycles then sleeps to the absolute time that batch should end, so sleep overshoot doesn't
+// accumulate, prints achieved rate and drift each second and a summary at the end, returns the last cpu status
+int runPaced(uint64_t cycleLimit, uint64_t targetHz);
+
+#endif // !PACING_H
@@ -0,0 +1,174 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "persist.h"
+#include "platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+	uint32_t start;
+	uint32_t end;	// exclusive
+} PersistRange;
+
+static HostMapping persistMapping;
+static uint8_t* persistBacking = NULL;
+static PersistRange persistRanges[PERSIST_MAX_RANGES];
+static int persistRangeCount = 0;
+static int persistCopying = 0;		// 1 when the ranges are read in and written back rather than mapped
+static const char* persistPath = NULL;
+
+// reads "start-end[,start-end...]" into persistRanges widened to host pages, returns 0 on a malformed list
+static int parseRanges(const char* text, size_t pageSize) {
+	const char* cursor = text;
+
+	persistRangeCount = 0;
+	while (*cursor != '\0') {
+		unsigned int start, end;
+		int consumed = 0;
+
+		if (persistRangeCount == PERSIST_MAX_RANGES) {
+			printf("Persist error: More than %d ranges\n", PERSIST_MAX_RANGES);
+			return 0;
+		}
+		if (sscanf(cursor, "%x-%x%n", &start, &end, &consumed) != 2 || start > end || end >= MEMORY_SIZE) {
+			printf("Persist error: Bad range in %s, expected start-end in hex within 0000-%04X\n", text, MEMORY_SIZE - 1);
+			return 0;
+		}
+		cursor += consumed;
+		if (*cursor == ',') {
+			cursor++;
+		}
+		else if (*cursor != '\0') {
+			printf("Persist error: Bad range in %s, ranges are separated by commas\n", text);
+			return 0;
+		}
+
+		persistRanges[persistRangeCount].start = (uint32_t)(start / pageSize * pageSize);
+		persistRanges[persistRangeCount].end = (uint32_t)((end / pageSize + 1) * pageSize);
+		if (persistRanges[persistRangeCount].end > MEMORY_SIZE) {
+			persistRanges[persistRangeCount].end = MEMORY_SIZE;
+		}
+		persistRangeCount++;
+	}
+	return persistRangeCount > 0;
+}
+
+static int isPersistent(uint32_t address) {
+	for (int i = 0; i < persistRangeCount; i++) {
+		if (address >= persistRanges[i].start && address < persistRanges[i].end) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// reads or writes the persistent ranges between memory and the file, for hosts that can't split the mapping
+// returns 0 if the file couldn't be opened or a range couldn't be written in full
+static int copyRanges(const char* path, int writing) {
+	FILE* file = fopen(path, writing ? "r+b" : "rb");
+	int success = 1;
+
+	if (file == NULL) {
+		return 0;
+	}
+	for (int i = 0; i < persistRangeCount && success; i++) {
+		size_t length = persistRanges[i].end - persistRanges[i].start;
+		if (fseek(file, (long)persistRanges[i].start, SEEK_SET) != 0) {
+			success = 0;
+		}
+		else if (writing) {
+			success = fwrite(memory + persistRanges[i].start, 1, length, file) == length;
+		}
+		else if (fread(memory + persistRanges[i].start, 1, length, file) != length) {
+			// the file was just extended to the full size, a short read leaves the rest as loaded
+			break;
+		}
+	}
+	// buffered writes only reach the file here
+	if (fclose(file) != 0 && writing) {
+		success = 0;
+	}
+	return success;
+}
+
+int startPersistence(const char* path, const char* ranges) {
+	size_t pageSize = hostPageSize();
+	int created = 0;
+
+	if (ranges != NULL && !parseRanges(ranges, pageSize)) {
+		return 0;
+	}
+
+	persistBacking = hostMapFile(&persistMapping, path, MEMORY_SIZE, &created);
+	if (persistBacking == NULL) {
+		printf("Persist error: Unable to map %s\n", path);
+		return 0;
+	}
+	persistPath = path;
+
+	// only the listed pages stay on the file, a page run at a time
+	if (persistRangeCount > 0) {
+		uint32_t address = 0;
+		while (address < MEMORY_SIZE) {
+			uint32_t runEnd = address;
+			while (runEnd < MEMORY_SIZE && !isPersistent(runEnd)) {
+				runEnd += (uint32_t)pageSize;
+			}
+			if (runEnd > address && !hostPrivatizePages(persistBacking + address, runEnd - address)) {
+				persistCopying = 1;
+				break;
+			}
+			address = runEnd;
+			while (address < MEMORY_SIZE && isPersistent(address)) {
+				address += (uint32_t)pageSize;
+			}
+		}
+	}
+
+	// a split that failed part way has left some pages private, so the mapping is dropped and memory stays allocated
+	if (persistCopying) {
+		hostUnmap(&persistMapping);
+		persistBacking = NULL;
+		if (!copyRanges(path, 0)) {
+			printf("Persist error: Unable to read %s\n", path);
+			persistPath = NULL;
+			persistCopying = 0;
+			return 0;
+		}
+	}
+	else {
+		useMemoryBacking(persistBacking);
+	}
+
+	printf("Persistent memory %s (%s)", path, created ? "new" : "warm");
+	for (int i = 0; i < persistRangeCount; i++) {
+		printf("%s%04X-%04X", i == 0 ? ": " : ",", persistRanges[i].start, persistRanges[i].end - 1);
+	}
+	printf("%s\n", persistCopying ? ", written back on exit" : "");
+	return 1;
+}
+
+int finishPersistence() {
+	int result = 0;
+
+	if (persistPath == NULL) {
+		return 0;
+	}
+
+	if (persistCopying) {
+		if (!copyRanges(persistPath, 1)) {
+			printf("Persist error: Unable to write back to %s\n", persistPath);
+			result = 1;
+		}
+	}
+	else {
+		hostFlushMapping(&persistMapping);
+		releaseMemoryBacking();
+		hostUnmap(&persistMapping);
+		persistBacking = NULL;
+	}
+	persistPath = NULL;
+	persistCopying = 0;
+	return result;
+}
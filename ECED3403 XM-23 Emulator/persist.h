@@ -0,0 +1,22 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include <stdint.h>
+#include "memory.h"
+
+#define PERSIST_MAX_RANGES 16
+
+// backs guest memory with a file so it survives restarts, call after initializeMemory() and before loading
+// with no ranges all of memory is the file mapped shared: it is there as soon as the file is mapped and stores
+// reach it through the page cache with nothing added to writeMemory
+// ranges ("8000-BFFF,F000-FFFF", hex and inclusive) keep only those addresses, widened to whole host pages, the
+// other pages are swapped for private zeroed ones, where pages can't be swapped the ranges are read in here and
+// written back by finishPersistence() instead
+// returns 0 if the file or the ranges can't be used
+int startPersistence(const char* path, const char* ranges);
+
+// flushes the persistent pages to the file and gives the emulator its own copy of memory back,
+// call before cleanupMemory(), returns 0/1 for success/failure
+int finishPersistence();
+
+#endif // !PERSIST_H
@@ -0,0 +1,246 @@
+#include "pipeline.h"
+#include "cpu.h"
+#include "hotspots.h"
+#include "memory.h"
+#include "registers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MEMORY_STAGE_HISTORY 4 // memory stage cycles remembered, enough to cover every fetch still to come
+
+struct PipelineModel {
+	int started;
+	uint16_t lastAddress;
+
+	// cycle the last instruction entered each stage
+	uint64_t fetch, decode, execute, memory;
+
+	// first cycle an instruction reading the register can enter execute, results are forwarded
+	// from the end of execute, and from the end of memory for loads
+	uint64_t registerReady[REGISTER_COUNT];
+
+	// memory stage cycles of the latest loads and stores, fetch can't use the memory port on those
+	uint64_t memoryBusy[MEMORY_STAGE_HISTORY];
+	int memoryBusyNext;
+
+	uint64_t instructions;
+	uint64_t stallCycles[STALL_CAUSES];
+	uint64_t stallEvents[STALL_CAUSES];
+	uint32_t addressStalls[MEMORY_SIZE / 2][STALL_CAUSES]; // by word address
+	uint32_t addressTotals[MEMORY_SIZE / 2];				// the same summed over the causes
+};
+
+THREAD_LOCAL PipelineModel* pipelineModel = NULL;
+
+static const char* stallNames[STALL_CAUSES] = { "data (load-use)", "branch flush", "memory port" };
+
+// registers an instruction reads, writes in execute, and writes in the memory stage (loaded values), as bit masks
+static void registerUse(const Instruction* instruction, int* reads, int* writes, int* loads) {
+	int dst = 1 << instruction->operands[0];
+	int src = 1 << instruction->operands[1];
+
+	*reads = *writes = *loads = 0;
+
+	// execute() has already narrowed the opcode to its byte for every type but SO, REX and SYS
+	switch (instruction->type) {
+	case AL:
+		*reads = dst | (instruction->rc ? 0 : src);
+		if (instruction->opcode != 0x45 && instruction->opcode != 0x49) { // CMP and BIT only set flags
+			*writes = dst;
+		}
+		break;
+	case REX:
+		*reads = instruction->opcode == 0x4C80 ? src | dst : src; // SWAP reads both
+		*writes = instruction->opcode == 0x4C80 ? src | dst : dst;
+		break;
+	case SO:
+		*reads = *writes = dst;
+		break;
+	case RIN:
+		*reads = instruction->opcode == 0x60 || instruction->opcode == 0x78 ? dst : 0; // MOVL and MOVH keep a byte
+		*writes = dst;
+		break;
+	case MEM:
+		if (instruction->opcode == 0x58 || instruction->opcode == 0x80) { // LD, LDR
+			*reads = src;
+			*loads = dst;
+			if (instruction->opcode == 0x58 && (instruction->inc || instruction->dec)) {
+				*writes = src;
+			}
+		}
+		else { // ST, STR
+			*reads = src | dst;
+			if (instruction->opcode == 0x5C && (instruction->inc || instruction->dec)) {
+				*writes = dst;
+			}
+		}
+		break;
+	case TOC:
+		if (instruction->opcode == 0x00) { // BL
+			*writes = 1 << R_LR;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static uint64_t maxCycle(uint64_t a, uint64_t b) {
+	return a > b ? a : b;
+}
+
+static int memoryPortBusy(const PipelineModel* model, uint64_t cycle) {
+	for (int i = 0; i < MEMORY_STAGE_HISTORY; i++) {
+		if (model->memoryBusy[i] == cycle) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void pipelineRecord(uint16_t address, const Instruction* instruction) {
+	PipelineModel* model = pipelineModel;
+	uint64_t delay[STALL_CAUSES] = { 0 };
+	int reads, writes, loads;
+
+	registerUse(instruction, &reads, &writes, &loads);
+
+	if (!model->started) {
+		// first instruction fills an empty pipeline
+		model->started = 1;
+		model->fetch = 0;
+		model->decode = 1;
+		model->execute = 2;
+		model->memory = 3;
+		model->instructions = 1;
+		model->lastAddress = address;
+		for (int r = 0; r < REGISTER_COUNT; r++) {
+			if (writes & (1 << r)) model->registerReady[r] = model->execute + 1;
+			if (loads & (1 << r)) model->registerReady[r] = model->memory + 1;
+		}
+		if (instruction->type == MEM) {
+			model->memoryBusy[model->memoryBusyNext++ % MEMORY_STAGE_HISTORY] = model->memory;
+		}
+		return;
+	}
+
+	// fetch follows the last one, once it has moved on to decode
+	uint64_t fetchBase = maxCycle(model->fetch + 1, model->decode);
+	uint64_t fetch = fetchBase;
+
+	// anything but the next word means the instruction before redirected the PC (branch, write to PC, CEX skip,
+	// interrupt), the right address is only known once it has been through execute
+	if (address != (uint16_t)(model->lastAddress + 2)) {
+		fetch = maxCycle(fetch, model->execute + 1);
+		delay[STALL_BRANCH] = fetch - fetchBase;
+	}
+
+	// one memory port, a load or store in the memory stage holds fetch off for the cycle
+	while (memoryPortBusy(model, fetch)) {
+		fetch++;
+		delay[STALL_MEMORY]++;
+	}
+
+	uint64_t decode = maxCycle(fetch + 1, model->execute);
+	uint64_t executeBase = maxCycle(decode + 1, model->memory);
+	uint64_t execute = executeBase;
+
+	for (int r = 0; r < REGISTER_COUNT; r++) {
+		if (reads & (1 << r)) {
+			execute = maxCycle(execute, model->registerReady[r]);
+		}
+	}
+	delay[STALL_DATA] = execute - executeBase;
+
+	uint64_t memory = maxCycle(execute + 1, model->memory + 1);
+
+	// the stall seen is how much later than the cycle after the last one this instruction reached memory,
+	// overlapping delays are only counted once, charged to the earliest stage that caused them
+	// a branch flush is listed against the instruction that redirected, the others against the one that waited
+	uint64_t stall = memory - (model->memory + 1);
+	StallCause order[STALL_CAUSES] = { STALL_BRANCH, STALL_MEMORY, STALL_DATA };
+	for (int i = 0; i < STALL_CAUSES && stall > 0; i++) {
+		uint64_t charged = delay[order[i]] < stall ? delay[order[i]] : stall;
+		if (charged > 0) {
+			model->stallCycles[order[i]] += charged;
+			model->stallEvents[order[i]]++;
+			int word = (order[i] == STALL_BRANCH ? model->lastAddress : address) >> 1;
+			model->addressStalls[word][order[i]] += (uint32_t)charged;
+			model->addressTotals[word] += (uint32_t)charged;
+			stall -= charged;
+		}
+	}
+
+	for (int r = 0; r < REGISTER_COUNT; r++) {
+		if (writes & (1 << r)) model->registerReady[r] = execute + 1;
+		if (loads & (1 << r)) model->registerReady[r] = memory + 1;
+	}
+	if (instruction->type == MEM) {
+		model->memoryBusy[model->memoryBusyNext++ % MEMORY_STAGE_HISTORY] = memory;
+	}
+
+	model->fetch = fetch;
+	model->decode = decode;
+	model->execute = execute;
+	model->memory = memory;
+	model->lastAddress = address;
+	model->instructions++;
+}
+
+// lists the instructions with the most stall cycles
+static void printHotspots(const PipelineModel* model) {
+	uint16_t addresses[PIPELINE_HOTSPOTS];
+	int count = findHotspots(model->addressTotals, PIPELINE_HOTSPOTS, addresses);
+
+	printf("\nStall hotspots:\n");
+	printf("Address  Word  Mnemonic      Stalls      Data    Branch    Memory\n");
+	printf("-----------------------------------------------------------------\n");
+
+	for (int line = 0; line < count; line++) {
+		uint16_t address = addresses[line];
+		uint16_t word;
+		const char* mnemonic = hotspotMnemonic(address, &word);
+		const uint32_t* stalls = model->addressStalls[address >> 1];
+
+		printf("0x%04X   %04X  %-8s %10u %9u %9u %9u\n", address, word, mnemonic, model->addressTotals[address >> 1],
+			stalls[STALL_DATA], stalls[STALL_BRANCH], stalls[STALL_MEMORY]);
+	}
+}
+
+int runPipeline(uint64_t cycleLimit) {
+	PipelineModel* model = (PipelineModel*)calloc(1, sizeof(PipelineModel));
+	uint64_t totalStalls = 0;
+
+	if (model == NULL) {
+		printf("Pipeline error: Unable to allocate the pipeline model\n");
+		return 1;
+	}
+
+	traceEnabled = 0;
+	pipelineModel = model;
+	int status = cpuRun(cycleLimit > 0 ? cycleLimit : PIPELINE_DEFAULT_CYCLES);
+	pipelineModel = NULL;
+
+	// the last instruction finishes the cycle after it enters the memory stage
+	uint64_t cycles = model->started ? model->memory + 1 : 0;
+	for (int cause = 0; cause < STALL_CAUSES; cause++) {
+		totalStalls += model->stallCycles[cause];
+	}
+
+	printf("%s after %llu instructions\n\n", status == CPU_HALTED ? "Halted" : status == CPU_ASLEEP ? "Asleep" : "Cycle limit reached",
+		(unsigned long long)model->instructions);
+	printf("Pipeline model: fetch, decode, execute, memory, forwarding from execute and memory, one memory port\n");
+	printf("  Cycles              : %llu (sequential model %llu)\n", (unsigned long long)cycles, (unsigned long long)cpuClock);
+	printf("  CPI                 : %.3f\n", model->instructions ? (double)cycles / model->instructions : 0.0);
+	printf("  Stall cycles        : %llu\n", (unsigned long long)totalStalls);
+	for (int cause = 0; cause < STALL_CAUSES; cause++) {
+		printf("    %-17s : %llu in %llu stalls\n", stallNames[cause],
+			(unsigned long long)model->stallCycles[cause], (unsigned long long)model->stallEvents[cause]);
+	}
+
+	printHotspots(model);
+
+	free(model);
+	return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+#include "decode.h"
+#include "tls.h"
+
+#define PIPELINE_DEFAULT_CYCLES 100000000ULL	// interpreter cycle limit when none is given
+#define PIPELINE_HOTSPOTS 10					// instructions listed in the stall report
+
+// reasons an instruction entered the memory stage later than the cycle after the one before it
+typedef enum {
+	STALL_DATA,		// waiting on a register a load hasn't brought back yet
+	STALL_BRANCH,	// fetch waited for an earlier instruction that redirected the PC to reach execute
+	STALL_MEMORY,	// fetch lost the single memory port to a load or store in the memory stage
+	STALL_CAUSES
+} StallCause;
+
+typedef struct PipelineModel PipelineModel;
+
+// pipeline model fed by cpuStep on this thread, NULL when the mode isn't running
+extern THREAD_LOCAL PipelineModel* pipelineModel;
+
+// runs the loaded program headless on the interpreter while a fetch/decode/execute/memory pipeline model
+// replays every executed instruction, then prints CPI, stall cycles by cause and the instructions that stall most
+// returns 0 for success, 1 if the model couldn't be allocated
+int runPipeline(uint64_t cycleLimit);
+
+// replays one executed instruction through the model, called by cpuStep while pipelineModel is set
+void pipelineRecord(uint16_t address, const Instruction* instruction);
+
+#endif // !PIPELINE_H
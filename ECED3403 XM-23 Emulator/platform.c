@@ -0,0 +1,445 @@
+#include "platform.h"
+
+#include <stdlib.h>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// arguments handed to a new thread, freed by the thread once it starts
+typedef struct {
+	HostThreadFunction function;
+	void* argument;
+} ThreadStart;
+
+#ifdef _WIN32
+
+static DWORD WINAPI threadTrampoline(LPVOID parameter) {
+	ThreadStart start = *(ThreadStart*)parameter;
+	free(parameter);
+	start.function(start.argument);
+	return 0;
+}
+
+int hostThreadCreate(HostThread* thread, HostThreadFunction function, void* argument) {
+	ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+	if (start == NULL) {
+		return 0;
+	}
+	start->function = function;
+	start->argument = argument;
+
+	*thread = CreateThread(NULL, 0, threadTrampoline, start, 0, NULL);
+	if (*thread == NULL) {
+		free(start);
+		return 0;
+	}
+	return 1;
+}
+
+void hostThreadJoin(HostThread thread) {
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+}
+
+void hostThreadDetach(HostThread thread) {
+	CloseHandle(thread);
+}
+
+void hostMutexInit(HostMutex* mutex) { InitializeCriticalSection(mutex); }
+void hostMutexLock(HostMutex* mutex) { EnterCriticalSection(mutex); }
+void hostMutexUnlock(HostMutex* mutex) { LeaveCriticalSection(mutex); }
+void hostMutexDestroy(HostMutex* mutex) { DeleteCriticalSection(mutex); }
+
+void hostConditionInit(HostCondition* condition) { InitializeConditionVariable(condition); }
+void hostConditionWait(HostCondition* condition, HostMutex* mutex) { SleepConditionVariableCS(condition, mutex, INFINITE); }
+void hostConditionSignal(HostCondition* condition) { WakeConditionVariable(condition); }
+void hostConditionBroadcast(HostCondition* condition) { WakeAllConditionVariable(condition); }
+void hostConditionDestroy(HostCondition* condition) { (void)condition; } // nothing to release on Windows
+
+uint32_t atomicOr32(volatile uint32_t* target, uint32_t bits) {
+	return (uint32_t)InterlockedOr((volatile LONG*)target, (LONG)bits);
+}
+
+uint32_t atomicAnd32(volatile uint32_t* target, uint32_t bits) {
+	return (uint32_t)InterlockedAnd((volatile LONG*)target, (LONG)bits);
+}
+
+uint32_t atomicAdd32(volatile uint32_t* target, uint32_t amount) {
+	return (uint32_t)InterlockedExchangeAdd((volatile LONG*)target, (LONG)amount);
+}
+
+uint32_t atomicLoad32(const volatile uint32_t* source) {
+	return (uint32_t)InterlockedCompareExchange((volatile LONG*)source, 0, 0);
+}
+
+void atomicStore32(volatile uint32_t* target, uint32_t value) {
+	InterlockedExchange((volatile LONG*)target, (LONG)value);
+}
+
+void hostMemoryFence() {
+	MemoryBarrier();
+}
+
+int hostProcessorCount() {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+}
+
+void hostSleep(int milliseconds) {
+	Sleep(milliseconds);
+}
+
+uint64_t hostTimeNanoseconds() {
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+		(uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ULL / frequency.QuadPart;
+}
+
+uint8_t* hostCreateShared(HostMapping* mapping, const char* name, size_t size) {
+	mapping->file = INVALID_HANDLE_VALUE;
+	mapping->handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+		(DWORD)((uint64_t)size >> 32), (DWORD)size, name);
+	if (mapping->handle == NULL) {
+		return NULL;
+	}
+	mapping->address = (uint8_t*)MapViewOfFile(mapping->handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (mapping->address == NULL) {
+		CloseHandle(mapping->handle);
+		return NULL;
+	}
+	mapping->size = size;
+	return mapping->address;
+}
+
+uint8_t* hostOpenShared(HostMapping* mapping, const char* name) {
+	MEMORY_BASIC_INFORMATION info;
+
+	mapping->file = INVALID_HANDLE_VALUE;
+	mapping->handle = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+	if (mapping->handle == NULL) {
+		return NULL;
+	}
+	mapping->address = (uint8_t*)MapViewOfFile(mapping->handle, FILE_MAP_READ, 0, 0, 0);
+	if (mapping->address == NULL) {
+		CloseHandle(mapping->handle);
+		return NULL;
+	}
+	VirtualQuery(mapping->address, &info, sizeof(info));
+	mapping->size = info.RegionSize;
+	return mapping->address;
+}
+
+void hostRemoveShared(const char* name) {
+	(void)name; // a named mapping goes with its last handle
+}
+
+int hostProcessAlive(uint32_t processId) {
+	HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, processId);
+	int alive;
+
+	if (process == NULL) {
+		return GetLastError() == ERROR_ACCESS_DENIED;
+	}
+	alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+	CloseHandle(process);
+	return alive;
+}
+
+uint8_t* hostMapFile(HostMapping* mapping, const char* path, size_t size, int* created) {
+	LARGE_INTEGER existing;
+
+	mapping->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (mapping->file == INVALID_HANDLE_VALUE) {
+		return NULL;
+	}
+	*created = GetFileSizeEx(mapping->file, &existing) && existing.QuadPart == 0;
+
+	// a mapping larger than the file extends it with zeros
+	mapping->handle = CreateFileMappingA(mapping->file, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, NULL);
+	if (mapping->handle == NULL) {
+		CloseHandle(mapping->file);
+		return NULL;
+	}
+	mapping->address = (uint8_t*)MapViewOfFile(mapping->handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (mapping->address == NULL) {
+		CloseHandle(mapping->handle);
+		CloseHandle(mapping->file);
+		return NULL;
+	}
+	mapping->size = size;
+	return mapping->address;
+}
+
+void hostFlushMapping(HostMapping* mapping) {
+	FlushViewOfFile(mapping->address, mapping->size);
+}
+
+int hostPrivatizePages(uint8_t* address, size_t length) {
+	// views can't be split below the 64 KB allocation granularity
+	return 0;
+}
+
+size_t hostPageSize() {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwPageSize;
+}
+
+void hostUnmap(HostMapping* mapping) {
+	UnmapViewOfFile(mapping->address);
+	CloseHandle(mapping->handle);
+	if (mapping->file != INVALID_HANDLE_VALUE) {
+		CloseHandle(mapping->file);
+	}
+	mapping->address = NULL;
+}
+
+void hostSleepUntil(uint64_t deadline) {
+	// Sleep only has millisecond resolution, the last part is left to the caller's next batch
+	uint64_t now = hostTimeNanoseconds();
+	if (deadline > now + 1000000) {
+		Sleep((DWORD)((deadline - now) / 1000000));
+	}
+}
+
+#else
+
+static void* threadTrampoline(void* parameter) {
+	ThreadStart start = *(ThreadStart*)parameter;
+	free(parameter);
+	start.function(start.argument);
+	return NULL;
+}
+
+int hostThreadCreate(HostThread* thread, HostThreadFunction function, void* argument) {
+	ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+	if (start == NULL) {
+		return 0;
+	}
+	start->function = function;
+	start->argument = argument;
+
+	if (pthread_create(thread, NULL, threadTrampoline, start) != 0) {
+		free(start);
+		return 0;
+	}
+	return 1;
+}
+
+void hostThreadJoin(HostThread thread) {
+	pthread_join(thread, NULL);
+}
+
+void hostThreadDetach(HostThread thread) {
+	pthread_detach(thread);
+}
+
+void hostMutexInit(HostMutex* mutex) { pthread_mutex_init(mutex, NULL); }
+void hostMutexLock(HostMutex* mutex) { pthread_mutex_lock(mutex); }
+void hostMutexUnlock(HostMutex* mutex) { pthread_mutex_unlock(mutex); }
+void hostMutexDestroy(HostMutex* mutex) { pthread_mutex_destroy(mutex); }
+
+void hostConditionInit(HostCondition* condition) { pthread_cond_init(condition, NULL); }
+void hostConditionWait(HostCondition* condition, HostMutex* mutex) { pthread_cond_wait(condition, mutex); }
+void hostConditionSignal(HostCondition* condition) { pthread_cond_signal(condition); }
+void hostConditionBroadcast(HostCondition* condition) { pthread_cond_broadcast(condition); }
+void hostConditionDestroy(HostCondition* condition) { pthread_cond_destroy(condition); }
+
+uint32_t atomicOr32(volatile uint32_t* target, uint32_t bits) {
+	return __atomic_fetch_or(target, bits, __ATOMIC_SEQ_CST);
+}
+
+uint32_t atomicAnd32(volatile uint32_t* target, uint32_t bits) {
+	return __atomic_fetch_and(target, bits, __ATOMIC_SEQ_CST);
+}
+
+uint32_t atomicAdd32(volatile uint32_t* target, uint32_t amount) {
+	return __atomic_fetch_add(target, amount, __ATOMIC_SEQ_CST);
+}
+
+uint32_t atomicLoad32(const volatile uint32_t* source) {
+	return __atomic_load_n(source, __ATOMIC_ACQUIRE);
+}
+
+void atomicStore32(volatile uint32_t* target, uint32_t value) {
+	__atomic_store_n(target, value, __ATOMIC_RELEASE);
+}
+
+void hostMemoryFence() {
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+int hostProcessorCount() {
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+}
+
+void hostSleep(int milliseconds) {
+	usleep((useconds_t)milliseconds * 1000);
+}
+
+uint64_t hostTimeNanoseconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+void hostSleepUntil(uint64_t deadline) {
+	struct timespec until;
+
+	// an absolute deadline on the same clock, so time spent getting here isn't slept again
+	until.tv_sec = (time_t)(deadline / 1000000000ULL);
+	until.tv_nsec = (long)(deadline % 1000000000ULL);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR);
+}
+
+// POSIX segment names start with a slash, Windows names don't, so callers can use the same name on both
+static void sharedName(char* buffer, size_t size, const char* name) {
+	snprintf(buffer, size, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+uint8_t* hostCreateShared(HostMapping* mapping, const char* name, size_t size) {
+	char path[256];
+
+	sharedName(path, sizeof(path), name);
+	mapping->descriptor = shm_open(path, O_RDWR | O_CREAT, 0644);
+	if (mapping->descriptor < 0) {
+		return NULL;
+	}
+	if (ftruncate(mapping->descriptor, (off_t)size) != 0) {
+		close(mapping->descriptor);
+		return NULL;
+	}
+	mapping->address = (uint8_t*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, mapping->descriptor, 0);
+	if (mapping->address == MAP_FAILED) {
+		close(mapping->descriptor);
+		mapping->address = NULL;
+		return NULL;
+	}
+	mapping->size = size;
+	return mapping->address;
+}
+
+uint8_t* hostOpenShared(HostMapping* mapping, const char* name) {
+	char path[256];
+	struct stat info;
+
+	sharedName(path, sizeof(path), name);
+	mapping->descriptor = shm_open(path, O_RDONLY, 0);
+	if (mapping->descriptor < 0) {
+		return NULL;
+	}
+	if (fstat(mapping->descriptor, &info) != 0 || info.st_size == 0) {
+		close(mapping->descriptor);
+		return NULL;
+	}
+	mapping->address = (uint8_t*)mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, mapping->descriptor, 0);
+	if (mapping->address == MAP_FAILED) {
+		close(mapping->descriptor);
+		mapping->address = NULL;
+		return NULL;
+	}
+	mapping->size = (size_t)info.st_size;
+	return mapping->address;
+}
+
+void hostRemoveShared(const char* name) {
+	char path[256];
+
+	sharedName(path, sizeof(path), name);
+	shm_unlink(path);
+}
+
+int hostProcessAlive(uint32_t processId) {
+	// signal 0 only checks, a process owned by someone else still exists
+	return kill((pid_t)processId, 0) == 0 || errno == EPERM;
+}
+
+uint8_t* hostMapFile(HostMapping* mapping, const char* path, size_t size, int* created) {
+	struct stat info;
+
+	mapping->descriptor = open(path, O_RDWR | O_CREAT, 0644);
+	if (mapping->descriptor < 0) {
+		return NULL;
+	}
+	if (fstat(mapping->descriptor, &info) != 0) {
+		close(mapping->descriptor);
+		return NULL;
+	}
+	*created = info.st_size == 0;
+
+	// pages past the end of a file can't be mapped, so grow it to size first
+	if ((size_t)info.st_size < size && ftruncate(mapping->descriptor, (off_t)size) != 0) {
+		close(mapping->descriptor);
+		return NULL;
+	}
+	mapping->address = (uint8_t*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, mapping->descriptor, 0);
+	if (mapping->address == MAP_FAILED) {
+		close(mapping->descriptor);
+		mapping->address = NULL;
+		return NULL;
+	}
+	mapping->size = size;
+	return mapping->address;
+}
+
+void hostFlushMapping(HostMapping* mapping) {
+	msync(mapping->address, mapping->size, MS_SYNC);
+}
+
+int hostPrivatizePages(uint8_t* address, size_t length) {
+	// a fixed anonymous mapping replaces the file pages in place, the rest of the mapping is untouched
+	return mmap(address, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED;
+}
+
+size_t hostPageSize() {
+	long size = sysconf(_SC_PAGESIZE);
+	return size > 0 ? (size_t)size : 4096;
+}
+
+void hostUnmap(HostMapping* mapping) {
+	munmap(mapping->address, mapping->size);
+	close(mapping->descriptor);
+	mapping->address = NULL;
+}
+
+#endif
+
+int hostHasAVX2() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	int info[4];
+
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return 0;
+	}
+
+	// AVX has to be supported and the OS has to save the YMM registers
+	__cpuid(info, 1);
+	if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6) {
+		return 0;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,118 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdint.h>
+
+// thin wrappers over the host threading primitives (Win32 on Windows, pthreads elsewhere)
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+typedef HANDLE HostThread;
+typedef CRITICAL_SECTION HostMutex;
+typedef CONDITION_VARIABLE HostCondition;
+#else
+#include <pthread.h>
+
+typedef pthread_t HostThread;
+typedef pthread_mutex_t HostMutex;
+typedef pthread_cond_t HostCondition;
+#endif
+
+#include <stddef.h>
+
+// a region of host memory mapped from a named shared memory segment or a file
+typedef struct {
+	uint8_t* address;
+	size_t size;
+#ifdef _WIN32
+	HANDLE handle;
+	HANDLE file; // INVALID_HANDLE_VALUE for shared memory segments
+#else
+	int descriptor;
+#endif
+} HostMapping;
+
+// entry point for a host thread
+typedef void (*HostThreadFunction)(void* argument);
+
+// starts a host thread running function(argument), returns 1/0 for success/failure
+int hostThreadCreate(HostThread* thread, HostThreadFunction function, void* argument);
+
+// waits for a host thread to finish
+void hostThreadJoin(HostThread thread);
+
+// lets a host thread that will never be joined release its resources when it finishes
+void hostThreadDetach(HostThread thread);
+
+void hostMutexInit(HostMutex* mutex);
+void hostMutexLock(HostMutex* mutex);
+void hostMutexUnlock(HostMutex* mutex);
+void hostMutexDestroy(HostMutex* mutex);
+
+void hostConditionInit(HostCondition* condition);
+// releases the mutex and blocks until signalled, the mutex is held again on return
+void hostConditionWait(HostCondition* condition, HostMutex* mutex);
+void hostConditionSignal(HostCondition* condition);
+void hostConditionBroadcast(HostCondition* condition);
+void hostConditionDestroy(HostCondition* condition);
+
+// atomic read-modify-write on a word shared between host threads, returns the previous value
+uint32_t atomicOr32(volatile uint32_t* target, uint32_t bits);
+uint32_t atomicAnd32(volatile uint32_t* target, uint32_t bits);
+uint32_t atomicAdd32(volatile uint32_t* target, uint32_t amount);
+
+// load with acquire and store with release ordering, enough to hand data between two host threads without a lock
+uint32_t atomicLoad32(const volatile uint32_t* source);
+void atomicStore32(volatile uint32_t* target, uint32_t value);
+
+// full memory barrier, no load or store moves across it
+void hostMemoryFence();
+
+// number of logical processors on the host, used to size worker pools
+int hostProcessorCount();
+
+// returns 1 if the processor and OS support AVX2, for picking kernels at run time
+int hostHasAVX2();
+
+// blocks the calling host thread for roughly the given time
+void hostSleep(int milliseconds);
+
+// monotonic wall clock in nanoseconds from an arbitrary start, for measuring elapsed time
+uint64_t hostTimeNanoseconds();
+
+// blocks the calling host thread until hostTimeNanoseconds() reaches deadline, returns at once if it already has
+void hostSleepUntil(uint64_t deadline);
+
+// creates the named shared memory segment (or reuses one of that name) with size bytes and maps it read/write
+// other processes see the same bytes, returns NULL if it couldn't be created
+uint8_t* hostCreateShared(HostMapping* mapping, const char* name, size_t size);
+
+// maps an existing named segment read-only at its full size, returns NULL if there is no such segment
+uint8_t* hostOpenShared(HostMapping* mapping, const char* name);
+
+// removes the named segment so it goes once the last process unmaps it, mapped views stay valid
+// on Windows a segment already goes with its last handle and this does nothing
+void hostRemoveShared(const char* name);
+
+// returns 1 if the process with the given id is still running
+int hostProcessAlive(uint32_t processId);
+
+// maps the first size bytes of a file read/write and shared, so stores land in the file with no extra work
+// the file is created or extended with zeros as needed, created is set to 1 if it was, returns NULL on failure
+uint8_t* hostMapFile(HostMapping* mapping, const char* path, size_t size, int* created);
+
+// writes a file mapping's modified pages out to the file
+void hostFlushMapping(HostMapping* mapping);
+
+// swaps mapped pages (page aligned) for private zeroed pages that are never written back, returns 0 where unsupported
+int hostPrivatizePages(uint8_t* address, size_t length);
+
+// size of a host virtual memory page
+size_t hostPageSize();
+
+// unmaps a segment or file, a segment itself lives on until no process has it mapped or it is removed
+void hostUnmap(HostMapping* mapping);
+
+#endif // !PLATFORM_H
@@ -1,6 +1,8 @@
 #include "registers.h"
+#include "interrupts.h"
+#include "platform.h"
 
-uint16_t registerFile[REGISTER_COUNT] = {
+THREAD_LOCAL uint16_t registerFile[REGISTER_COUNT] = {
 	0x0000,	// 0
 	0x0001,	// 1
 	0x0002,	// 2
@@ -11,7 +13,7 @@ uint16_t registerFile[REGISTER_COUNT] = {
 	0xFFFF	// -1
 };
 
-uint16_t PSW = 0x0000; // initialize PSW with no flags set 
+THREAD_LOCAL uint16_t PSW = 0x0000; // initialize PSW with no flags set 
 
 void initializeRegisterFile() {
 	// explicitly reset values to 0
@@ -49,6 +51,11 @@ int writeToRegister(uint8_t registerIdentifier, uint16_t value, int isByteMode,
 		registerFile[registerIdentifier] = value;
 	}
 
+	// moving the return address into the PC ends the current interrupt handler
+	if (registerIdentifier == R_PC && registerFile[R_PC] == INTERRUPT_RETURN_ADDRESS) {
+		atomicOr32(&interruptPending, INTERRUPT_RETURN_PENDING);
+	}
+
 	return 0;
 }
 
@@ -108,12 +115,15 @@ void displayPSW() {
 	printf("\n");
 }
 
-void updateFlags(uint16_t result, uint16_t src, uint16_t dst, int isByteMode, int isSubtraction) {
+void updateFlags(uint16_t result, uint16_t src, uint16_t dst, int isByteMode, int carryIn) {
 	// use 8-bit mask if byte mode, 16 bit if not (word mode)
-	uint16_t mask = isByteMode ? 0xFF : 0xFFFF;
+	uint32_t mask = isByteMode ? 0xFF : 0xFFFF;
+	uint16_t sign = isByteMode ? 0x80 : 0x8000;
 
-	// mask result based on mode
+	// mask result and operands based on mode
 	result &= mask;
+	src &= mask;
+	dst &= mask;
 
 	// reset all PSW flags before setting new ones
 	PSW &= ~(PSW_Z | PSW_N | PSW_C | PSW_V);
@@ -122,24 +132,20 @@ void updateFlags(uint16_t result, uint16_t src, uint16_t dst, int isByteMode, in
 	if (result == 0) SET_FLAG(PSW_Z);
 
 	// set negative (N) flag if result is negative (MSB is 1)
-	if (result & (isByteMode ? 0x80 : 0x8000)) SET_FLAG(PSW_N);
+	if (result & sign) SET_FLAG(PSW_N);
 
-	if (isSubtraction) {
-		// set carry if borrow occurred (dst < src)
-		if ((uint16_t)dst < (uint16_t)src) SET_FLAG(PSW_C);
-	}
-	else {
-		// set carry if overflow occurred
-		if (result < dst) SET_FLAG(PSW_C);
-	}
+	// set carry if the sum didn't fit in the operand width
+	if ((uint32_t)dst + src + (carryIn ? 1 : 0) > mask) SET_FLAG(PSW_C);
 
-	// convert values to signed
-	int16_t signedDst = (int16_t)(dst & mask);
-	int16_t signedSrc = (int16_t)(src & mask);
-	int16_t signedResult = (int16_t)(result & mask);
+	// set overflow (V) flag if dst and src have the same sign and the result has a different one
+	if ((dst ^ result) & (src ^ result) & sign) SET_FLAG(PSW_V);
+}
 
-	// set overvflow (V) flag if signed overflow occured (checking if dst and src have same signs and if the result has different sign than dst)
-	if (((signedDst < 0) == (signedSrc < 0)) && ((signedDst < 0) != (signedResult < 0))) {
-		SET_FLAG(PSW_V);
-	}
+void updateLogicFlags(uint16_t result, int isByteMode) {
+	// reset all PSW flags before setting new ones
+	PSW &= ~(PSW_Z | PSW_N | PSW_C | PSW_V);
+
+	// zero and negative flags from the result at the operand width
+	if ((result & (isByteMode ? 0xFF : 0xFFFF)) == 0) SET_FLAG(PSW_Z);
+	if (result & (isByteMode ? 0x80 : 0x8000)) SET_FLAG(PSW_N);
 }
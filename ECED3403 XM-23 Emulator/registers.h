@@ -3,11 +3,13 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include "tls.h"
 
 #define REGISTER_COUNT 8
 
 // define special registers indices
 #define R_LR 5		// link register, R5
+#define R_SP 6		// stack pointer, R6
 #define R_PC 7		// program counter, R7
 
 // define PSW bit positions
@@ -19,7 +21,7 @@
 // define helper macros for setting and clearing PSW flags
 #define SET_FLAG(flag) (PSW |= (flag))
 #define CLEAR_FLAG(flag) (PSW &= ~(flag))
-#define CHECK_FLAG(flag) (PSW &= (flag))
+#define CHECK_FLAG(flag) (PSW & (flag))
 
 // define masks for PSW fields
 #define PSW_PP_MASK   0xE000  // previous priority, (bits 15-13)
@@ -32,10 +34,10 @@
 #define PSW_C_MASK    0x0001  // carry, bit 0
 
 // struct defining our XM-23 register file
-extern uint16_t registerFile[REGISTER_COUNT];
+extern THREAD_LOCAL uint16_t registerFile[REGISTER_COUNT];
 
 // define PSW register
-extern uint16_t PSW; // PSW: 
+extern THREAD_LOCAL uint16_t PSW; // PSW: 
 
 // define available constants
 static int8_t constants[REGISTER_COUNT] = { 0, 1, 2, 4, 8, 16, 32, -1 };
@@ -55,7 +57,11 @@ void displayRegisterFile();
 // prints the PSW at the current moment in hex, binary, and broken into readable flags
 void displayPSW();
 
-// function to update status flags in PSW after an arithmetic/logic operation
-void updateFlags(uint16_t result, uint16_t src, uint16_t dst, int isByteMode, int isSubtraction);
+// function to update status flags in PSW after an addition of dst + src + carryIn
+// subtraction passes the complemented src with a carry in, so C set means no borrow
+void updateFlags(uint16_t result, uint16_t src, uint16_t dst, int isByteMode, int carryIn);
+
+// function to update N and Z after a logic, move or shift operation, C and V are cleared
+void updateLogicFlags(uint16_t result, int isByteMode);
 
 #endif // !REGISTERS_H
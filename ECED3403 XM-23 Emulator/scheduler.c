@@ -0,0 +1,141 @@
+#include "scheduler.h"
+#include "cpu.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// pending events kept as a binary min-heap ordered by cycle
+static THREAD_LOCAL ScheduledEvent eventHeap[MAX_SCHEDULED_EVENTS];
+static THREAD_LOCAL int eventCount = 0;
+static THREAD_LOCAL int backgroundCount = 0; // pending events that can't wake a sleeping cpu
+
+THREAD_LOCAL uint64_t nextEventCycle = NO_EVENT_CYCLE;
+
+static void swapEvents(int a, int b) {
+	ScheduledEvent temp = eventHeap[a];
+	eventHeap[a] = eventHeap[b];
+	eventHeap[b] = temp;
+}
+
+// moves the event at index up until its parent is earlier
+static void siftUp(int index) {
+	while (index > 0) {
+		int parent = (index - 1) / 2;
+		if (eventHeap[parent].cycle <= eventHeap[index].cycle) {
+			break;
+		}
+		swapEvents(parent, index);
+		index = parent;
+	}
+}
+
+// moves the event at index down until both children are later
+static void siftDown(int index) {
+	while (1) {
+		int left = 2 * index + 1;
+		int right = left + 1;
+		int earliest = index;
+
+		if (left < eventCount && eventHeap[left].cycle < eventHeap[earliest].cycle) earliest = left;
+		if (right < eventCount && eventHeap[right].cycle < eventHeap[earliest].cycle) earliest = right;
+
+		if (earliest == index) {
+			break;
+		}
+		swapEvents(earliest, index);
+		index = earliest;
+	}
+}
+
+static void removeEvent(int index) {
+	backgroundCount -= eventHeap[index].background;
+	eventCount--;
+	if (index != eventCount) {
+		eventHeap[index] = eventHeap[eventCount];
+		siftDown(index);
+		siftUp(index);
+	}
+}
+
+static void updateNextEventCycle() {
+	nextEventCycle = eventCount > 0 ? eventHeap[0].cycle : NO_EVENT_CYCLE;
+}
+
+void initializeScheduler() {
+	eventCount = 0;
+	backgroundCount = 0;
+	updateNextEventCycle();
+}
+
+static int addEvent(uint64_t cycle, EventHandler handler, void* context, int background) {
+	if (eventCount == MAX_SCHEDULED_EVENTS) {
+		printf("Scheduler error: Event queue full, event at cycle %llu dropped\n", (unsigned long long)cycle);
+		return 0;
+	}
+
+	eventHeap[eventCount].cycle = cycle;
+	eventHeap[eventCount].handler = handler;
+	eventHeap[eventCount].context = context;
+	eventHeap[eventCount].background = background;
+	siftUp(eventCount);
+	eventCount++;
+	backgroundCount += background;
+
+	updateNextEventCycle();
+	return 1;
+}
+
+int scheduleEvent(uint64_t cycle, EventHandler handler, void* context) {
+	return addEvent(cycle, handler, context, 0);
+}
+
+int scheduleBackgroundEvent(uint64_t cycle, EventHandler handler, void* context) {
+	return addEvent(cycle, handler, context, 1);
+}
+
+int hasWakingEvents() {
+	return eventCount > backgroundCount;
+}
+
+void cancelEvents(EventHandler handler, void* context) {
+	int kept = 0;
+
+	// keep the events that don't match, then rebuild the heap once, removing one at a time
+	// would sift entries the scan hasn't reached yet into slots it has already passed
+	for (int i = 0; i < eventCount; i++) {
+		if (eventHeap[i].handler == handler && eventHeap[i].context == context) {
+			backgroundCount -= eventHeap[i].background;
+		}
+		else {
+			eventHeap[kept++] = eventHeap[i];
+		}
+	}
+	eventCount = kept;
+	for (int i = eventCount / 2 - 1; i >= 0; i--) {
+		siftDown(i);
+	}
+	updateNextEventCycle();
+}
+
+void saveScheduler(SchedulerState* state) {
+	memcpy(state->events, eventHeap, eventCount * sizeof(ScheduledEvent));
+	state->eventCount = eventCount;
+	state->backgroundCount = backgroundCount;
+}
+
+void restoreScheduler(const SchedulerState* state) {
+	memcpy(eventHeap, state->events, state->eventCount * sizeof(ScheduledEvent));
+	eventCount = state->eventCount;
+	backgroundCount = state->backgroundCount;
+	updateNextEventCycle();
+}
+
+void runDueEvents() {
+	while (eventCount > 0 && eventHeap[0].cycle <= cpuClock) {
+		// pop before running, the handler may reschedule itself
+		ScheduledEvent event = eventHeap[0];
+		removeEvent(0);
+		event.handler(event.context, event.cycle);
+	}
+	updateNextEventCycle();
+}
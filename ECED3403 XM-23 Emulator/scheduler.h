@@ -0,0 +1,53 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include "tls.h"
+
+#define MAX_SCHEDULED_EVENTS 64 // max events pending at once (one or two per device is typical)
+#define NO_EVENT_CYCLE UINT64_MAX // next event cycle when nothing is scheduled
+
+// handler run when an event comes due, cycle is the cycle the event was scheduled for
+typedef void (*EventHandler)(void* context, uint64_t cycle);
+
+typedef struct {
+	uint64_t cycle;
+	EventHandler handler;
+	void* context;
+	int background;
+} ScheduledEvent;
+
+// a thread's pending events, copied out and back in when the thread switches machines
+typedef struct {
+	ScheduledEvent events[MAX_SCHEDULED_EVENTS];
+	int eventCount;
+	int backgroundCount;
+} SchedulerState;
+
+// cycle of the earliest pending event, the cpu loop compares cpuClock against this once per instruction
+extern THREAD_LOCAL uint64_t nextEventCycle;
+
+// clears all pending events
+void initializeScheduler();
+
+// schedules handler to run once cpuClock reaches cycle, returns 1/0 for success/failure (queue full)
+int scheduleEvent(uint64_t cycle, EventHandler handler, void* context);
+
+// schedules a host-side event that runs on time while the cpu is awake but can't wake it
+// a sleeping cpu with only background events pending is treated as having nothing to wait for
+int scheduleBackgroundEvent(uint64_t cycle, EventHandler handler, void* context);
+
+// returns 1 if any pending event isn't a background event
+int hasWakingEvents();
+
+// removes all pending events with the given handler and context
+void cancelEvents(EventHandler handler, void* context);
+
+// copies this thread's pending events out, or back in, restoring also sets nextEventCycle
+void saveScheduler(SchedulerState* state);
+void restoreScheduler(const SchedulerState* state);
+
+// runs every event that is due at the current cpuClock, in cycle order
+void runDueEvents();
+
+#endif // !SCHEDULER_H
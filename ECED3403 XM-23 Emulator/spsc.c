@@ -0,0 +1,52 @@
+#include "spsc.h"
+#include "platform.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int spscInit(SpscQueue* queue, uint32_t itemSize, uint32_t capacity) {
+	uint32_t rounded = 1;
+
+	while (rounded < capacity) {
+		rounded <<= 1;
+	}
+
+	queue->slots = (uint8_t*)malloc((size_t)itemSize * rounded);
+	if (queue->slots == NULL) {
+		return 0;
+	}
+	queue->itemSize = itemSize;
+	queue->mask = rounded - 1;
+	queue->head = 0;
+	queue->tail = 0;
+	return 1;
+}
+
+void spscDestroy(SpscQueue* queue) {
+	free(queue->slots);
+	queue->slots = NULL;
+}
+
+int spscPush(SpscQueue* queue, const void* item) {
+	uint32_t head = queue->head;
+
+	// the acquire pairs with the consumer's release, the slot it freed is done being read
+	if (head - atomicLoad32(&queue->tail) > queue->mask) {
+		return 0;
+	}
+	memcpy(queue->slots + (size_t)(head & queue->mask) * queue->itemSize, item, queue->itemSize);
+	atomicStore32(&queue->head, head + 1);
+	return 1;
+}
+
+int spscPop(SpscQueue* queue, void* item) {
+	uint32_t tail = queue->tail;
+
+	// the acquire pairs with the producer's release, the slot's contents are visible
+	if (tail == atomicLoad32(&queue->head)) {
+		return 0;
+	}
+	memcpy(item, queue->slots + (size_t)(tail & queue->mask) * queue->itemSize, queue->itemSize);
+	atomicStore32(&queue->tail, tail + 1);
+	return 1;
+}
@@ -0,0 +1,27 @@
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <stdint.h>
+
+// fixed-size ring of fixed-size items between exactly one producer thread and one consumer thread
+// neither side ever takes a lock or waits, a push to a full queue or a pop from an empty one just fails
+typedef struct {
+	uint8_t* slots;
+	uint32_t itemSize;
+	uint32_t mask;				// capacity - 1, the capacity is a power of 2
+	volatile uint32_t head;		// next slot to write, only written by the producer
+	volatile uint32_t tail;		// next slot to read, only written by the consumer
+} SpscQueue;
+
+// allocates room for capacity items (rounded up to a power of 2), returns 0 if it couldn't
+int spscInit(SpscQueue* queue, uint32_t itemSize, uint32_t capacity);
+
+void spscDestroy(SpscQueue* queue);
+
+// producer side, copies the item in, returns 0 if the queue is full
+int spscPush(SpscQueue* queue, const void* item);
+
+// consumer side, copies the oldest item out, returns 0 if the queue is empty
+int spscPop(SpscQueue* queue, void* item);
+
+#endif // !SPSC_H
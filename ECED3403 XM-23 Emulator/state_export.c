@@ -0,0 +1,160 @@
+#include "state_export.h"
+#include "cpu.h"
+#include "platform.h"
+#include "registers.h"
+#include "scheduler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define currentProcessId() ((uint32_t)GetCurrentProcessId())
+#else
+#include <unistd.h>
+#define currentProcessId() ((uint32_t)getpid())
+#endif
+
+static HostMapping exportMapping;
+static ExportHeader* exportHeader = NULL;
+static char exportName[256];
+
+// writes the snapshot fields under the seqlock, the increments are full barriers so no field write
+// can move outside the odd window
+static void publishSnapshot() {
+	ExportHeader* header = exportHeader;
+
+	atomicAdd32(&header->sequence, 1);
+	header->cpuClock = cpuClock;
+	header->instructionCount = instructionCount;
+	memcpy(header->registers, registerFile, sizeof(header->registers));
+	header->psw = PSW;
+	header->snapshots++;
+	atomicAdd32(&header->sequence, 1);
+}
+
+// background event, keeps publishing while the cpu runs without keeping a sleeping cpu awake
+static void exportEvent(void* context, uint64_t cycle) {
+	(void)context;
+	publishSnapshot();
+	scheduleBackgroundEvent(cycle + EXPORT_PERIOD_CYCLES, exportEvent, NULL);
+}
+
+void publishExport() {
+	if (exportHeader != NULL) {
+		publishSnapshot();
+	}
+}
+
+int startExport(const char* name) {
+	uint8_t* segment = hostCreateShared(&exportMapping, name, EXPORT_SEGMENT_SIZE);
+
+	if (segment == NULL) {
+		printf("Export error: Unable to create shared memory segment %s\n", name);
+		return 0;
+	}
+
+	snprintf(exportName, sizeof(exportName), "%s", name);
+
+	// the segment may be left over from an earlier run, start from a clean header and the memory as allocated
+	exportHeader = (ExportHeader*)segment;
+	memset(exportHeader, 0, sizeof(ExportHeader));
+	memcpy(segment + EXPORT_MEMORY_OFFSET, memory, MEMORY_SIZE);
+	useMemoryBacking(segment + EXPORT_MEMORY_OFFSET);
+
+	memcpy(exportHeader->magic, EXPORT_MAGIC, sizeof(exportHeader->magic));
+	exportHeader->version = EXPORT_VERSION;
+	exportHeader->memoryOffset = EXPORT_MEMORY_OFFSET;
+	exportHeader->memorySize = MEMORY_SIZE;
+	exportHeader->processId = currentProcessId();
+	atomicStore32(&exportHeader->attached, 1);
+
+	publishSnapshot();
+	scheduleBackgroundEvent(cpuClock + EXPORT_PERIOD_CYCLES, exportEvent, NULL);
+	printf("Exporting state to shared memory segment %s\n", name);
+	return 1;
+}
+
+void finishExport() {
+	if (exportHeader == NULL) {
+		return;
+	}
+
+	cancelEvents(exportEvent, NULL);
+	publishSnapshot();
+	atomicStore32(&exportHeader->attached, 0);
+	releaseMemoryBacking();
+	hostUnmap(&exportMapping);
+	exportHeader = NULL;
+
+	// a monitor still attached keeps its view until it sees the detach, the name is free for the next run
+	hostRemoveShared(exportName);
+}
+
+// reads a consistent copy of the snapshot fields, retrying while the emulator is mid-write
+static void readSnapshot(const ExportHeader* shared, ExportHeader* copy) {
+	uint32_t before, after;
+
+	do {
+		before = atomicLoad32(&shared->sequence);
+		memcpy(copy, (const void*)shared, sizeof(ExportHeader));
+		hostMemoryFence(); // the copy is complete before the sequence is looked at again
+		after = atomicLoad32(&shared->sequence);
+	} while ((before & 1) || before != after);
+}
+
+int runMonitor(const char* name, int intervalMilliseconds) {
+	HostMapping mapping;
+	const uint8_t* segment = hostOpenShared(&mapping, name);
+	ExportHeader snapshot;
+	uint64_t lastClock = 0;
+
+	if (segment == NULL) {
+		printf("Monitor error: No shared memory segment %s\n", name);
+		return 1;
+	}
+	if (mapping.size < sizeof(ExportHeader) || memcmp(segment, EXPORT_MAGIC, 8) != 0 ||
+		((const ExportHeader*)segment)->version != EXPORT_VERSION ||
+		mapping.size < (size_t)((const ExportHeader*)segment)->memoryOffset + MEMORY_SIZE) {
+		printf("Monitor error: %s is not an XM-23 state export\n", name);
+		hostUnmap(&mapping);
+		return 1;
+	}
+	if (intervalMilliseconds <= 0) {
+		intervalMilliseconds = EXPORT_MONITOR_INTERVAL_MS;
+	}
+
+	const ExportHeader* shared = (const ExportHeader*)segment;
+	const uint8_t* guestMemory = segment + shared->memoryOffset;
+	printf("Monitoring %s (process %u)\n", name, shared->processId);
+	printf("         Clock    Instructions      MHz   PC     R0   R1   R2   R3   R4   R5   R6   PSW   Stack top\n");
+
+	while (1) {
+		int attached = atomicLoad32(&shared->attached);
+
+		readSnapshot(shared, &snapshot);
+		uint16_t sp = snapshot.registers[R_SP];
+		printf("%14llu %15llu %8.3f  %04X ",
+			(unsigned long long)snapshot.cpuClock, (unsigned long long)snapshot.instructionCount,
+			(snapshot.cpuClock - lastClock) / (intervalMilliseconds * 1e3), snapshot.registers[R_PC]);
+		for (int i = 0; i < 7; i++) {
+			printf(" %04X", snapshot.registers[i]);
+		}
+		printf("  %04X  %02X%02X\n", snapshot.psw, guestMemory[(uint16_t)(sp + 1)], guestMemory[sp]);
+		fflush(stdout);
+		lastClock = snapshot.cpuClock;
+
+		if (!attached) {
+			printf("Emulator has exited\n");
+			break;
+		}
+		// an emulator that crashed never clears attached
+		if (!hostProcessAlive(shared->processId)) {
+			printf("Emulator process %u has gone without detaching\n", shared->processId);
+			break;
+		}
+		hostSleep(intervalMilliseconds);
+	}
+
+	hostUnmap(&mapping);
+	return 0;
+}
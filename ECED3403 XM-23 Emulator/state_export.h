@@ -0,0 +1,48 @@
+#ifndef STATE_EXPORT_H
+#define STATE_EXPORT_H
+
+#include <stdint.h>
+#include "memory.h"
+
+#define EXPORT_MAGIC "XM23SHM1"
+#define EXPORT_VERSION 1
+#define EXPORT_MEMORY_OFFSET 4096		// guest memory starts on its own page after the header
+#define EXPORT_SEGMENT_SIZE (EXPORT_MEMORY_OFFSET + MEMORY_SIZE)
+#define EXPORT_PERIOD_CYCLES 10000		// cycles between register snapshots while the cpu runs
+#define EXPORT_MONITOR_INTERVAL_MS 500
+
+// start of the shared segment, guest memory follows at memoryOffset and is the emulator's memory itself,
+// so monitors read it live with no copying
+// the rest of the header is a seqlock-protected snapshot taken between instructions, to read it consistently:
+//   do { s = sequence (acquire); if (s is odd) retry; copy the fields; } while (sequence (acquire) != s)
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t memoryOffset;
+	uint32_t memorySize;
+	uint32_t processId;
+	volatile uint32_t sequence;		// odd while the emulator is writing the snapshot
+	volatile uint32_t attached;		// 1 while the emulator is running, 0 once it has exited
+	uint64_t cpuClock;
+	uint64_t instructionCount;
+	uint64_t snapshots;				// snapshots written so far
+	uint16_t registers[8];
+	uint16_t psw;
+	uint16_t reserved[7];
+} ExportHeader;
+
+// creates the named segment, moves guest memory into it and starts publishing registers every EXPORT_PERIOD_CYCLES
+// call after initializeMemory() and initializeScheduler() and before loading, returns 0 if the segment couldn't be made
+int startExport(const char* name);
+
+// publishes the registers and clock now when exporting, for a cpu stopping between the periodic snapshots
+void publishExport();
+
+// publishes the final state, marks the segment detached, unmaps it and removes its name, call before cleanupMemory()
+void finishExport();
+
+// maps a segment read-only and prints its snapshots until the emulator detaches or its process is gone
+// returns 1 if there is no segment
+int runMonitor(const char* name, int intervalMilliseconds);
+
+#endif // !STATE_EXPORT_H
@@ -0,0 +1,203 @@
+#include "state_hash.h"
+#include "cpu.h"
+#include "interrupts.h"
+#include "memory.h"
+#include "registers.h"
+#include "scheduler.h"
+#include "timer.h"
+#include "uart.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+// the state outside memory, zeroed before filling so padding hashes the same every time
+// device registers are in it because the guest reads them back, the receive position because input
+// still to be read changes what those reads return
+typedef struct {
+	uint16_t registers[REGISTER_COUNT];
+	uint16_t psw;
+	uint16_t interruptRequests;
+	int32_t cexExecuteCount;
+	int32_t cexSkipCount;
+	uint8_t timerControl;
+	uint8_t timerPeriod;
+	uint8_t timerExpired;
+	uint8_t uartInterruptEnable;
+	uint32_t uartRxRead;
+} CoreState;
+
+static uint64_t rotateLeft(uint64_t value, int bits) {
+	return (value << bits) | (value >> (64 - bits));
+}
+
+static uint64_t read64(const uint8_t* data) {
+	uint64_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static uint64_t hashRound(uint64_t accumulator, uint64_t input) {
+	accumulator += input * PRIME64_2;
+	return rotateLeft(accumulator, 31) * PRIME64_1;
+}
+
+static uint64_t mergeRound(uint64_t hash, uint64_t accumulator) {
+	hash ^= hashRound(0, accumulator);
+	return hash * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t hashBytes(const void* data, size_t length, uint64_t seed) {
+	const uint8_t* bytes = (const uint8_t*)data;
+	const uint8_t* end = bytes + length;
+	uint64_t hash;
+
+	if (length >= 32) {
+		// the lanes don't depend on each other, so their multiplies overlap
+		uint64_t lane1 = seed + PRIME64_1 + PRIME64_2;
+		uint64_t lane2 = seed + PRIME64_2;
+		uint64_t lane3 = seed;
+		uint64_t lane4 = seed - PRIME64_1;
+
+		do {
+			lane1 = hashRound(lane1, read64(bytes));
+			lane2 = hashRound(lane2, read64(bytes + 8));
+			lane3 = hashRound(lane3, read64(bytes + 16));
+			lane4 = hashRound(lane4, read64(bytes + 24));
+			bytes += 32;
+		} while (bytes + 32 <= end);
+
+		hash = rotateLeft(lane1, 1) + rotateLeft(lane2, 7) + rotateLeft(lane3, 12) + rotateLeft(lane4, 18);
+		hash = mergeRound(hash, lane1);
+		hash = mergeRound(hash, lane2);
+		hash = mergeRound(hash, lane3);
+		hash = mergeRound(hash, lane4);
+	}
+	else {
+		hash = seed + PRIME64_5;
+	}
+	hash += (uint64_t)length;
+
+	// tail shorter than a stripe
+	for (; bytes + 8 <= end; bytes += 8) {
+		hash ^= hashRound(0, read64(bytes));
+		hash = rotateLeft(hash, 27) * PRIME64_1 + PRIME64_4;
+	}
+	if (bytes + 4 <= end) {
+		uint32_t word;
+		memcpy(&word, bytes, sizeof(word));
+		hash ^= (uint64_t)word * PRIME64_1;
+		hash = rotateLeft(hash, 23) * PRIME64_2 + PRIME64_3;
+		bytes += 4;
+	}
+	for (; bytes < end; bytes++) {
+		hash ^= *bytes * PRIME64_5;
+		hash = rotateLeft(hash, 11) * PRIME64_1;
+	}
+
+	// final avalanche
+	hash ^= hash >> 33;
+	hash *= PRIME64_2;
+	hash ^= hash >> 29;
+	hash *= PRIME64_3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+static void fillCoreState(CoreState* state, const uint16_t* registers, uint16_t psw, uint16_t interruptRequests,
+	int cexExecute, int cexSkip) {
+	memset(state, 0, sizeof(CoreState));
+	memcpy(state->registers, registers, sizeof(state->registers));
+	state->psw = psw;
+	state->interruptRequests = interruptRequests;
+	state->cexExecuteCount = cexExecute;
+	state->cexSkipCount = cexSkip;
+}
+
+static void captureCoreState(CoreState* state) {
+	uint32_t pending;
+	uint16_t requests;
+
+	saveInterruptState(&pending, &requests);
+	fillCoreState(state, registerFile, PSW, requests, cexExecuteCount, cexSkipCount);
+	getTimerState(&state->timerControl, &state->timerPeriod, &state->timerExpired);
+	getUARTState(&state->uartRxRead, &state->uartInterruptEnable);
+}
+
+static uint64_t hashState(const uint8_t* image, const CoreState* state) {
+	return hashBytes(state, sizeof(CoreState), hashBytes(image, MEMORY_SIZE, 0));
+}
+
+uint64_t hashMachineState() {
+	CoreState state;
+
+	captureCoreState(&state);
+	return hashState(memory, &state);
+}
+
+uint64_t hashMachineParts(const uint8_t* image, const uint16_t* registers, uint16_t psw, uint16_t interruptRequests,
+	int cexExecute, int cexSkip, uint32_t inputRead) {
+	CoreState state;
+
+	fillCoreState(&state, registers, psw, interruptRequests, cexExecute, cexSkip);
+	state.uartRxRead = inputRead;
+	return hashState(image, &state);
+}
+
+int cpuRunDetectingLoops(uint64_t cycleLimit, uint64_t checkCycles, uint64_t* period) {
+	uint8_t* savedMemory = (uint8_t*)malloc(MEMORY_SIZE);
+	CoreState saved, current;
+	uint64_t savedHash = 0, savedClock = 0;
+	uint64_t power = 1, distance = 0;
+	int haveSaved = 0;
+	int status = CPU_RUNNING;
+
+	if (savedMemory == NULL) {
+		return cpuRun(cycleLimit);
+	}
+
+	while (status == CPU_RUNNING && cpuClock < cycleLimit) {
+		status = cpuRun(cycleLimit - cpuClock > checkCycles ? cpuClock + checkCycles : cycleLimit);
+		if (status != CPU_RUNNING || cpuClock >= cycleLimit) {
+			break;
+		}
+
+		// something outside the hashed state is about to change it, start looking again from a later checkpoint
+		if (hasWakingEvents() || interruptPending || hasExternalSources()) {
+			haveSaved = 0;
+			continue;
+		}
+
+		captureCoreState(&current);
+		uint64_t hash = hashState(memory, &current);
+
+		// a hash match is only a loop once the saved copy agrees byte for byte
+		if (haveSaved && hash == savedHash && memcmp(&current, &saved, sizeof(CoreState)) == 0 &&
+			memcmp(memory, savedMemory, MEMORY_SIZE) == 0) {
+			*period = cpuClock - savedClock;
+			status = CPU_LOOPING;
+			break;
+		}
+
+		// Brent's method: one saved checkpoint, moved up whenever the distance from it reaches the next power of two,
+		// finds a repeat of any length within a few times its length without storing every hash
+		distance++;
+		if (!haveSaved || distance == power) {
+			power = haveSaved ? power * 2 : 1;
+			distance = 0;
+			saved = current;
+			savedHash = hash;
+			savedClock = cpuClock;
+			memcpy(savedMemory, memory, MEMORY_SIZE);
+			haveSaved = 1;
+		}
+	}
+
+	free(savedMemory);
+	return status;
+}
@@ -0,0 +1,32 @@
+#ifndef STATE_HASH_H
+#define STATE_HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LOOP_CHECK_CYCLES 100000ULL	// cycles between state hashes while looking for a repeat
+
+// 64-bit hash of a buffer (xxHash64), four independent lanes per 32-byte stripe so the compiler can keep them in flight
+uint64_t hashBytes(const void* data, size_t length, uint64_t seed);
+
+// hash of this thread's machine state: memory, registers, PSW, the CEX block counters, interrupt state, the timer
+// and UART registers and how much pre-filled UART input has been read
+// pending device events and input still to arrive from the host aren't part of it, so equal hashes only promise
+// the same future where neither is pending, the clock and instruction count are left out so equal states hash
+// equal whenever they happen, about 64 KB of hashing so it is meant for checkpoints rather than every instruction
+uint64_t hashMachineState();
+
+// the same hash from a machine's parts, for state that isn't swapped into this thread, the machine has no timer
+// and inputRead is how many bytes of its console input the guest has read
+uint64_t hashMachineParts(const uint8_t* image, const uint16_t* registers, uint16_t psw, uint16_t interruptRequests,
+	int cexExecuteCount, int cexSkipCount, uint32_t inputRead);
+
+// runs like cpuRun but hashes the state every checkCycles, and stops with CPU_LOOPING once the state at a checkpoint
+// exactly repeats an earlier checkpoint's (hash match confirmed against a saved copy), the device registers and
+// input position being part of it, so with nothing pending from outside the program will repeat forever
+// checkpoints with a device event, an interrupt or an external input source pending are skipped, the state there
+// doesn't decide what comes next on its own
+// period is set to the length of the repeat in cycles when one is found
+int cpuRunDetectingLoops(uint64_t cycleLimit, uint64_t checkCycles, uint64_t* period);
+
+#endif // !STATE_HASH_H
@@ -0,0 +1,59 @@
+#include "tas.h"
+#include "bus.h"
+#include "platform.h"
+#include "tls.h"
+
+// one bit per lock, shared by every core's thread
+static volatile uint32_t lockBits = 0;
+static volatile uint32_t acquiredCount = 0;
+static volatile uint32_t contendedCount = 0;
+
+static THREAD_LOCAL uint8_t coreId = 0;
+static THREAD_LOCAL uint8_t coreTotal = 1;
+
+static int coreIdPort(uint16_t address, uint8_t* value, int mode) {
+	if (mode == BUS_READ) {
+		*value = address == TAS_CORE_ID_ADDRESS ? coreId : coreTotal;
+	}
+	return 0;
+}
+
+// device port handler for all the lock bytes
+static int lockPort(uint16_t address, uint8_t* value, int mode) {
+	uint32_t bit = 1u << (address - TAS_LOCK_BASE_ADDRESS);
+
+	if (mode == BUS_READ) {
+		// the atomic or is the test and the set, and a full barrier so guest data written under the lock is seen
+		*value = (atomicOr32(&lockBits, bit) & bit) ? 1 : 0;
+		atomicAdd32(*value ? &contendedCount : &acquiredCount, 1);
+	}
+	else if ((*value & 1) == 0) {
+		atomicAnd32(&lockBits, ~bit);
+	}
+	else {
+		atomicOr32(&lockBits, bit);
+	}
+	return 0;
+}
+
+void attachTestAndSet(int coreIndex, int coreCount) {
+	coreId = (uint8_t)coreIndex;
+	coreTotal = (uint8_t)coreCount;
+
+	attachDevicePort(TAS_CORE_ID_ADDRESS, coreIdPort);
+	attachDevicePort(TAS_CORE_COUNT_ADDRESS, coreIdPort);
+	for (int i = 0; i < TAS_LOCK_COUNT; i++) {
+		attachDevicePort(TAS_LOCK_BASE_ADDRESS + i, lockPort);
+	}
+}
+
+void initializeTestAndSet() {
+	lockBits = 0;
+	acquiredCount = 0;
+	contendedCount = 0;
+}
+
+void testAndSetCounts(uint32_t* acquired, uint32_t* contended) {
+	*acquired = acquiredCount;
+	*contended = contendedCount;
+}
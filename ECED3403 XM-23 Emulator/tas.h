@@ -0,0 +1,25 @@
+#ifndef TAS_H
+#define TAS_H
+
+#include <stdint.h>
+
+// multi-core device port addresses (devices 2 to 7 in the device port region)
+#define TAS_CORE_ID_ADDRESS    0x0004	// read-only, index of the reading core
+#define TAS_CORE_COUNT_ADDRESS 0x0005	// read-only, number of cores in the system
+#define TAS_LOCK_BASE_ADDRESS  0x0008	// first of the test-and-set lock bytes
+#define TAS_LOCK_COUNT         8		// lock bytes at 0x0008-0x000F
+
+// a read of a lock byte returns its old value (0 free, 1 held) and leaves it at 1 as one atomic step
+// across every core, so a read of 0 means the reader now holds the lock, writing 0 releases it
+
+// attaches the core id, core count and lock ports for the calling core's thread
+// the locks are shared by every core, call initializeTestAndSet() once before any core starts
+void attachTestAndSet(int coreIndex, int coreCount);
+
+// releases every lock and clears the counters
+void initializeTestAndSet();
+
+// successful and failed lock reads since initializeTestAndSet(), failures count spinning on a held lock
+void testAndSetCounts(uint32_t* acquired, uint32_t* contended);
+
+#endif // !TAS_H
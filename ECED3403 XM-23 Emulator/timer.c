@@ -0,0 +1,89 @@
+#include "timer.h"
+#include "bus.h"
+#include "cpu.h"
+#include "interrupts.h"
+#include "scheduler.h"
+#include "tls.h"
+
+#include <stdio.h>
+
+// per thread like the scheduler its events go to, so every machine running on its own thread has its own timer
+static THREAD_LOCAL uint8_t timerControl = 0;
+static THREAD_LOCAL uint8_t timerPeriod = 0;
+static THREAD_LOCAL uint8_t timerExpired = 0;
+
+static uint64_t periodCycles() {
+	return (uint64_t)(timerPeriod ? timerPeriod : 256) * TIMER_TICK_CYCLES;
+}
+
+// scheduled once per period while the timer is enabled
+static void timerEvent(void* context, uint64_t cycle) {
+	(void)context;
+	timerExpired = TIMER_CSR_EXPIRED;
+
+	if (timerControl & TIMER_CSR_IE) {
+		raiseInterrupt(VECTOR_TIMER);
+	}
+
+	// schedule from the due cycle rather than cpuClock so the period doesn't drift
+	scheduleEvent(cycle + periodCycles(), timerEvent, NULL);
+}
+
+static void restartTimer() {
+	cancelEvents(timerEvent, NULL);
+	if (timerControl & TIMER_CSR_ENABLE) {
+		scheduleEvent(cpuClock + periodCycles(), timerEvent, NULL);
+	}
+}
+
+// device port handler for the control/status register
+static int timerCSR(uint16_t address, uint8_t* value, int mode) {
+	(void)address;
+	if (mode == BUS_READ) {
+		*value = timerControl | timerExpired;
+		timerExpired = 0;
+	}
+	else {
+		uint8_t wasEnabled = timerControl & TIMER_CSR_ENABLE;
+		timerControl = *value & (TIMER_CSR_ENABLE | TIMER_CSR_IE);
+
+		// only (re)start on the enable edge so rewriting IE doesn't reset the count
+		if ((timerControl & TIMER_CSR_ENABLE) != wasEnabled) {
+			restartTimer();
+		}
+		if (!(timerControl & TIMER_CSR_IE)) {
+			clearInterrupt(VECTOR_TIMER);
+		}
+	}
+	return 0;
+}
+
+// device port handler for the period register
+static int timerDR(uint16_t address, uint8_t* value, int mode) {
+	(void)address;
+	if (mode == BUS_READ) {
+		*value = timerPeriod;
+	}
+	else {
+		// a new period takes effect immediately
+		timerPeriod = *value;
+		restartTimer();
+	}
+	return 0;
+}
+
+void initializeTimer() {
+	timerControl = 0;
+	timerPeriod = 0;
+	timerExpired = 0;
+	cancelEvents(timerEvent, NULL);
+
+	attachDevicePort(TIMER_CSR_ADDRESS, timerCSR);
+	attachDevicePort(TIMER_DR_ADDRESS, timerDR);
+}
+
+void getTimerState(uint8_t* control, uint8_t* period, uint8_t* expired) {
+	*control = timerControl;
+	*period = timerPeriod;
+	*expired = timerExpired;
+}
@@ -0,0 +1,24 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+// timer device port addresses (device 0 in the device port region)
+#define TIMER_CSR_ADDRESS 0x0000	// control/status register
+#define TIMER_DR_ADDRESS  0x0001	// period register, in ticks
+
+// timer control/status register bits
+#define TIMER_CSR_ENABLE  0x01		// timer counts while set
+#define TIMER_CSR_EXPIRED 0x04		// period elapsed since the CSR was last read (cleared by reading)
+#define TIMER_CSR_IE      0x10		// request the timer vector each time the period elapses
+
+// cpu cycles per timer tick, a period of 0 counts as 256 ticks
+#define TIMER_TICK_CYCLES 100
+
+// attaches the timer to this thread's device ports and stops it
+void initializeTimer();
+
+// the registers as the guest would read them back, and the expired flag a CSR read clears, for hashing machine state
+void getTimerState(uint8_t* control, uint8_t* period, uint8_t* expired);
+
+#endif // !TIMER_H
@@ -0,0 +1,381 @@
+#include "timeslice.h"
+#include "memory.h"
+#include "platform.h"
+#include "registers.h"
+#include "xm23.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WEIGHT_SCALE 1024 // virtual run time is cycles * WEIGHT_SCALE / weight
+
+typedef struct {
+	XM23Machine* machine;
+	int priority;
+	uint32_t weight;
+	uint64_t virtualRuntime;
+} SlicedInstance;
+
+// a worker's run queue, a min-heap on virtual run time
+typedef struct {
+	HostMutex mutex;
+	SlicedInstance** heap;
+	int count;
+	volatile uint32_t load; // weight of the queued instances plus the one running, read unlocked as a hint
+
+	// only touched by the worker itself
+	uint64_t minRuntime; // run time of the latest instance picked from the queue, only ever rises
+	uint64_t slices;
+	uint64_t steals;
+	uint64_t parks;
+	uint64_t retired;
+	uint64_t priorityCycles[TIMESLICE_PRIORITIES];
+} Worker;
+
+// shared between the workers and the waking thread
+typedef struct {
+	Worker* workers;
+	int workerCount;
+	volatile uint32_t stop;
+
+	HostMutex parkedMutex;
+	SlicedInstance** parked;
+	int parkedCount;
+	uint64_t wakes;
+} SliceContext;
+
+// passed to each worker thread
+typedef struct {
+	SliceContext* context;
+	int index;
+} WorkerStart;
+
+static void heapPush(Worker* worker, SlicedInstance* instance) {
+	int i = worker->count++;
+
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		if (worker->heap[parent]->virtualRuntime <= instance->virtualRuntime) {
+			break;
+		}
+		worker->heap[i] = worker->heap[parent];
+		i = parent;
+	}
+	worker->heap[i] = instance;
+}
+
+static SlicedInstance* heapPop(Worker* worker) {
+	SlicedInstance* top = worker->heap[0];
+	SlicedInstance* last = worker->heap[--worker->count];
+	int i = 0;
+
+	while (1) {
+		int child = 2 * i + 1;
+		if (child >= worker->count) {
+			break;
+		}
+		if (child + 1 < worker->count && worker->heap[child + 1]->virtualRuntime < worker->heap[child]->virtualRuntime) {
+			child++;
+		}
+		if (last->virtualRuntime <= worker->heap[child]->virtualRuntime) {
+			break;
+		}
+		worker->heap[i] = worker->heap[child];
+		i = child;
+	}
+	if (worker->count > 0) {
+		worker->heap[i] = last;
+	}
+	return top;
+}
+
+// queues an instance on a worker, a newcomer starts no further behind than the queue's least run time
+// so a long sleep doesn't earn it a burst of catching up
+static void enqueue(Worker* worker, SlicedInstance* instance, int isNewcomer) {
+	hostMutexLock(&worker->mutex);
+	if (isNewcomer && worker->count > 0 && instance->virtualRuntime < worker->heap[0]->virtualRuntime) {
+		instance->virtualRuntime = worker->heap[0]->virtualRuntime;
+	}
+	heapPush(worker, instance);
+	if (isNewcomer) {
+		atomicAdd32(&worker->load, instance->weight);
+	}
+	hostMutexUnlock(&worker->mutex);
+}
+
+// takes a queued instance from the most loaded other worker when that evens out the load
+// an idle worker takes anything, otherwise only when the victim would still carry more than this worker
+// the heap's last slot is taken because removing it leaves the heap ordered, it is any leaf and not
+// necessarily a late run time, the instance joins the thief's queue at its minimum like a woken one
+static SlicedInstance* steal(SliceContext* context, int self) {
+	Worker* thief = &context->workers[self];
+	Worker* victim = NULL;
+	uint32_t victimLoad = 0;
+
+	for (int i = 1; i < context->workerCount; i++) {
+		Worker* candidate = &context->workers[(self + i) % context->workerCount];
+		if (candidate->load > victimLoad) {
+			victim = candidate;
+			victimLoad = candidate->load;
+		}
+	}
+	if (victim == NULL || victimLoad <= thief->load) {
+		return NULL;
+	}
+
+	SlicedInstance* stolen = NULL;
+	hostMutexLock(&victim->mutex);
+	if (victim->count > 0) {
+		SlicedInstance* last = victim->heap[victim->count - 1];
+		if (thief->load == 0 || victim->load - last->weight >= thief->load + last->weight) {
+			stolen = last;
+			victim->count--;
+			atomicAdd32(&victim->load, (uint32_t)-(int32_t)stolen->weight);
+		}
+	}
+	hostMutexUnlock(&victim->mutex);
+
+	if (stolen != NULL) {
+		// run times only compare within a queue, the victim's may be far ahead of or behind the thief's
+		stolen->virtualRuntime = thief->minRuntime;
+		atomicAdd32(&thief->load, stolen->weight);
+		thief->steals++;
+	}
+	return stolen;
+}
+
+// the next instance for this worker to run, NULL if there is nothing anywhere
+static SlicedInstance* pickInstance(SliceContext* context, int self) {
+	Worker* worker = &context->workers[self];
+	SlicedInstance* instance = NULL;
+
+	// every so often a busy worker also checks whether others are carrying less
+	if (worker->slices % TIMESLICE_BALANCE_SLICES == 0) {
+		SlicedInstance* stolen = steal(context, self);
+		if (stolen != NULL) {
+			enqueue(worker, stolen, 0);
+		}
+	}
+
+	hostMutexLock(&worker->mutex);
+	if (worker->count > 0) {
+		instance = heapPop(worker);
+		if (instance->virtualRuntime > worker->minRuntime) {
+			worker->minRuntime = instance->virtualRuntime;
+		}
+	}
+	hostMutexUnlock(&worker->mutex);
+
+	return instance != NULL ? instance : steal(context, self);
+}
+
+// leaves the run queues, it costs nothing until something wakes it
+static void park(SliceContext* context, Worker* worker, SlicedInstance* instance) {
+	atomicAdd32(&worker->load, (uint32_t)-(int32_t)instance->weight);
+	worker->parks++;
+
+	hostMutexLock(&context->parkedMutex);
+	context->parked[context->parkedCount++] = instance;
+	hostMutexUnlock(&context->parkedMutex);
+}
+
+static void sliceWorker(void* argument) {
+	WorkerStart* start = (WorkerStart*)argument;
+	SliceContext* context = start->context;
+	Worker* worker = &context->workers[start->index];
+
+	while (!context->stop) {
+		SlicedInstance* instance = pickInstance(context, start->index);
+		if (instance == NULL) {
+			hostSleep(1);
+			continue;
+		}
+
+		uint64_t before = xm23Cycles(instance->machine);
+		XM23StopReason reason = xm23Run(instance->machine, TIMESLICE_QUANTUM);
+		uint64_t ran = xm23Cycles(instance->machine) - before;
+
+		instance->virtualRuntime += ran * WEIGHT_SCALE / instance->weight;
+		worker->priorityCycles[instance->priority] += ran;
+		worker->slices++;
+
+		if (reason == XM23_STOP_CYCLE_LIMIT) {
+			enqueue(worker, instance, 0);
+		}
+		else if (reason == XM23_STOP_ASLEEP) {
+			park(context, worker, instance);
+		}
+		else {
+			atomicAdd32(&worker->load, (uint32_t)-(int32_t)instance->weight);
+			worker->retired++;
+		}
+	}
+}
+
+// clears SLP on every parked instance and spreads them over the least loaded workers
+static void wakeParked(SliceContext* context) {
+	hostMutexLock(&context->parkedMutex);
+	for (int i = 0; i < context->parkedCount; i++) {
+		SlicedInstance* instance = context->parked[i];
+		Worker* target = &context->workers[0];
+
+		for (int w = 1; w < context->workerCount; w++) {
+			if (context->workers[w].load < target->load) {
+				target = &context->workers[w];
+			}
+		}
+		xm23SetPSW(instance->machine, xm23GetPSW(instance->machine) & ~PSW_SLP_MASK);
+		enqueue(target, instance, 1);
+	}
+	context->wakes += context->parkedCount;
+	context->parkedCount = 0;
+	hostMutexUnlock(&context->parkedMutex);
+}
+
+static void printSummary(SliceContext* context, SlicedInstance* instances, int instanceCount, double seconds) {
+	uint64_t slices = 0, steals = 0, parks = 0, retired = 0, totalCycles = 0, totalInstructions = 0;
+	uint64_t priorityCycles[TIMESLICE_PRIORITIES] = { 0 };
+	int priorityInstances[TIMESLICE_PRIORITIES] = { 0 };
+	uint64_t totalWeight = 0;
+
+	for (int w = 0; w < context->workerCount; w++) {
+		Worker* worker = &context->workers[w];
+		slices += worker->slices;
+		steals += worker->steals;
+		parks += worker->parks;
+		retired += worker->retired;
+		for (int p = 0; p < TIMESLICE_PRIORITIES; p++) {
+			priorityCycles[p] += worker->priorityCycles[p];
+		}
+	}
+	for (int i = 0; i < instanceCount; i++) {
+		totalInstructions += xm23Instructions(instances[i].machine);
+		priorityInstances[instances[i].priority]++;
+		totalWeight += instances[i].weight;
+	}
+	for (int p = 0; p < TIMESLICE_PRIORITIES; p++) {
+		totalCycles += priorityCycles[p];
+	}
+
+	printf("\n%d instances on %d workers for %.2f s\n", instanceCount, context->workerCount, seconds);
+	printf("  Instructions : %llu (%.2f M instr/s)\n", (unsigned long long)totalInstructions,
+		seconds > 0 ? totalInstructions / seconds / 1e6 : 0.0);
+	printf("  Slices       : %llu, %llu stolen, %llu parked, %llu woken, %llu retired\n",
+		(unsigned long long)slices, (unsigned long long)steals, (unsigned long long)parks,
+		(unsigned long long)context->wakes, (unsigned long long)retired);
+
+	// shares only match the weights while instances stay runnable, sleeping and retired ones give theirs up
+	printf("\n Priority  Instances  Weight   Cycle share   Weighted share\n");
+	printf("-----------------------------------------------------------\n");
+	for (int p = 0; p < TIMESLICE_PRIORITIES; p++) {
+		printf("%9d %10d %7d %12.1f%% %15.1f%%\n", p, priorityInstances[p], 1 << p,
+			totalCycles ? 100.0 * priorityCycles[p] / totalCycles : 0.0,
+			totalWeight ? 100.0 * priorityInstances[p] * (1 << p) / totalWeight : 0.0);
+	}
+	printf("\n");
+}
+
+// frees the run queues and the parked list, workerCount workers have their queue and mutex set up
+static void freeWorkers(SliceContext* context, int workerCount) {
+	for (int w = 0; w < workerCount; w++) {
+		hostMutexDestroy(&context->workers[w].mutex);
+		free(context->workers[w].heap);
+	}
+	hostMutexDestroy(&context->parkedMutex);
+	free(context->workers);
+	free(context->parked);
+}
+
+int runTimeSliced(int instanceCount, int threadCount, int seconds) {
+	static SliceContext context;
+	SlicedInstance* instances;
+	WorkerStart* starts;
+	HostThread* threads;
+	uint16_t registers[REGISTER_COUNT];
+	int result = 0;
+
+	if (threadCount <= 0) threadCount = hostProcessorCount();
+	if (seconds <= 0) seconds = TIMESLICE_DEFAULT_SECONDS;
+
+	instances = (SlicedInstance*)calloc(instanceCount, sizeof(SlicedInstance));
+	context.workers = (Worker*)calloc(threadCount, sizeof(Worker));
+	context.parked = (SlicedInstance**)calloc(instanceCount, sizeof(SlicedInstance*));
+	starts = (WorkerStart*)calloc(threadCount, sizeof(WorkerStart));
+	threads = (HostThread*)calloc(threadCount, sizeof(HostThread));
+	if (instances == NULL || context.workers == NULL || context.parked == NULL || starts == NULL || threads == NULL) {
+		printf("Time slice error: Unable to allocate %d instances\n", instanceCount);
+		free(instances);
+		free(context.workers);
+		free(context.parked);
+		free(starts);
+		free(threads);
+		return 1;
+	}
+	context.workerCount = threadCount;
+	hostMutexInit(&context.parkedMutex);
+
+	for (int w = 0; w < threadCount; w++) {
+		context.workers[w].heap = (SlicedInstance**)calloc(instanceCount, sizeof(SlicedInstance*));
+		if (context.workers[w].heap == NULL) {
+			printf("Time slice error: Unable to allocate run queues\n");
+			freeWorkers(&context, w);
+			free(starts);
+			free(threads);
+			free(instances);
+			return 1;
+		}
+		hostMutexInit(&context.workers[w].mutex);
+	}
+
+	// every instance starts from the loaded image, dealt round robin over the workers
+	memcpy(registers, registerFile, sizeof(registers));
+	for (int i = 0; i < instanceCount; i++) {
+		SlicedInstance* instance = &instances[i];
+
+		instance->machine = xm23Create();
+		if (instance->machine == NULL) {
+			printf("Time slice error: Unable to create instance %d\n", i);
+			instanceCount = i;
+			result = 1;
+			break;
+		}
+		xm23WriteMemory(instance->machine, 0, memory, MEMORY_SIZE);
+		xm23SetRegisters(instance->machine, registers);
+		instance->priority = i % TIMESLICE_PRIORITIES;
+		instance->weight = 1u << instance->priority;
+		enqueue(&context.workers[i % threadCount], instance, 1);
+	}
+
+	uint64_t startTime = hostTimeNanoseconds();
+	uint64_t endTime = startTime + (uint64_t)seconds * 1000000000ULL;
+	int started = 0;
+	for (int w = 0; w < threadCount; w++) {
+		starts[w].context = &context;
+		starts[w].index = w;
+		if (hostThreadCreate(&threads[started], sliceWorker, &starts[w])) {
+			started++;
+		}
+	}
+
+	// this thread stands in for whatever would wake sleeping firmware, a host event or an input arriving
+	while (hostTimeNanoseconds() < endTime) {
+		hostSleep(TIMESLICE_WAKE_MS);
+		wakeParked(&context);
+	}
+	context.stop = 1;
+	for (int w = 0; w < started; w++) {
+		hostThreadJoin(threads[w]);
+	}
+
+	printSummary(&context, instances, instanceCount, (hostTimeNanoseconds() - startTime) / 1e9);
+
+	for (int i = 0; i < instanceCount; i++) {
+		xm23Destroy(instances[i].machine);
+	}
+	freeWorkers(&context, threadCount);
+	free(starts);
+	free(threads);
+	free(instances);
+	return result;
+}
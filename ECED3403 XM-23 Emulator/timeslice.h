@@ -0,0 +1,19 @@
+#ifndef TIMESLICE_H
+#define TIMESLICE_H
+
+#include <stdint.h>
+
+#define TIMESLICE_QUANTUM 200000ULL	// cycles an instance runs before its worker picks again
+#define TIMESLICE_PRIORITIES 4		// priority p gets 2^p times the cycles of priority 0
+#define TIMESLICE_BALANCE_SLICES 16	// slices between a worker comparing its load with the others
+#define TIMESLICE_WAKE_MS 10		// parked (sleeping) instances are woken this often, standing in for an external event
+#define TIMESLICE_DEFAULT_SECONDS 5
+
+// runs instanceCount copies of the program already loaded into memory for the given time, instance n at priority
+// n % TIMESLICE_PRIORITIES, time-sliced over threadCount workers (0 for one per host processor)
+// each worker runs the instance with the least weighted run time from its own queue, takes queued instances from
+// busier workers, and parks instances that go to sleep until they are woken, instances that halt or fault retire
+// prints throughput and each priority's share of the cycles, returns 0 if every instance could be created
+int runTimeSliced(int instanceCount, int threadCount, int seconds);
+
+#endif // !TIMESLICE_H
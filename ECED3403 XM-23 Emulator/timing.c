@@ -0,0 +1,158 @@
+#define _CRT_SECURE_NO_WARNINGS // to avoid errors on functions like fopen and sscanf
+
+#include "timing.h"
+#include "branch_predictor.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+TimingModel* timingModel = NULL;
+
+// matches a config name against a table mnemonic, "BEQ", "BZ" and "BEQ/BZ" all name BEQ/BZ
+static int mnemonicMatches(const char* mnemonic, const char* name) {
+	size_t length = strlen(name);
+
+	if (strcmp(mnemonic, name) == 0) {
+		return 1;
+	}
+
+	for (const char* part = mnemonic; part != NULL; part = strchr(part, '/')) {
+		if (*part == '/') {
+			part++;
+		}
+		if (strncmp(part, name, length) == 0 && (part[length] == '\0' || part[length] == '/')) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// sets the cost for one config name, returns 0 if the name isn't known
+static int setTimingCost(TimingModel* model, const char* name, int cycles) {
+	if (strcmp(name, "fetch") == 0) model->fetch = cycles;
+	else if (strcmp(name, "decode") == 0) model->decode = cycles;
+	else if (strcmp(name, "memory.word") == 0) model->memoryWord = cycles;
+	else if (strcmp(name, "memory.byte") == 0) model->memoryByte = cycles;
+	else if (strcmp(name, "branch.taken") == 0) model->branchTaken = cycles;
+	else if (strcmp(name, "interrupt.entry") == 0) model->interruptEntry = cycles;
+	else if (strcmp(name, "branch.mispredict") == 0) model->mispredictPenalty = cycles;
+	else if (strcmp(name, "default") == 0) {
+		for (size_t i = 0; i < OPCODE_TABLE_SIZE; i++) {
+			model->execute[i] = cycles;
+		}
+	}
+	else {
+		for (size_t i = 0; i < OPCODE_TABLE_SIZE; i++) {
+			if (mnemonicMatches(opcodeTable[i].mnemonic, name)) {
+				model->execute[i] = cycles;
+				return 1;
+			}
+		}
+		return 0;
+	}
+	return 1;
+}
+
+int loadTimingModel(const char* path) {
+	FILE* file = fopen(path, "r");
+	TimingModel* model;
+	char line[128];
+	int lineNumber = 0;
+
+	if (file == NULL) {
+		printf("Timing error: Unable to open %s\n", path);
+		return 0;
+	}
+
+	model = (TimingModel*)malloc(sizeof(TimingModel));
+	if (model == NULL) {
+		printf("Timing error: Unable to allocate timing model\n");
+		fclose(file);
+		return 0;
+	}
+
+	// start from the fixed timing so a config only has to list what it changes
+	model->fetch = 1;
+	model->decode = 1;
+	model->memoryWord = 3;
+	model->memoryByte = 3;
+	model->branchTaken = 0;
+	model->interruptEntry = 0;
+	model->mispredictPenalty = 0;
+	model->chargedPredictor = PREDICT_GSHARE;
+	for (size_t i = 0; i < OPCODE_TABLE_SIZE; i++) {
+		model->execute[i] = 1;
+	}
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		char name[32];
+		int cycles;
+
+		lineNumber++;
+
+		// drop comments, then skip blank lines
+		char* comment = strchr(line, '#');
+		if (comment != NULL) {
+			*comment = '\0';
+		}
+		if (sscanf(line, "%31s", name) != 1) {
+			continue;
+		}
+
+		// the charged predictor is named rather than given a cycle count
+		if (strcmp(name, "branch.predictor") == 0) {
+			char predictor[16];
+			if (sscanf(line, "%*s %15s", predictor) != 1 || (model->chargedPredictor = predictorByName(predictor)) < 0) {
+				printf("Timing error: %s line %d: expected branch.predictor <taken|btfn|bimodal|gshare>\n", path, lineNumber);
+				free(model);
+				fclose(file);
+				return 0;
+			}
+			continue;
+		}
+
+		if (sscanf(line, "%31s %d", name, &cycles) != 2 || cycles < 0) {
+			printf("Timing error: %s line %d: expected <name> <cycles>\n", path, lineNumber);
+			free(model);
+			fclose(file);
+			return 0;
+		}
+		if (!setTimingCost(model, name, cycles)) {
+			printf("Timing error: %s line %d: unknown name %s\n", path, lineNumber, name);
+			free(model);
+			fclose(file);
+			return 0;
+		}
+	}
+	fclose(file);
+
+	// cpuStep counts one fetch and one decode cycle before it knows the instruction
+	if (model->fetch < 1 || model->decode < 1) {
+		printf("Timing error: %s: fetch and decode take at least 1 cycle\n", path);
+		free(model);
+		return 0;
+	}
+
+	free(timingModel);
+	timingModel = model;
+	return 1;
+}
+
+uint32_t timedCycles(const Instruction* instruction, int redirected) {
+	const TimingModel* model = timingModel;
+	uint32_t cycles = (model->fetch - 1) + (model->decode - 1) + model->execute[instruction->tableIndex];
+
+	if (instruction->type == MEM) {
+		cycles += instruction->wb ? model->memoryByte : model->memoryWord;
+	}
+	if (redirected) {
+		cycles += model->branchTaken;
+	}
+	return cycles;
+}
+
+void unloadTimingModel() {
+	free(timingModel);
+	timingModel = NULL;
+}
@@ -0,0 +1,39 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+#include "decode.h"
+
+#define OPCODE_TABLE_SIZE (sizeof(opcodeTable) / sizeof(opcodeTable[0]))
+
+// cycle costs used in place of the fixed fetch 1, decode 1, execute 1 (+3 for memory access) timing
+typedef struct {
+	int fetch;
+	int decode;
+	int execute[OPCODE_TABLE_SIZE];	// by opcodeTable entry
+	int memoryWord;					// added for a word LD/ST/LDR/STR
+	int memoryByte;					// added for a byte LD/ST/LDR/STR
+	int branchTaken;				// added when an instruction sends the PC anywhere but the next word
+	int interruptEntry;				// added for each interrupt or exception taken
+	int mispredictPenalty;			// added when chargedPredictor mispredicts a conditional branch
+	int chargedPredictor;			// PredictorKind whose mispredictions are charged
+} TimingModel;
+
+// the loaded timing model, shared read-only by every emulator thread, NULL uses the fixed costs
+extern TimingModel* timingModel;
+
+// loads a timing model from a text file of "name cycles" lines, # starts a comment
+// names are fetch, decode, default (execute cost of every opcode not listed), memory.word, memory.byte,
+// branch.taken, interrupt.entry, branch.mispredict, or a mnemonic (either name of BEQ/BZ etc.) for that opcode's
+// execute cost, "branch.predictor <taken|btfn|bimodal|gshare>" picks the predictor charged (gshare if not given)
+// anything left out keeps the fixed timing, returns 1/0 for success/failure
+int loadTimingModel(const char* path);
+
+// cycles past the first fetch and decode cycle cpuStep always counts, for an executed instruction
+// redirected is set when the instruction left the PC somewhere other than the word after it
+uint32_t timedCycles(const Instruction* instruction, int redirected);
+
+// frees the timing model, cpuStep goes back to the fixed costs
+void unloadTimingModel();
+
+#endif // !TIMING_H
@@ -0,0 +1,11 @@
+#ifndef TLS_H
+#define TLS_H
+
+// marks per-machine emulator state as thread-local, so each host thread can run its own XM-23 machine
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+#endif // !TLS_H
@@ -0,0 +1,264 @@
+#define _CRT_SECURE_NO_WARNINGS // to avoid errors on functions like fopen
+
+#include "uart.h"
+#include "bus.h"
+#include "cpu.h"
+#include "interrupts.h"
+#include "platform.h"
+#include "tls.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the device itself is per thread, like the device ports, so machines on other threads get a UART of their own
+// only the stdin ring is shared, between the reader thread and the thread that started it
+
+// transmit buffer, guest output is appended here and written out in batches
+static THREAD_LOCAL char txBuffer[UART_TX_BUFFER_SIZE];
+static THREAD_LOCAL int txLength = 0;
+static THREAD_LOCAL int txDiscard = 0;
+static THREAD_LOCAL UARTOutputHandler txHandler = NULL;
+
+// receive buffer, filled up front from a file or buffer
+static THREAD_LOCAL uint8_t* rxBuffer = NULL;
+static THREAD_LOCAL int rxLength = 0;
+static THREAD_LOCAL int rxPosition = 0;
+
+// ring buffer filled by the stdin reader thread, so the run loop never blocks on the console
+static uint8_t stdinRing[UART_STDIN_BUFFER_SIZE];
+static volatile uint32_t stdinHead = 0; // written by the reader thread
+static volatile uint32_t stdinTail = 0; // written by the cpu thread
+static volatile int stdinClosed = 0;
+static THREAD_LOCAL int rxFromStdin = 0;
+static HostMutex stdinMutex;
+static HostThread stdinThread;
+
+static THREAD_LOCAL uint8_t rxInterruptEnable = 0;
+
+static int stdinAvailable() {
+	hostMutexLock(&stdinMutex);
+	int available = stdinHead != stdinTail;
+	hostMutexUnlock(&stdinMutex);
+	return available;
+}
+
+// returns 1 if a received byte is available for the guest
+static int rxReady() {
+	if (rxPosition < rxLength) {
+		return 1;
+	}
+
+	// only look at stdin once the pre-filled input is used up
+	return rxFromStdin && stdinAvailable();
+}
+
+static uint8_t rxRead() {
+	if (rxPosition < rxLength) {
+		return rxBuffer[rxPosition++];
+	}
+
+	if (rxFromStdin) {
+		hostMutexLock(&stdinMutex);
+		if (stdinHead != stdinTail) {
+			uint8_t c = stdinRing[stdinTail % UART_STDIN_BUFFER_SIZE];
+			stdinTail++;
+			hostMutexUnlock(&stdinMutex);
+			return c;
+		}
+		hostMutexUnlock(&stdinMutex);
+	}
+
+	// reading an empty receiver returns 0
+	return 0;
+}
+
+// host thread that blocks on stdin and hands bytes to the cpu thread
+static void stdinReader(void* argument) {
+	int c;
+
+	(void)argument;
+
+	while ((c = getchar()) != EOF) {
+		hostMutexLock(&stdinMutex);
+		// drop input if the guest has fallen a whole buffer behind
+		if (stdinHead - stdinTail < UART_STDIN_BUFFER_SIZE) {
+			stdinRing[stdinHead % UART_STDIN_BUFFER_SIZE] = (uint8_t)c;
+			stdinHead++;
+		}
+		hostMutexUnlock(&stdinMutex);
+
+		// wake the cpu if it is asleep waiting for input
+		signalExternalInterrupt();
+	}
+
+	stdinClosed = 1;
+	signalExternalInterrupt();
+}
+
+static void txWrite(uint8_t c) {
+	// flush when the buffer is full, not per byte
+	if (txLength == UART_TX_BUFFER_SIZE) {
+		uartFlush();
+	}
+	txBuffer[txLength++] = (char)c;
+}
+
+// requests the UART vector if receive interrupts are on and a byte is waiting
+static void checkRxInterrupt() {
+	if (rxInterruptEnable && rxReady()) {
+		raiseInterrupt(VECTOR_UART);
+	}
+}
+
+// runs on the cpu thread after the stdin reader signals
+static void uartExternalInput() {
+	checkRxInterrupt();
+
+	// once stdin is closed no new input can arrive to wake a sleeping cpu
+	if (stdinClosed) {
+		removeExternalSource(uartExternalInput);
+	}
+}
+
+// device port handler for the control/status register
+static int uartCSR(uint16_t address, uint8_t* value, int mode) {
+	(void)address;
+	if (mode == BUS_READ) {
+		*value = UART_CSR_TX_READY | rxInterruptEnable | (rxReady() ? UART_CSR_RX_READY : 0);
+	}
+	else {
+		// only the interrupt enable bit is writable
+		uint8_t wasEnabled = rxInterruptEnable;
+		rxInterruptEnable = *value & UART_CSR_RX_IE;
+
+		if (rxInterruptEnable && !wasEnabled) {
+			checkRxInterrupt();
+		}
+		else if (!rxInterruptEnable && wasEnabled) {
+			clearInterrupt(VECTOR_UART);
+		}
+	}
+	return 0;
+}
+
+// device port handler for the data register
+static int uartDR(uint16_t address, uint8_t* value, int mode) {
+	(void)address;
+	if (mode == BUS_READ) {
+		*value = rxReady() ? rxRead() : 0;
+
+		// interrupt again for the next byte, if there is one
+		checkRxInterrupt();
+	}
+	else {
+		txWrite(*value);
+	}
+	return 0;
+}
+
+void initializeUART() {
+	txLength = 0;
+	rxPosition = 0;
+	rxInterruptEnable = 0;
+
+	attachDevicePort(UART_CSR_ADDRESS, uartCSR);
+	attachDevicePort(UART_DR_ADDRESS, uartDR);
+}
+
+void uartSetInput(const uint8_t* data, int dataLength) {
+	cleanupUART();
+
+	rxBuffer = (uint8_t*)malloc(dataLength > 0 ? dataLength : 1);
+	if (rxBuffer == NULL) {
+		printf("Failed to allocate UART input buffer\n");
+		return;
+	}
+
+	memcpy(rxBuffer, data, dataLength);
+	rxLength = dataLength;
+	rxPosition = 0;
+}
+
+int uartLoadInputFile(const char* filename) {
+	FILE* file = fopen(filename, "rb");
+	if (file == NULL) {
+		printf("Unable to open UART input file %s\n", filename);
+		return 0;
+	}
+
+	// read the whole file in one go
+	fseek(file, 0, SEEK_END);
+	long fileLength = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	uint8_t* data = (uint8_t*)malloc(fileLength > 0 ? fileLength : 1);
+	if (data == NULL) {
+		printf("Failed to allocate UART input buffer\n");
+		fclose(file);
+		return 0;
+	}
+
+	size_t bytesRead = fread(data, 1, fileLength, file);
+	fclose(file);
+
+	uartSetInput(data, (int)bytesRead);
+	free(data);
+
+	return 1;
+}
+
+void uartUseStdin(int enabled) {
+	// the reader thread is started once and left blocked on stdin until the program exits
+	if (!enabled || rxFromStdin) {
+		return;
+	}
+
+	// registered first, the reader can signal as soon as it starts and needs somewhere to signal to
+	hostMutexInit(&stdinMutex);
+	rxFromStdin = 1;
+	registerExternalSource(uartExternalInput);
+	if (!hostThreadCreate(&stdinThread, stdinReader, NULL)) {
+		printf("Unable to start the UART stdin reader\n");
+		rxFromStdin = 0;
+		removeExternalSource(uartExternalInput);
+	}
+}
+
+void uartDiscardOutput(int enabled) {
+	txDiscard = enabled;
+	txLength = 0;
+}
+
+void uartFlush() {
+	if (txDiscard) {
+		txLength = 0;
+	}
+	if (txLength > 0 && txHandler != NULL) {
+		txHandler(txBuffer, txLength);
+		txLength = 0;
+	}
+	if (txLength > 0) {
+		fwrite(txBuffer, 1, txLength, stdout);
+		fflush(stdout);
+		txLength = 0;
+	}
+}
+
+void uartSetOutputHandler(UARTOutputHandler handler) {
+	txHandler = handler;
+}
+
+void getUARTState(uint32_t* rxRead, uint8_t* interruptEnable) {
+	*rxRead = (uint32_t)rxPosition;
+	*interruptEnable = rxInterruptEnable;
+}
+
+void cleanupUART() {
+	if (rxBuffer != NULL) {
+		free(rxBuffer);
+		rxBuffer = NULL;
+	}
+	rxLength = 0;
+	rxPosition = 0;
+}
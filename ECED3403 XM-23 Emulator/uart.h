@@ -0,0 +1,52 @@
+#ifndef UART_H
+#define UART_H
+
+#include <stdint.h>
+
+// UART device port addresses (device 1 in the device port region)
+#define UART_CSR_ADDRESS 0x0002		// control/status register
+#define UART_DR_ADDRESS  0x0003		// data register, write to transmit, read to receive
+
+// UART control/status register bits
+#define UART_CSR_RX_READY 0x01		// a received byte is waiting in the data register
+#define UART_CSR_TX_READY 0x02		// transmitter can accept a byte (always set, output is buffered)
+#define UART_CSR_RX_IE    0x10		// request the UART vector whenever a received byte is waiting
+
+// size of the ring buffer between the stdin reader thread and the guest
+#define UART_STDIN_BUFFER_SIZE 4096
+
+// size of the host-side transmit buffer, output is only written to the console when it fills or on flush
+#define UART_TX_BUFFER_SIZE 65536
+
+// attaches the UART to this thread's device ports and resets its buffers
+void initializeUART();
+
+// pre-fills the receive side with the contents of a file, returns 1/0 for success/failure
+int uartLoadInputFile(const char* filename);
+
+// pre-fills the receive side with the provided bytes
+void uartSetInput(const uint8_t* data, int dataLength);
+
+// starts a host thread reading stdin, its input is received once the pre-filled input runs out
+// and wakes the cpu if it is asleep, the run loop itself never blocks on stdin
+void uartUseStdin(int enabled);
+
+// writes any buffered transmit output to the console
+void uartFlush();
+
+// takes this thread's guest output in place of stdout, data is only valid during the call
+typedef void (*UARTOutputHandler)(const char* data, int length);
+
+// sends flushed output to handler instead of writing it, NULL writes to stdout again
+void uartSetOutputHandler(UARTOutputHandler handler);
+
+// drops this thread's guest output instead of writing it, for runs whose output nobody reads
+void uartDiscardOutput(int enabled);
+
+// how far the guest has read into the pre-filled input and the receive interrupt enable, for hashing machine state
+void getUARTState(uint32_t* rxRead, uint8_t* interruptEnable);
+
+// frees the UART input buffer
+void cleanupUART();
+
+#endif // !UART_H
@@ -0,0 +1,481 @@
+#include "xm23.h"
+#include "bus.h"
+#include "cpu.h"
+#include "file_decoder.h"
+#include "interrupts.h"
+#include "memory.h"
+#include "memory_dump.h"
+#include "registers.h"
+#include "scheduler.h"
+#include "state_hash.h"
+#include "uart.h"
+#include "coverage.h"
+#include "fuzzer.h"
+#include "pipeline.h"
+#include "cache.h"
+#include "branch_predictor.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define XM23_OUTPUT_INITIAL 256 // console output buffer, doubled as needed
+
+typedef struct {
+	uint16_t address;
+	uint16_t length;
+	uint8_t* values; // contents after the last instruction
+} Watchpoint;
+
+struct XM23Machine {
+	uint8_t* memory;
+	uint16_t registers[REGISTER_COUNT];
+	uint16_t psw;
+	uint64_t cycles;
+	uint64_t instructions;
+	int cexExecuteCount;
+	int cexSkipCount;
+	uint32_t interruptPending;
+	uint16_t interruptRequests;
+	SchedulerState scheduler;
+	int braCount;
+
+	uint8_t breakpoints[MEMORY_SIZE / 8];
+	int breakpointCount;
+	Watchpoint watchpoints[XM23_MAX_WATCHPOINTS];
+	int watchpointCount;
+	XM23StepCallback callback;
+	void* callbackContext;
+
+	uint8_t* input;
+	size_t inputLength;
+	size_t inputPosition;
+	char* output;
+	size_t outputLength;
+	size_t outputCapacity;
+};
+
+// the calling thread's own state while a machine is swapped in
+typedef struct {
+	uint8_t* memory;
+	uint16_t registers[REGISTER_COUNT];
+	uint16_t psw;
+	uint64_t cycles;
+	uint64_t instructions;
+	int cexExecuteCount;
+	int cexSkipCount;
+	uint32_t interruptPending;
+	uint16_t interruptRequests;
+	SchedulerState scheduler;
+	int braCount;
+	int traceEnabled;
+	int stopOnFault;
+	DevicePortHandler devicePorts[DEVICE_PORT_COUNT];
+	uint8_t* dirtyPages;
+	CoverageMap* coverageMap;
+	uint8_t* edgeCoverageMap;
+	PipelineModel* pipelineModel;
+	Cache* instructionCache;
+	Cache* dataCache;
+	BranchPredictors* branchPredictors;
+} HostState;
+
+// machine whose console the UART port handlers serve on this thread
+static THREAD_LOCAL XM23Machine* boundMachine = NULL;
+
+static int consoleCSR(uint16_t address, uint8_t* value, int mode) {
+	XM23Machine* machine = boundMachine;
+
+	(void)address;
+	if (mode == BUS_READ) {
+		*value = UART_CSR_TX_READY | (machine->inputPosition < machine->inputLength ? UART_CSR_RX_READY : 0);
+	}
+	return 0;
+}
+
+static int consoleDR(uint16_t address, uint8_t* value, int mode) {
+	XM23Machine* machine = boundMachine;
+
+	(void)address;
+	if (mode == BUS_READ) {
+		*value = machine->inputPosition < machine->inputLength ? machine->input[machine->inputPosition++] : 0;
+		return 0;
+	}
+
+	if (machine->outputLength == machine->outputCapacity) {
+		size_t capacity = machine->outputCapacity ? machine->outputCapacity * 2 : XM23_OUTPUT_INITIAL;
+		char* output = (char*)realloc(machine->output, capacity);
+		if (output == NULL) {
+			return -1;
+		}
+		machine->output = output;
+		machine->outputCapacity = capacity;
+	}
+	machine->output[machine->outputLength++] = (char)*value;
+	return 0;
+}
+
+// copies the machine's registers, counters, interrupt and scheduler state into the thread
+static void loadMachineState(const XM23Machine* machine) {
+	memcpy(registerFile, machine->registers, sizeof(registerFile));
+	PSW = machine->psw;
+	cpuClock = machine->cycles;
+	instructionCount = machine->instructions;
+	cexExecuteCount = machine->cexExecuteCount;
+	cexSkipCount = machine->cexSkipCount;
+	restoreInterruptState(machine->interruptPending, machine->interruptRequests);
+	restoreScheduler(&machine->scheduler);
+	braCount = machine->braCount;
+}
+
+// copies the same state from the thread back into the machine
+static void storeMachineState(XM23Machine* machine) {
+	memcpy(machine->registers, registerFile, sizeof(machine->registers));
+	machine->psw = PSW;
+	machine->cycles = cpuClock;
+	machine->instructions = instructionCount;
+	machine->cexExecuteCount = cexExecuteCount;
+	machine->cexSkipCount = cexSkipCount;
+	saveInterruptState(&machine->interruptPending, &machine->interruptRequests);
+	saveScheduler(&machine->scheduler);
+	machine->braCount = braCount;
+}
+
+// saves the thread's state and loads the machine's, with only the console attached and every hook off
+static void bindMachine(XM23Machine* machine, HostState* host) {
+	host->memory = memory;
+	memcpy(host->registers, registerFile, sizeof(host->registers));
+	host->psw = PSW;
+	host->cycles = cpuClock;
+	host->instructions = instructionCount;
+	host->cexExecuteCount = cexExecuteCount;
+	host->cexSkipCount = cexSkipCount;
+	saveInterruptState(&host->interruptPending, &host->interruptRequests);
+	saveScheduler(&host->scheduler);
+	host->braCount = braCount;
+	host->traceEnabled = traceEnabled;
+	host->stopOnFault = stopOnFault;
+	saveDevicePorts(host->devicePorts);
+	host->dirtyPages = dirtyPages;
+	host->coverageMap = coverageMap;
+	host->edgeCoverageMap = edgeCoverageMap;
+	host->pipelineModel = pipelineModel;
+	host->instructionCache = instructionCache;
+	host->dataCache = dataCache;
+	host->branchPredictors = branchPredictors;
+
+	memory = machine->memory;
+	loadMachineState(machine);
+	traceEnabled = 0;
+	stopOnFault = 1;
+
+	DevicePortHandler ports[DEVICE_PORT_COUNT] = { NULL };
+	ports[UART_CSR_ADDRESS] = consoleCSR;
+	ports[UART_DR_ADDRESS] = consoleDR;
+	restoreDevicePorts(ports);
+
+	dirtyPages = NULL;
+	coverageMap = NULL;
+	edgeCoverageMap = NULL;
+	pipelineModel = NULL;
+	instructionCache = NULL;
+	dataCache = NULL;
+	branchPredictors = NULL;
+	boundMachine = machine;
+}
+
+// saves the machine's state and gives the thread its own back
+static void unbindMachine(XM23Machine* machine, const HostState* host) {
+	storeMachineState(machine);
+
+	memory = host->memory;
+	memcpy(registerFile, host->registers, sizeof(registerFile));
+	PSW = host->psw;
+	cpuClock = host->cycles;
+	instructionCount = host->instructions;
+	cexExecuteCount = host->cexExecuteCount;
+	cexSkipCount = host->cexSkipCount;
+	restoreInterruptState(host->interruptPending, host->interruptRequests);
+	restoreScheduler(&host->scheduler);
+	braCount = host->braCount;
+	traceEnabled = host->traceEnabled;
+	stopOnFault = host->stopOnFault;
+	restoreDevicePorts(host->devicePorts);
+	dirtyPages = host->dirtyPages;
+	coverageMap = host->coverageMap;
+	edgeCoverageMap = host->edgeCoverageMap;
+	pipelineModel = host->pipelineModel;
+	instructionCache = host->instructionCache;
+	dataCache = host->dataCache;
+	branchPredictors = host->branchPredictors;
+	boundMachine = NULL;
+}
+
+XM23Machine* xm23Create() {
+	XM23Machine* machine = (XM23Machine*)calloc(1, sizeof(XM23Machine));
+
+	if (machine == NULL) {
+		return NULL;
+	}
+	machine->memory = (uint8_t*)calloc(MEMORY_SIZE, 1);
+	if (machine->memory == NULL) {
+		free(machine);
+		return NULL;
+	}
+	return machine;
+}
+
+void xm23Destroy(XM23Machine* machine) {
+	if (machine == NULL) {
+		return;
+	}
+	xm23ClearWatchpoints(machine);
+	free(machine->input);
+	free(machine->output);
+	free(machine->memory);
+	free(machine);
+}
+
+void xm23Reset(XM23Machine* machine) {
+	uint8_t* machineMemory = machine->memory;
+	char* output = machine->output;
+	size_t outputCapacity = machine->outputCapacity;
+
+	// keep the allocations, a reset machine is reused for the next job
+	xm23ClearWatchpoints(machine);
+	free(machine->input);
+	memset(machineMemory, 0, MEMORY_SIZE);
+	memset(machine, 0, sizeof(XM23Machine));
+	machine->memory = machineMemory;
+	machine->output = output;
+	machine->outputCapacity = outputCapacity;
+}
+
+int xm23LoadSRecords(XM23Machine* machine, const char* text, size_t length) {
+	HostState host;
+
+	bindMachine(machine, &host);
+	int records = decodeRecords(text, length);
+	unbindMachine(machine, &host);
+
+	return records;
+}
+
+// true if any watched byte differs from its last value, the saved values are brought up to date
+static int watchpointHit(XM23Machine* machine) {
+	int hit = 0;
+
+	for (int i = 0; i < machine->watchpointCount; i++) {
+		Watchpoint* watch = &machine->watchpoints[i];
+		for (uint32_t offset = 0; offset < watch->length; offset++) {
+			uint8_t value = machine->memory[(uint16_t)(watch->address + offset)];
+			if (value != watch->values[offset]) {
+				watch->values[offset] = value;
+				hit = 1;
+			}
+		}
+	}
+	return hit;
+}
+
+static XM23StopReason stopReason(int status) {
+	switch (status) {
+	case CPU_HALTED: return XM23_STOP_HALT;
+	case CPU_ASLEEP: return XM23_STOP_ASLEEP;
+	case CPU_FAULTED: return XM23_STOP_FAULT;
+	default: return XM23_STOP_CYCLE_LIMIT;
+	}
+}
+
+XM23StopReason xm23Run(XM23Machine* machine, uint64_t maxCycles) {
+	XM23StopReason reason;
+	HostState host;
+
+	bindMachine(machine, &host);
+	uint64_t cycleLimit = cpuClock + maxCycles < cpuClock ? UINT64_MAX : cpuClock + maxCycles;
+
+	if (machine->breakpointCount == 0 && machine->watchpointCount == 0 && machine->callback == NULL) {
+		// nothing to check between instructions, run the headless loop as is
+		reason = stopReason(cpuRun(cycleLimit));
+	}
+	else {
+		int status = CPU_RUNNING;
+		int first = 1;
+
+		reason = XM23_STOP_CYCLE_LIMIT;
+		while (cpuClock < cycleLimit) {
+			if (!first && COVERAGE_TEST(machine->breakpoints, registerFile[R_PC])) {
+				reason = XM23_STOP_BREAKPOINT;
+				break;
+			}
+			first = 0;
+
+			status = cpuStep();
+			if (status != CPU_RUNNING) {
+				reason = stopReason(status);
+				break;
+			}
+			if (machine->watchpointCount > 0 && watchpointHit(machine)) {
+				reason = XM23_STOP_WATCHPOINT;
+				break;
+			}
+			if (machine->callback != NULL) {
+				// the accessors work on the machine struct, it is brought up to date for the callback and any
+				// changes it makes are taken back, accessors that bind the machine again leave it unbound
+				storeMachineState(machine);
+				int stop = machine->callback(machine, machine->callbackContext);
+				loadMachineState(machine);
+				boundMachine = machine;
+
+				if (stop) {
+					reason = XM23_STOP_CALLBACK;
+					break;
+				}
+			}
+		}
+	}
+
+	unbindMachine(machine, &host);
+	return reason;
+}
+
+void xm23GetRegisters(const XM23Machine* machine, uint16_t registers[8]) {
+	memcpy(registers, machine->registers, sizeof(machine->registers));
+}
+
+void xm23SetRegisters(XM23Machine* machine, const uint16_t registers[8]) {
+	memcpy(machine->registers, registers, sizeof(machine->registers));
+}
+
+uint16_t xm23GetPSW(const XM23Machine* machine) {
+	return machine->psw;
+}
+
+void xm23SetPSW(XM23Machine* machine, uint16_t psw) {
+	HostState host;
+
+	// the pending word depends on the priority and sleep bits
+	bindMachine(machine, &host);
+	PSW = psw;
+	updateInterruptPending();
+	unbindMachine(machine, &host);
+}
+
+void xm23ReadMemory(const XM23Machine* machine, uint16_t address, void* buffer, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		((uint8_t*)buffer)[i] = machine->memory[(uint16_t)(address + i)];
+	}
+}
+
+void xm23WriteMemory(XM23Machine* machine, uint16_t address, const void* data, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		machine->memory[(uint16_t)(address + i)] = ((const uint8_t*)data)[i];
+	}
+}
+
+int xm23DumpMemory(const XM23Machine* machine, const char* path, uint16_t address, uint32_t length) {
+	return dumpMemory(machine->memory, path, address, length);
+}
+
+int xm23DiffMemory(const XM23Machine* machine, const void* reference, uint16_t address, uint32_t length, XM23Range* ranges, int maxRanges) {
+	uint8_t* image = (uint8_t*)calloc(MEMORY_SIZE, sizeof(uint8_t));
+	MemoryRange* found = maxRanges > 0 ? (MemoryRange*)malloc(maxRanges * sizeof(MemoryRange)) : NULL;
+	int count = -1;
+
+	// the reference is placed at the same addresses so ranges come back as machine addresses
+	if (image != NULL && (maxRanges <= 0 || found != NULL)) {
+		if (length > (uint32_t)(MEMORY_SIZE - address)) {
+			length = (uint32_t)(MEMORY_SIZE - address);
+		}
+		memcpy(image + address, reference, length);
+		count = diffMemory(image, machine->memory, address, length, found, maxRanges);
+		for (int i = 0; i < count && i < maxRanges; i++) {
+			ranges[i].start = found[i].start;
+			ranges[i].length = found[i].length;
+		}
+	}
+	free(found);
+	free(image);
+	return count;
+}
+
+uint64_t xm23StateHash(const XM23Machine* machine) {
+	return hashMachineParts(machine->memory, machine->registers, machine->psw, machine->interruptRequests,
+		machine->cexExecuteCount, machine->cexSkipCount, (uint32_t)machine->inputPosition);
+}
+
+uint64_t xm23Cycles(const XM23Machine* machine) {
+	return machine->cycles;
+}
+
+uint64_t xm23Instructions(const XM23Machine* machine) {
+	return machine->instructions;
+}
+
+void xm23SetBreakpoint(XM23Machine* machine, uint16_t address, int enabled) {
+	int wasSet = COVERAGE_TEST(machine->breakpoints, address);
+
+	if (enabled && !wasSet) {
+		COVERAGE_SET(machine->breakpoints, address);
+		machine->breakpointCount++;
+	}
+	else if (!enabled && wasSet) {
+		machine->breakpoints[address >> 3] &= ~(1 << (address & 7));
+		machine->breakpointCount--;
+	}
+}
+
+int xm23AddWatchpoint(XM23Machine* machine, uint16_t address, uint16_t length) {
+	Watchpoint* watch;
+
+	if (machine->watchpointCount == XM23_MAX_WATCHPOINTS || length == 0) {
+		return 0;
+	}
+
+	watch = &machine->watchpoints[machine->watchpointCount];
+	watch->values = (uint8_t*)malloc(length);
+	if (watch->values == NULL) {
+		return 0;
+	}
+	watch->address = address;
+	watch->length = length;
+	xm23ReadMemory(machine, address, watch->values, length);
+	machine->watchpointCount++;
+	return 1;
+}
+
+void xm23ClearWatchpoints(XM23Machine* machine) {
+	for (int i = 0; i < machine->watchpointCount; i++) {
+		free(machine->watchpoints[i].values);
+	}
+	machine->watchpointCount = 0;
+}
+
+void xm23SetStepCallback(XM23Machine* machine, XM23StepCallback callback, void* context) {
+	machine->callback = callback;
+	machine->callbackContext = context;
+}
+
+void xm23SetInput(XM23Machine* machine, const uint8_t* data, size_t length) {
+	uint8_t* input = length ? (uint8_t*)malloc(length) : NULL;
+
+	if (length && input == NULL) {
+		return;
+	}
+	if (length) {
+		memcpy(input, data, length);
+	}
+	free(machine->input);
+	machine->input = input;
+	machine->inputLength = length;
+	machine->inputPosition = 0;
+}
+
+size_t xm23ReadOutput(XM23Machine* machine, char* buffer, size_t size) {
+	size_t length = machine->outputLength < size ? machine->outputLength : size;
+
+	// hand over the oldest output, keep the rest for the next read
+	memcpy(buffer, machine->output, length);
+	memmove(machine->output, machine->output + length, machine->outputLength - length);
+	machine->outputLength -= length;
+	return length;
+}
@@ -0,0 +1,90 @@
+#ifndef XM23_H
+#define XM23_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// library interface for running XM-23 machines from other programs, build every source file except main.c
+// a machine's state is swapped into the calling thread for each call, so a machine may move between threads
+// but must only be used by one thread at a time, and any number of machines may run on separate threads
+
+#define XM23_MAX_WATCHPOINTS 8
+
+// why xm23Run returned
+typedef enum {
+	XM23_STOP_HALT,			// fetched the 0x0000 end of program word
+	XM23_STOP_BREAKPOINT,	// the PC reached a breakpoint, the instruction there hasn't run yet
+	XM23_STOP_WATCHPOINT,	// a watched byte changed value, the PC is past the instruction that wrote it
+	XM23_STOP_CYCLE_LIMIT,	// ran the cycles it was given
+	XM23_STOP_FAULT,		// undecodable word or execution error, the PC is past the faulting word
+	XM23_STOP_ASLEEP,		// PSW SLP is set and nothing can wake the machine
+	XM23_STOP_CALLBACK		// the step callback asked to stop
+} XM23StopReason;
+
+typedef struct XM23Machine XM23Machine;
+
+// called after every instruction when set, returns non-zero to stop the run
+// the accessors see the machine as of that instruction, and registers or PSW set from the callback carry on into the run
+typedef int (*XM23StepCallback)(XM23Machine* machine, void* context);
+
+// creates a machine with zeroed memory and registers, returns NULL if it couldn't be allocated
+XM23Machine* xm23Create();
+
+// frees a machine
+void xm23Destroy(XM23Machine* machine);
+
+// clears memory, registers, counters, console, breakpoints and watchpoints, ready for another image
+void xm23Reset(XM23Machine* machine);
+
+// loads S-record text (as the assembler writes to .xme files) into memory, the S9 record sets the PC
+// returns the number of records loaded, or -1 if the text isn't S-records or a record fails its checksum
+int xm23LoadSRecords(XM23Machine* machine, const char* text, size_t length);
+
+// runs until one of the stop reasons, at most maxCycles further cycles
+// without breakpoints, watchpoints or a callback this is the same loop as a headless run
+XM23StopReason xm23Run(XM23Machine* machine, uint64_t maxCycles);
+
+// bulk accessors, registers are R0-R7 with R7 the PC
+void xm23GetRegisters(const XM23Machine* machine, uint16_t registers[8]);
+void xm23SetRegisters(XM23Machine* machine, const uint16_t registers[8]);
+uint16_t xm23GetPSW(const XM23Machine* machine);
+void xm23SetPSW(XM23Machine* machine, uint16_t psw);
+void xm23ReadMemory(const XM23Machine* machine, uint16_t address, void* buffer, size_t length);
+void xm23WriteMemory(XM23Machine* machine, uint16_t address, const void* data, size_t length);
+
+// a run of changed addresses reported by xm23DiffMemory
+typedef struct {
+	uint16_t start;
+	uint32_t length;
+} XM23Range;
+
+// writes memory from address to a file in one write, raw bytes or hex lines for .hex and .txt names, returns 0 on failure
+int xm23DumpMemory(const XM23Machine* machine, const char* path, uint16_t address, uint32_t length);
+
+// compares memory from address with length bytes of reference (an earlier xm23ReadMemory copy or a loaded dump)
+// fills up to maxRanges changed ranges and returns how many there are in all, or -1 if out of memory
+int xm23DiffMemory(const XM23Machine* machine, const void* reference, uint16_t address, uint32_t length, XM23Range* ranges, int maxRanges);
+
+// 64-bit hash of memory, registers, PSW, CEX and interrupt state and how much console input has been read,
+// equal for machines in the same state whatever their cycle counts, for comparing final states between runs
+// console input not yet read isn't part of it, machines given different input can hash equal and then diverge
+uint64_t xm23StateHash(const XM23Machine* machine);
+
+uint64_t xm23Cycles(const XM23Machine* machine);
+uint64_t xm23Instructions(const XM23Machine* machine);
+
+// breakpoints stop a run before the instruction at the address, a run starting on one executes it first
+void xm23SetBreakpoint(XM23Machine* machine, uint16_t address, int enabled);
+
+// stops a run after any instruction that changes a byte in address to address + length - 1, returns 0 if all are in use
+int xm23AddWatchpoint(XM23Machine* machine, uint16_t address, uint16_t length);
+void xm23ClearWatchpoints(XM23Machine* machine);
+
+// per-instruction callback, NULL to remove it
+void xm23SetStepCallback(XM23Machine* machine, XM23StepCallback callback, void* context);
+
+// console on the UART ports (polled, no interrupts), input is read by the guest, output collected for the caller
+void xm23SetInput(XM23Machine* machine, const uint8_t* data, size_t length);
+size_t xm23ReadOutput(XM23Machine* machine, char* buffer, size_t size);
+
+#endif // !XM23_H